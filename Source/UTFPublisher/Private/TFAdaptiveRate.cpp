@@ -0,0 +1,119 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFAdaptiveRate.h"
+#include "TFStats.h"
+
+// Number of consecutive relaxed intervals before stepping back up
+static const int32 TFAdaptiveRelaxedIntervals = 3;
+
+// Constructor
+FTFAdaptiveRate::FTFAdaptiveRate()
+{
+	Settings.MaxRate = 60.f;
+	Settings.MinRate = 5.f;
+	Settings.LatencyThreshold = 0.05f;
+	Settings.QueueDepthThreshold = 2;
+	Settings.bAllowDeltaMode = true;
+	Settings.EvaluationInterval = 1.f;
+	CurrentRate = Settings.MaxRate;
+	bDeltaModeForced = false;
+	RelaxedIntervals = 0;
+	NextEvaluationTime = 0.f;
+	NextPublishTime = 0.f;
+}
+
+// Set the thresholds and restart at the maximal rate
+void FTFAdaptiveRate::Init(const FTFAdaptiveSettings& InSettings)
+{
+	Settings = InSettings;
+	Settings.MaxRate = FMath::Max(Settings.MaxRate, KINDA_SMALL_NUMBER);
+	Settings.MinRate = FMath::Clamp(Settings.MinRate, KINDA_SMALL_NUMBER, Settings.MaxRate);
+	CurrentRate = Settings.MaxRate;
+	bDeltaModeForced = false;
+	RelaxedIntervals = 0;
+	IntervalStats = FTFSendStats();
+	Counters = FTFAdaptiveCounters();
+	NextEvaluationTime = 0.f;
+	NextPublishTime = 0.f;
+	SET_FLOAT_STAT(STAT_TFAdaptiveRate, CurrentRate);
+}
+
+// Take the decisions if the evaluation interval elapsed
+void FTFAdaptiveRate::Update(const float InWorldTime)
+{
+	if (InWorldTime < NextEvaluationTime)
+	{
+		return;
+	}
+	NextEvaluationTime = InWorldTime + Settings.EvaluationInterval;
+
+	const double MeanLatency = IntervalStats.NumSent > 0 ? IntervalStats.LatencySum / IntervalStats.NumSent : 0.0;
+	const bool bOverloaded = MeanLatency > Settings.LatencyThreshold
+		|| IntervalStats.MaxQueueDepth > Settings.QueueDepthThreshold
+		|| IntervalStats.NumStale > 0;
+	const bool bRelaxed = MeanLatency < Settings.LatencyThreshold * 0.5
+		&& IntervalStats.MaxQueueDepth <= 1
+		&& IntervalStats.NumStale == 0;
+	IntervalStats = FTFSendStats();
+
+	if (bOverloaded)
+	{
+		RelaxedIntervals = 0;
+		if (Settings.bAllowDeltaMode && !bDeltaModeForced)
+		{
+			// Fewer transforms per message first
+			bDeltaModeForced = true;
+			Counters.DeltaModeEnables++;
+			INC_DWORD_STAT(STAT_TFAdaptiveDeltaEnables);
+			UE_LOG(LogTF, Log, TEXT("%s::%d Backpressure (latency %.1f ms), switching to delta publishing.."),
+				TEXT(__FUNCTION__), __LINE__, MeanLatency * 1000.0);
+		}
+		else if (CurrentRate > Settings.MinRate)
+		{
+			CurrentRate = FMath::Max(CurrentRate * 0.5f, Settings.MinRate);
+			Counters.RateDecreases++;
+			INC_DWORD_STAT(STAT_TFAdaptiveRateDecreases);
+			UE_LOG(LogTF, Log, TEXT("%s::%d Backpressure (latency %.1f ms), lowering the publish rate to %.1f Hz.."),
+				TEXT(__FUNCTION__), __LINE__, MeanLatency * 1000.0, CurrentRate);
+		}
+	}
+	else if (bRelaxed && ++RelaxedIntervals >= TFAdaptiveRelaxedIntervals)
+	{
+		// Step back up slower than down
+		RelaxedIntervals = 0;
+		if (CurrentRate < Settings.MaxRate)
+		{
+			CurrentRate = FMath::Min(CurrentRate * 1.25f, Settings.MaxRate);
+			Counters.RateIncreases++;
+			INC_DWORD_STAT(STAT_TFAdaptiveRateIncreases);
+			UE_LOG(LogTF, Log, TEXT("%s::%d Backpressure released, raising the publish rate to %.1f Hz.."),
+				TEXT(__FUNCTION__), __LINE__, CurrentRate);
+		}
+		else if (bDeltaModeForced)
+		{
+			bDeltaModeForced = false;
+			Counters.DeltaModeDisables++;
+			INC_DWORD_STAT(STAT_TFAdaptiveDeltaDisables);
+			UE_LOG(LogTF, Log, TEXT("%s::%d Backpressure released, switching back to full publishing.."),
+				TEXT(__FUNCTION__), __LINE__);
+		}
+	}
+	SET_FLOAT_STAT(STAT_TFAdaptiveRate, CurrentRate);
+}
+
+// Check if a publish is due at the current rate
+bool FTFAdaptiveRate::ShouldPublish(const float InWorldTime)
+{
+	if (InWorldTime < NextPublishTime)
+	{
+		return false;
+	}
+	// Schedule next publish, if the publisher fell behind restart from the current time
+	NextPublishTime += 1.f / CurrentRate;
+	if (NextPublishTime < InWorldTime)
+	{
+		NextPublishTime = InWorldTime + 1.f / CurrentRate;
+	}
+	return true;
+}
@@ -0,0 +1,156 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFAllocationCounter.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+
+bool FTFAllocationCounter::bInstalled = false;
+uint32 FTFAllocationCounter::TlsSlot = 0;
+
+#if !UE_BUILD_SHIPPING
+/**
+* FTFCountingMalloc - Forwards every call to the wrapped allocator,
+* allocations are counted on the threads with an active counting scope
+*/
+class FTFCountingMalloc : public FMalloc
+{
+public:
+	// Constructor
+	explicit FTFCountingMalloc(FMalloc* InInnerMalloc) : InnerMalloc(InInnerMalloc) {}
+
+	/* Begin FMalloc interface */
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation();
+		return InnerMalloc->Malloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if (Count > 0)
+		{
+			CountAllocation();
+		}
+		return InnerMalloc->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		InnerMalloc->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+	{
+		return InnerMalloc->QuantizeSize(Count, Alignment);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return InnerMalloc->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual void Trim() override
+	{
+		InnerMalloc->Trim();
+	}
+
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		InnerMalloc->SetupTLSCachesOnCurrentThread();
+	}
+
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+	}
+
+	virtual void InitializeStatsMetadata() override
+	{
+		InnerMalloc->InitializeStatsMetadata();
+	}
+
+	virtual void UpdateStats() override
+	{
+		InnerMalloc->UpdateStats();
+	}
+
+	virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+	{
+		InnerMalloc->GetAllocatorStats(OutStats);
+	}
+
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+	{
+		InnerMalloc->DumpAllocatorStats(Ar);
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return InnerMalloc->IsInternallyThreadSafe();
+	}
+
+	virtual bool ValidateHeap() override
+	{
+		return InnerMalloc->ValidateHeap();
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return InnerMalloc->GetDescriptiveName();
+	}
+	/* End FMalloc interface */
+
+private:
+	// Increment the counter of the active scope of the current thread
+	FORCEINLINE void CountAllocation() const
+	{
+		if (uint32* Counter = static_cast<uint32*>(FPlatformTLS::GetTlsValue(FTFAllocationCounter::TlsSlot)))
+		{
+			++(*Counter);
+		}
+	}
+
+	// Wrapped allocator
+	FMalloc* InnerMalloc;
+};
+#endif // !UE_BUILD_SHIPPING
+
+// Wrap GMalloc with the counting proxy (once, game thread, benchmark commands only)
+void FTFAllocationCounter::Install()
+{
+#if UE_BUILD_SHIPPING
+	UE_LOG(LogTF, Warning, TEXT("%s::%d The allocation counter is not available in shipping builds.."), TEXT(__FUNCTION__), __LINE__);
+#else
+	if (!IsInstalled())
+	{
+		check(IsInGameThread());
+		TlsSlot = FPlatformTLS::AllocTlsSlot();
+		FMalloc* CountingMalloc = new FTFCountingMalloc(GMalloc);
+		// Make the slot visible to the other threads before they reach the proxy
+		FPlatformMisc::MemoryBarrier();
+		GMalloc = CountingMalloc;
+		bInstalled = true;
+	}
+#endif // UE_BUILD_SHIPPING
+}
+
+// Constructor, the count is added to the given number (nothing is counted if the proxy is not installed)
+FTFAllocationCounter::FScope::FScope(uint32& OutNumAllocations)
+	: PrevCounter(nullptr)
+{
+	if (IsInstalled())
+	{
+		PrevCounter = static_cast<uint32*>(FPlatformTLS::GetTlsValue(TlsSlot));
+		FPlatformTLS::SetTlsValue(TlsSlot, &OutNumAllocations);
+	}
+}
+
+// Destructor
+FTFAllocationCounter::FScope::~FScope()
+{
+	if (IsInstalled())
+	{
+		FPlatformTLS::SetTlsValue(TlsSlot, PrevCounter);
+	}
+}
@@ -0,0 +1,108 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFBenchmarkUtils.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Components/SceneComponent.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+#if !UE_BUILD_SHIPPING
+// Random transform of a synthetic frame
+FTransform FTFBenchmarkUtils::RandomTransform(FRandomStream& Random)
+{
+	return FTransform(
+		FRotator(Random.FRandRange(-180.f, 180.f), Random.FRandRange(-180.f, 180.f), Random.FRandRange(-180.f, 180.f)),
+		Random.GetUnitVector() * Random.FRandRange(0.f, 1000.f));
+}
+
+// Encode the message as a rosbridge json publish operation, returns the UTF-8 size
+int32 FTFBenchmarkUtils::EncodeJson(const TSharedPtr<tf2_msgs::TFMessage>& InTFMsg, const FString& InTopic)
+{
+	TSharedPtr<FJsonObject> OpObject = MakeShareable(new FJsonObject());
+	OpObject->SetStringField(TEXT("op"), TEXT("publish"));
+	OpObject->SetStringField(TEXT("topic"), InTopic);
+	OpObject->SetObjectField(TEXT("msg"), InTFMsg->ToJsonObject());
+
+	FString OutputString;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer =
+		TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&OutputString);
+	FJsonSerializer::Serialize(OpObject.ToSharedRef(), Writer);
+	return FTCHARToUTF8(*OutputString).Length();
+}
+
+// Create a new game world with its world context
+UWorld* FTFBenchmarkUtils::CreateWorld()
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	return World;
+}
+
+// Destroy the world and its world context, and collect its objects
+void FTFBenchmarkUtils::DestroyWorld(UWorld* InWorld)
+{
+	GEngine->DestroyWorldContext(InWorld);
+	InWorld->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+// Spawn an actor with a TF tag and a random transform for every frame
+void FTFBenchmarkUtils::SpawnTaggedActors(UWorld* InWorld, const int32 InNumFrames, TFunctionRef<FString(const int32 InIdx)> InGetParentFrameId)
+{
+	FRandomStream Random(InNumFrames);
+	for (int32 Idx = 0; Idx < InNumFrames; ++Idx)
+	{
+		AActor* Actor = InWorld->SpawnActor<AActor>();
+		USceneComponent* RootComponent = NewObject<USceneComponent>(Actor);
+		Actor->SetRootComponent(RootComponent);
+		RootComponent->RegisterComponent();
+		RootComponent->SetWorldTransform(RandomTransform(Random));
+		Actor->Tags.Emplace(*FString::Printf(TEXT("TF;ChildFrameId,frame_%d;ParentFrameId,%s;"),
+			Idx, *InGetParentFrameId(Idx)));
+	}
+}
+
+// Get the numeric arguments (tree sizes), the defaults if there are none
+TArray<int32> FTFBenchmarkUtils::ParseSizes(const TArray<FString>& Args, const TArray<int32>& InDefaultSizes)
+{
+	TArray<int32> Sizes;
+	for (const auto& ArgItr : Args)
+	{
+		if (ArgItr.IsNumeric())
+		{
+			Sizes.Emplace(FCString::Atoi(*ArgItr));
+		}
+	}
+	return Sizes.Num() > 0 ? Sizes : InDefaultSizes;
+}
+
+// Write the results with the date into Saved/Benchmarks, returns the file path
+FString FTFBenchmarkUtils::WriteResults(const FString& InName, const TSharedRef<FJsonObject>& InRootObject,
+	const TArray<TSharedPtr<FJsonObject>>& InResults)
+{
+	TArray<TSharedPtr<FJsonValue>> ResultValues;
+	for (const auto& ResultItr : InResults)
+	{
+		ResultValues.Emplace(MakeShareable(new FJsonValueObject(ResultItr)));
+	}
+
+	const FDateTime Now = FDateTime::Now();
+	InRootObject->SetStringField(TEXT("date"), Now.ToIso8601());
+	InRootObject->SetArrayField(TEXT("results"), ResultValues);
+
+	FString OutputString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
+	FJsonSerializer::Serialize(InRootObject, Writer);
+
+	const FString FilePath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") /
+		FString::Printf(TEXT("%s_%s.json"), *InName, *Now.ToString());
+	FFileHelper::SaveStringToFile(OutputString, *FilePath);
+	return FilePath;
+}
+#endif // !UE_BUILD_SHIPPING
@@ -0,0 +1,402 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFBson.h"
+#include "Conversions.h"
+
+// BSON element types
+namespace TFBsonType
+{
+	static const uint8 Double = 0x01;
+	static const uint8 String = 0x02;
+	static const uint8 Document = 0x03;
+	static const uint8 Array = 0x04;
+	static const uint8 Binary = 0x05;
+	static const uint8 Bool = 0x08;
+	static const uint8 Null = 0x0A;
+	static const uint8 Int32 = 0x10;
+	static const uint8 Int64 = 0x12;
+}
+
+// Begin the root document
+void FTFBsonWriter::BeginDocument()
+{
+	OpenDocuments.Push(Buffer.AddZeroed(sizeof(int32)));
+}
+
+// Begin an embedded document
+void FTFBsonWriter::BeginDocument(const ANSICHAR* InKey)
+{
+	WriteElementHeader(TFBsonType::Document, InKey);
+	BeginDocument();
+}
+
+// Begin an embedded document as the element of an array
+void FTFBsonWriter::BeginDocument(const int32 InArrayIndex)
+{
+	WriteElementHeader(TFBsonType::Document, InArrayIndex);
+	BeginDocument();
+}
+
+// Begin an array
+void FTFBsonWriter::BeginArray(const ANSICHAR* InKey)
+{
+	WriteElementHeader(TFBsonType::Array, InKey);
+	BeginDocument();
+}
+
+// End the current document or array, patch its size
+void FTFBsonWriter::EndDocument()
+{
+	Buffer.Add(0);
+	const int32 Offset = OpenDocuments.Pop(false);
+	const int32 Size = Buffer.Num() - Offset;
+	FMemory::Memcpy(Buffer.GetData() + Offset, &Size, sizeof(int32));
+}
+
+// Write a double element
+void FTFBsonWriter::WriteDouble(const ANSICHAR* InKey, const double InValue)
+{
+	WriteElementHeader(TFBsonType::Double, InKey);
+	WriteBytes(&InValue, sizeof(double));
+}
+
+// Write an int32 element
+void FTFBsonWriter::WriteInt32(const ANSICHAR* InKey, const int32 InValue)
+{
+	WriteElementHeader(TFBsonType::Int32, InKey);
+	WriteBytes(&InValue, sizeof(int32));
+}
+
+// Write an int64 element
+void FTFBsonWriter::WriteInt64(const ANSICHAR* InKey, const int64 InValue)
+{
+	WriteElementHeader(TFBsonType::Int64, InKey);
+	WriteBytes(&InValue, sizeof(int64));
+}
+
+// Write a boolean element
+void FTFBsonWriter::WriteBool(const ANSICHAR* InKey, const bool bInValue)
+{
+	WriteElementHeader(TFBsonType::Bool, InKey);
+	Buffer.Add(bInValue ? 1 : 0);
+}
+
+// Write an UTF-8 string element
+void FTFBsonWriter::WriteString(const ANSICHAR* InKey, const FString& InValue)
+{
+	WriteElementHeader(TFBsonType::String, InKey);
+	FTCHARToUTF8 UTF8Value(*InValue);
+	const int32 Length = UTF8Value.Length() + 1;
+	WriteBytes(&Length, sizeof(int32));
+	WriteBytes(UTF8Value.Get(), Length);
+}
+
+// Write an UTF-8 string element from already encoded characters
+void FTFBsonWriter::WriteString(const ANSICHAR* InKey, const ANSICHAR* InUtf8Value, const int32 InLength)
+{
+	WriteElementHeader(TFBsonType::String, InKey);
+	const int32 Length = InLength + 1;
+	WriteBytes(&Length, sizeof(int32));
+	WriteBytes(InUtf8Value, InLength);
+	Buffer.Add(0);
+}
+
+// Write a generic binary element
+void FTFBsonWriter::WriteBinary(const ANSICHAR* InKey, const uint8* InData, const int32 InNum)
+{
+	WriteElementHeader(TFBsonType::Binary, InKey);
+	WriteBytes(&InNum, sizeof(int32));
+	// Generic binary subtype
+	Buffer.Add(0x00);
+	WriteBytes(InData, InNum);
+}
+
+// Write the element type and its key
+void FTFBsonWriter::WriteElementHeader(const uint8 InType, const ANSICHAR* InKey)
+{
+	Buffer.Add(InType);
+	WriteBytes(InKey, FCStringAnsi::Strlen(InKey) + 1);
+}
+
+// Write the element type and an array index as key
+void FTFBsonWriter::WriteElementHeader(const uint8 InType, const int32 InArrayIndex)
+{
+	Buffer.Add(InType);
+
+	// Decimal digits of the index, written in reverse
+	ANSICHAR Digits[12];
+	int32 NumDigits = 0;
+	uint32 Value = static_cast<uint32>(InArrayIndex);
+	do
+	{
+		Digits[NumDigits++] = '0' + (Value % 10);
+		Value /= 10;
+	} while (Value > 0);
+	while (NumDigits > 0)
+	{
+		Buffer.Add(Digits[--NumDigits]);
+	}
+	Buffer.Add(0);
+}
+
+// Write an advertise operation
+void FTFBson::WriteAdvertiseOp(TArray<uint8>& OutBuffer, const FString& InTopic, const FString& InType, const bool bInLatch)
+{
+	FTFBsonWriter Writer(OutBuffer);
+	Writer.BeginDocument();
+	Writer.WriteString("op", TEXT("advertise"));
+	Writer.WriteString("topic", InTopic);
+	Writer.WriteString("type", InType);
+	if (bInLatch)
+	{
+		Writer.WriteBool("latch", true);
+	}
+	Writer.EndDocument();
+}
+
+// Write an unadvertise operation
+void FTFBson::WriteUnadvertiseOp(TArray<uint8>& OutBuffer, const FString& InTopic)
+{
+	FTFBsonWriter Writer(OutBuffer);
+	Writer.BeginDocument();
+	Writer.WriteString("op", TEXT("unadvertise"));
+	Writer.WriteString("topic", InTopic);
+	Writer.EndDocument();
+}
+
+// Write a publish operation of the transforms in the [Start, End) positions of the snapshot
+void FTFBson::WriteTFPublishOp(TArray<uint8>& OutBuffer, const FString& InTopic, const FTFSnapshot& InSnapshot,
+	const int32 InStart, const int32 InEnd)
+{
+	FTFBsonWriter Writer(OutBuffer);
+	Writer.BeginDocument();
+	Writer.WriteString("op", TEXT("publish"));
+	Writer.WriteString("topic", InTopic);
+	Writer.BeginDocument("msg");
+	Writer.BeginArray("transforms");
+	for (int32 Pos = InStart; Pos < InEnd; ++Pos)
+	{
+		const int32 Idx = InSnapshot.Indices[Pos];
+
+		// Transform to ROS coordinate system
+		const FTransform ROSTransf = FConversions::UToROS(InSnapshot.Transforms[Pos]);
+		const FVector Translation = ROSTransf.GetLocation();
+		const FQuat Rotation = ROSTransf.GetRotation();
+
+		Writer.BeginDocument(Pos - InStart);
+		{
+			Writer.BeginDocument("header");
+			Writer.WriteInt64("seq", InSnapshot.Seq);
+			Writer.BeginDocument("stamp");
+			Writer.WriteInt64("secs", InSnapshot.Time.Secs);
+			Writer.WriteInt32("nsecs", InSnapshot.Time.NSecs);
+			Writer.EndDocument();
+			const FTFInternedId& ParentFrameId = InSnapshot.Schema->Utf8ParentFrameIds[Idx];
+			Writer.WriteString("frame_id", InSnapshot.Schema->GetUtf8(ParentFrameId), ParentFrameId.Length);
+			Writer.EndDocument();
+		}
+		const FTFInternedId& FrameId = InSnapshot.Schema->Utf8FrameIds[Idx];
+		Writer.WriteString("child_frame_id", InSnapshot.Schema->GetUtf8(FrameId), FrameId.Length);
+		{
+			Writer.BeginDocument("transform");
+			Writer.BeginDocument("translation");
+			Writer.WriteDouble("x", Translation.X);
+			Writer.WriteDouble("y", Translation.Y);
+			Writer.WriteDouble("z", Translation.Z);
+			Writer.EndDocument();
+			Writer.BeginDocument("rotation");
+			Writer.WriteDouble("x", Rotation.X);
+			Writer.WriteDouble("y", Rotation.Y);
+			Writer.WriteDouble("z", Rotation.Z);
+			Writer.WriteDouble("w", Rotation.W);
+			Writer.EndDocument();
+			Writer.EndDocument();
+		}
+		Writer.EndDocument();
+	}
+	Writer.EndDocument(); // transforms
+	Writer.EndDocument(); // msg
+	Writer.EndDocument();
+}
+
+// Write a publish operation of a std_msgs/UInt8MultiArray with the bytes as binary data
+void FTFBson::WriteBytesPublishOp(TArray<uint8>& OutBuffer, const FString& InTopic, const uint8* InData, const int32 InNum)
+{
+	FTFBsonWriter Writer(OutBuffer);
+	Writer.BeginDocument();
+	Writer.WriteString("op", TEXT("publish"));
+	Writer.WriteString("topic", InTopic);
+	Writer.BeginDocument("msg");
+	{
+		Writer.BeginDocument("layout");
+		Writer.BeginArray("dim");
+		Writer.EndDocument();
+		Writer.WriteInt32("data_offset", 0);
+		Writer.EndDocument();
+	}
+	Writer.WriteBinary("data", InData, InNum);
+	Writer.EndDocument(); // msg
+	Writer.EndDocument();
+}
+
+// BSON reader helpers
+namespace TFBsonReader
+{
+	static TSharedPtr<FJsonValue> ReadValue(const uint8 InType, const uint8*& Data, const uint8* End);
+
+	// Read the elements of a document, calls the visitor with every key and value
+	template<typename VisitorType>
+	static bool ReadElements(const uint8*& Data, const uint8* End, VisitorType Visitor)
+	{
+		int32 Size;
+		if (End - Data < 5)
+		{
+			return false;
+		}
+		FMemory::Memcpy(&Size, Data, sizeof(int32));
+		if (Size < 5 || Size > End - Data)
+		{
+			return false;
+		}
+		const uint8* DocEnd = Data + Size - 1;
+		Data += sizeof(int32);
+
+		while (Data < DocEnd)
+		{
+			const uint8 Type = *Data++;
+			const uint8* KeyStart = Data;
+			while (Data < DocEnd && *Data != 0)
+			{
+				++Data;
+			}
+			if (Data >= DocEnd)
+			{
+				return false;
+			}
+			const FString Key = UTF8_TO_TCHAR(reinterpret_cast<const ANSICHAR*>(KeyStart));
+			++Data;
+
+			TSharedPtr<FJsonValue> Value = ReadValue(Type, Data, DocEnd);
+			if (!Value.IsValid())
+			{
+				return false;
+			}
+			Visitor(Key, Value);
+		}
+		// Document terminator
+		Data = DocEnd + 1;
+		return true;
+	}
+
+	// Read an element value
+	static TSharedPtr<FJsonValue> ReadValue(const uint8 InType, const uint8*& Data, const uint8* End)
+	{
+		switch (InType)
+		{
+		case TFBsonType::Double:
+		{
+			double Value;
+			if (End - Data < (int32)sizeof(double)) { return nullptr; }
+			FMemory::Memcpy(&Value, Data, sizeof(double));
+			Data += sizeof(double);
+			return MakeShareable(new FJsonValueNumber(Value));
+		}
+		case TFBsonType::Int32:
+		{
+			int32 Value;
+			if (End - Data < (int32)sizeof(int32)) { return nullptr; }
+			FMemory::Memcpy(&Value, Data, sizeof(int32));
+			Data += sizeof(int32);
+			return MakeShareable(new FJsonValueNumber(Value));
+		}
+		case TFBsonType::Int64:
+		{
+			int64 Value;
+			if (End - Data < (int32)sizeof(int64)) { return nullptr; }
+			FMemory::Memcpy(&Value, Data, sizeof(int64));
+			Data += sizeof(int64);
+			return MakeShareable(new FJsonValueNumber(Value));
+		}
+		case TFBsonType::Bool:
+		{
+			if (End - Data < 1) { return nullptr; }
+			return MakeShareable(new FJsonValueBoolean(*Data++ != 0));
+		}
+		case TFBsonType::Null:
+		{
+			return MakeShareable(new FJsonValueNull());
+		}
+		case TFBsonType::String:
+		{
+			int32 Length;
+			if (End - Data < (int32)sizeof(int32)) { return nullptr; }
+			FMemory::Memcpy(&Length, Data, sizeof(int32));
+			Data += sizeof(int32);
+			if (Length < 1 || Length > End - Data || Data[Length - 1] != 0) { return nullptr; }
+			const FString Value = UTF8_TO_TCHAR(reinterpret_cast<const ANSICHAR*>(Data));
+			Data += Length;
+			return MakeShareable(new FJsonValueString(Value));
+		}
+		case TFBsonType::Binary:
+		{
+			int32 Length;
+			if (End - Data < (int32)sizeof(int32) + 1) { return nullptr; }
+			FMemory::Memcpy(&Length, Data, sizeof(int32));
+			// Skip the size and the subtype
+			Data += sizeof(int32) + 1;
+			if (Length < 0 || Length > End - Data) { return nullptr; }
+			TArray<TSharedPtr<FJsonValue>> Values;
+			Values.Reserve(Length);
+			for (int32 Idx = 0; Idx < Length; ++Idx)
+			{
+				Values.Emplace(MakeShareable(new FJsonValueNumber(Data[Idx])));
+			}
+			Data += Length;
+			return MakeShareable(new FJsonValueArray(Values));
+		}
+		case TFBsonType::Document:
+		{
+			TSharedPtr<FJsonObject> Object = MakeShareable(new FJsonObject());
+			if (!ReadElements(Data, End, [&Object](const FString& Key, TSharedPtr<FJsonValue> Value)
+				{
+					Object->SetField(Key, Value);
+				}))
+			{
+				return nullptr;
+			}
+			return MakeShareable(new FJsonValueObject(Object));
+		}
+		case TFBsonType::Array:
+		{
+			TArray<TSharedPtr<FJsonValue>> Values;
+			if (!ReadElements(Data, End, [&Values](const FString& Key, TSharedPtr<FJsonValue> Value)
+				{
+					Values.Emplace(Value);
+				}))
+			{
+				return nullptr;
+			}
+			return MakeShareable(new FJsonValueArray(Values));
+		}
+		default:
+			// Unsupported type
+			return nullptr;
+		}
+	}
+}
+
+// Reference decoder, read a BSON document into a json object
+TSharedPtr<FJsonObject> FTFBson::ReadDocument(const uint8* InData, const int32 InNum)
+{
+	TSharedPtr<FJsonObject> Object = MakeShareable(new FJsonObject());
+	const uint8* Data = InData;
+	if (!TFBsonReader::ReadElements(Data, InData + InNum, [&Object](const FString& Key, TSharedPtr<FJsonValue> Value)
+		{
+			Object->SetField(Key, Value);
+		}))
+	{
+		return nullptr;
+	}
+	return Object;
+}
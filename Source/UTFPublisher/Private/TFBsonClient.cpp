@@ -0,0 +1,171 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFBsonClient.h"
+#include "TFBson.h"
+#include "IWebSocket.h"
+#include "WebSocketsModule.h"
+#include "TFStats.h"
+
+// Constructor
+FTFBsonClient::FTFBsonClient(const FString& InServerIP, const int32 InServerPORT)
+	: ServerURL(FString::Printf(TEXT("ws://%s:%d"), *InServerIP, InServerPORT))
+	, bUseCompactEncoding(false)
+	, bAdvertised(false)
+{
+}
+
+// Destructor
+FTFBsonClient::~FTFBsonClient()
+{
+	Disconnect();
+}
+
+// Add a tf2_msgs/TFMessage topic to advertise once connected
+void FTFBsonClient::AddTopic(const FString& InTopic, const bool bInLatch)
+{
+	Topics.Emplace(InTopic, bInLatch);
+}
+
+// Publish compact tf packets with the given precision instead of tf messages
+void FTFBsonClient::SetCompactEncoding(const FTFCompactSettings& InSettings)
+{
+	bUseCompactEncoding = true;
+	CompactSettings = InSettings;
+	CompactEncoders.Empty();
+}
+
+// Connect to the server, the topics are advertised once connected
+void FTFBsonClient::Connect()
+{
+	WebSocket = FModuleManager::LoadModuleChecked<FWebSocketsModule>(TEXT("WebSockets")).CreateWebSocket(ServerURL);
+
+	WebSocket->OnConnected().AddLambda([this]()
+	{
+		for (const auto& TopicItr : Topics)
+		{
+			Buffer.Reset();
+			FTFBson::WriteAdvertiseOp(Buffer, TopicItr.Key,
+				bUseCompactEncoding ? TEXT("std_msgs/UInt8MultiArray") : TEXT("tf2_msgs/TFMessage"), TopicItr.Value);
+			SendBuffer();
+			UE_LOG(LogTF, Log, TEXT("%s::%d Connected to %s (BSON), advertised %s.."),
+				TEXT(__FUNCTION__), __LINE__, *ServerURL, *TopicItr.Key);
+		}
+		bResetCompactEncoders = true;
+		bAdvertised = true;
+	});
+
+	WebSocket->OnConnectionError().AddLambda([this](const FString& Error)
+	{
+		bAdvertised = false;
+		UE_LOG(LogTF, Error, TEXT("%s::%d Could not connect to %s (BSON): %s.."),
+			TEXT(__FUNCTION__), __LINE__, *ServerURL, *Error);
+	});
+
+	WebSocket->OnClosed().AddLambda([this](int32 StatusCode, const FString& Reason, bool bWasClean)
+	{
+		bAdvertised = false;
+	});
+
+	WebSocket->Connect();
+}
+
+// Unadvertise the topics and close the connection
+void FTFBsonClient::Disconnect()
+{
+	if (WebSocket.IsValid())
+	{
+		if (bAdvertised)
+		{
+			for (const auto& TopicItr : Topics)
+			{
+				Buffer.Reset();
+				FTFBson::WriteUnadvertiseOp(Buffer, TopicItr.Key);
+				SendBuffer();
+			}
+			bAdvertised = false;
+		}
+		WebSocket->OnConnected().Clear();
+		WebSocket->OnConnectionError().Clear();
+		WebSocket->OnClosed().Clear();
+		WebSocket->Close();
+		WebSocket.Reset();
+	}
+}
+
+// Encode and send the snapshot to the topic (one message per chunk)
+int32 FTFBsonClient::Publish(const FString& InTopic, const FTFSnapshot& InSnapshot)
+{
+	int32 NumBytes = 0;
+	for (int32 ChunkIdx = 0; ChunkIdx < InSnapshot.NumChunks(); ++ChunkIdx)
+	{
+		NumBytes += PublishChunk(InTopic, InSnapshot, ChunkIdx);
+	}
+	return NumBytes;
+}
+
+// Encode and send a chunk of the snapshot to the topic
+int32 FTFBsonClient::PublishChunk(const FString& InTopic, const FTFSnapshot& InSnapshot, const int32 InChunkIdx)
+{
+	if (!bAdvertised)
+	{
+		INC_DWORD_STAT(STAT_TFDroppedMessages);
+		return 0;
+	}
+	int32 Start, End;
+	InSnapshot.GetChunk(InChunkIdx, Start, End);
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TFSerializeBson);
+		Buffer.Reset();
+		if (bUseCompactEncoding)
+		{
+			WriteCompactPublishOp(InTopic, InSnapshot, Start, End);
+		}
+		else
+		{
+			FTFBson::WriteTFPublishOp(Buffer, InTopic, InSnapshot, Start, End);
+		}
+	}
+	SendBuffer();
+	INC_DWORD_STAT(STAT_TFPublishedMessages);
+	INC_DWORD_STAT_BY(STAT_TFSerializedBytes, Buffer.Num());
+	TF_STAT_PUBLISH_LATENCY(FPlatformTime::Seconds() - InSnapshot.CaptureTime);
+	return Buffer.Num();
+}
+
+// Encode the chunk as a compact packet and write its publish operation
+void FTFBsonClient::WriteCompactPublishOp(const FString& InTopic, const FTFSnapshot& InSnapshot,
+	const int32 InStart, const int32 InEnd)
+{
+	if (bResetCompactEncoders)
+	{
+		CompactEncoders.Empty();
+		bResetCompactEncoders = false;
+	}
+
+	FTFCompactEncoder* Encoder = CompactEncoders.Find(InTopic);
+	if (Encoder == nullptr)
+	{
+		Encoder = &CompactEncoders.Emplace(InTopic, FTFCompactEncoder(CompactSettings));
+	}
+
+	// Latched topics only resend their last message, every packet has to be a keyframe
+	const TPair<FString, bool>* Topic = Topics.FindByPredicate([&InTopic](const TPair<FString, bool>& TopicItr)
+	{
+		return TopicItr.Key == InTopic;
+	});
+	if (Topic != nullptr && Topic->Value)
+	{
+		Encoder->Reset();
+	}
+
+	PacketBuffer.Reset();
+	Encoder->WritePacket(PacketBuffer, InSnapshot, InStart, InEnd);
+	FTFBson::WriteBytesPublishOp(Buffer, InTopic, PacketBuffer.GetData(), PacketBuffer.Num());
+}
+
+// Send the buffer as a binary frame
+void FTFBsonClient::SendBuffer()
+{
+	WebSocket->Send(Buffer.GetData(), Buffer.Num(), true);
+}
@@ -0,0 +1,102 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFBuffer.h"
+
+// Set the maximal number of samples
+void FTFBuffer::SetCapacity(const int32 InCapacity)
+{
+	if (Capacity != InCapacity)
+	{
+		Capacity = FMath::Max(InCapacity, 0);
+		Samples.Empty(Capacity);
+		Head = 0;
+	}
+}
+
+// Add a sample, the oldest one is overwritten if the buffer is full
+void FTFBuffer::Add(const float InTime, const FTransform& InTransform)
+{
+	if (Capacity == 0)
+	{
+		return;
+	}
+
+	if (Samples.Num() > 0)
+	{
+		const int32 NewestSlot = (Head + Samples.Num() - 1) % Samples.Num();
+		if (InTime < Samples[NewestSlot].Time)
+		{
+			return; // Out of order
+		}
+		else if (InTime == Samples[NewestSlot].Time)
+		{
+			Samples[NewestSlot].Transform = InTransform;
+			return;
+		}
+	}
+
+	if (Samples.Num() < Capacity)
+	{
+		FTFStampedTransform& Sample = Samples[Samples.AddDefaulted()];
+		Sample.Time = InTime;
+		Sample.Transform = InTransform;
+	}
+	else
+	{
+		Samples[Head].Time = InTime;
+		Samples[Head].Transform = InTransform;
+		Head = (Head + 1) % Capacity;
+	}
+}
+
+// Remove all samples
+void FTFBuffer::Reset()
+{
+	Samples.Reset();
+	Head = 0;
+}
+
+// Get the transform at the given time, interpolated between the enclosing samples
+bool FTFBuffer::Lookup(const float InTime, FTransform& OutTransform) const
+{
+	const int32 NumSamples = Samples.Num();
+	if (NumSamples == 0)
+	{
+		return false;
+	}
+
+	const FTFStampedTransform& Newest = At(NumSamples - 1);
+	if (InTime < 0.f || InTime >= Newest.Time)
+	{
+		OutTransform = Newest.Transform;
+		return true;
+	}
+
+	if (InTime < At(0).Time)
+	{
+		return false; // Older than the buffer
+	}
+
+	// Binary search the first sample not older than the given time
+	int32 Low = 1;
+	int32 High = NumSamples - 1;
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (At(Mid).Time < InTime)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+
+	const FTFStampedTransform& Before = At(Low - 1);
+	const FTFStampedTransform& After = At(Low);
+	const float Alpha = (InTime - Before.Time) / (After.Time - Before.Time);
+	OutTransform.Blend(Before.Transform, After.Transform, Alpha);
+	return true;
+}
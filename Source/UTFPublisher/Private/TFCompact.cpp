@@ -0,0 +1,442 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFCompact.h"
+#include "Conversions.h"
+
+// Compact packets coding helpers
+namespace TFCompactCoding
+{
+	// Range of the three smallest components of a unit quaternion
+	static const double MaxSmallestComponent = 0.70710678118654752;
+
+	// Map signed values to unsigned ones (small magnitudes stay small)
+	FORCEINLINE static uint64 ZigZag(const int64 InValue)
+	{
+		return (static_cast<uint64>(InValue) << 1) ^ static_cast<uint64>(InValue >> 63);
+	}
+
+	// Inverse of ZigZag
+	FORCEINLINE static int64 UnZigZag(const uint64 InValue)
+	{
+		return static_cast<int64>(InValue >> 1) ^ -static_cast<int64>(InValue & 1);
+	}
+
+	// Quantize the value to the given step
+	FORCEINLINE static int64 Quantize(const double InValue, const double InStep)
+	{
+		return static_cast<int64>(FMath::FloorToDouble(InValue / InStep + 0.5));
+	}
+
+	// Number of bytes of a smallest-three quaternion
+	FORCEINLINE static int32 GetRotationBytes(const int32 InBits)
+	{
+		return (2 + 3 * InBits + 7) / 8;
+	}
+
+	// Write raw bytes
+	FORCEINLINE static void WriteBytes(TArray<uint8>& OutBuffer, const void* InData, const int32 InNum)
+	{
+		const int32 Offset = OutBuffer.AddUninitialized(InNum);
+		FMemory::Memcpy(OutBuffer.GetData() + Offset, InData, InNum);
+	}
+
+	// Write an unsigned LEB128 variable length integer
+	FORCEINLINE static void WriteVarUint(TArray<uint8>& OutBuffer, uint64 InValue)
+	{
+		while (InValue >= 0x80)
+		{
+			OutBuffer.Add(static_cast<uint8>(InValue) | 0x80);
+			InValue >>= 7;
+		}
+		OutBuffer.Add(static_cast<uint8>(InValue));
+	}
+
+	// Write a length prefixed UTF-8 frame id
+	static void WriteFrameId(TArray<uint8>& OutBuffer, const FTFFrameSchema& InSchema, const FTFInternedId& InId)
+	{
+		WriteVarUint(OutBuffer, InId.Length);
+		WriteBytes(OutBuffer, InSchema.GetUtf8(InId), InId.Length);
+	}
+
+	// Write the unit quaternion as the index of its largest component and the quantized three others
+	static void WriteRotation(TArray<uint8>& OutBuffer, const FQuat& InRotation, const int32 InBits)
+	{
+		const FQuat Rotation = InRotation.GetNormalized();
+		const float Components[4] = { Rotation.X, Rotation.Y, Rotation.Z, Rotation.W };
+
+		int32 Largest = 0;
+		for (int32 Idx = 1; Idx < 4; ++Idx)
+		{
+			if (FMath::Abs(Components[Idx]) > FMath::Abs(Components[Largest]))
+			{
+				Largest = Idx;
+			}
+		}
+		// q and -q are the same rotation, the largest component is sent as positive
+		const double Sign = Components[Largest] < 0.f ? -1.0 : 1.0;
+		const double MaxValue = static_cast<double>((1 << InBits) - 1);
+
+		uint64 Packed = static_cast<uint64>(Largest);
+		int32 Shift = 2;
+		for (int32 Idx = 0; Idx < 4; ++Idx)
+		{
+			if (Idx != Largest)
+			{
+				const double Normalized = FMath::Clamp(
+					(Sign * Components[Idx] + MaxSmallestComponent) / (2.0 * MaxSmallestComponent), 0.0, 1.0);
+				Packed |= static_cast<uint64>(FMath::FloorToDouble(Normalized * MaxValue + 0.5)) << Shift;
+				Shift += InBits;
+			}
+		}
+
+		for (int32 Byte = 0; Byte < GetRotationBytes(InBits); ++Byte)
+		{
+			OutBuffer.Add(static_cast<uint8>(Packed >> (8 * Byte)));
+		}
+	}
+
+	/**
+	* FReader - Bounds checked reads from a packet
+	*/
+	struct FReader
+	{
+		// Constructor
+		FReader(const uint8* InData, const int32 InNum) : Data(InData), End(InData + InNum) {}
+
+		// Number of unread bytes
+		int64 Remaining() const { return End - Data; }
+
+		// Read raw bytes
+		bool ReadBytes(void* OutData, const int32 InNum)
+		{
+			if (Remaining() < InNum)
+			{
+				return false;
+			}
+			FMemory::Memcpy(OutData, Data, InNum);
+			Data += InNum;
+			return true;
+		}
+
+		// Read a value
+		template<typename T>
+		bool Read(T& OutValue)
+		{
+			return ReadBytes(&OutValue, sizeof(T));
+		}
+
+		// Read an unsigned LEB128 variable length integer
+		bool ReadVarUint(uint64& OutValue)
+		{
+			OutValue = 0;
+			for (int32 Shift = 0; Shift < 64; Shift += 7)
+			{
+				if (Data >= End)
+				{
+					return false;
+				}
+				const uint8 Byte = *Data++;
+				OutValue |= static_cast<uint64>(Byte & 0x7F) << Shift;
+				if ((Byte & 0x80) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Read a zigzag encoded variable length integer
+		bool ReadVarInt(int64& OutValue)
+		{
+			uint64 Value;
+			if (!ReadVarUint(Value))
+			{
+				return false;
+			}
+			OutValue = UnZigZag(Value);
+			return true;
+		}
+
+		// Read a length prefixed UTF-8 frame id
+		bool ReadFrameId(FString& OutFrameId)
+		{
+			uint64 Length;
+			if (!ReadVarUint(Length) || Length > static_cast<uint64>(Remaining()))
+			{
+				return false;
+			}
+			const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data), static_cast<int32>(Length));
+			OutFrameId = FString(Converted.Length(), Converted.Get());
+			Data += Length;
+			return true;
+		}
+
+		// Read a smallest-three quaternion
+		bool ReadRotation(const int32 InBits, FQuat& OutRotation)
+		{
+			const int32 NumBytes = GetRotationBytes(InBits);
+			if (Remaining() < NumBytes)
+			{
+				return false;
+			}
+			uint64 Packed = 0;
+			for (int32 Byte = 0; Byte < NumBytes; ++Byte)
+			{
+				Packed |= static_cast<uint64>(*Data++) << (8 * Byte);
+			}
+
+			const int32 Largest = static_cast<int32>(Packed & 0x3);
+			const uint64 Mask = (static_cast<uint64>(1) << InBits) - 1;
+			const double MaxValue = static_cast<double>(Mask);
+
+			double Components[4];
+			double SumSquared = 0.0;
+			int32 Shift = 2;
+			for (int32 Idx = 0; Idx < 4; ++Idx)
+			{
+				if (Idx != Largest)
+				{
+					const double Normalized = static_cast<double>((Packed >> Shift) & Mask) / MaxValue;
+					Components[Idx] = Normalized * 2.0 * MaxSmallestComponent - MaxSmallestComponent;
+					SumSquared += Components[Idx] * Components[Idx];
+					Shift += InBits;
+				}
+			}
+			Components[Largest] = FMath::Sqrt(FMath::Max(0.0, 1.0 - SumSquared));
+
+			OutRotation = FQuat(Components[0], Components[1], Components[2], Components[3]);
+			OutRotation.Normalize();
+			return true;
+		}
+
+		// Current position
+		const uint8* Data;
+
+		// End of the packet
+		const uint8* End;
+	};
+}
+
+// Constructor
+FTFCompactEncoder::FTFCompactEncoder(const FTFCompactSettings& InSettings)
+	: Settings(InSettings)
+	, SchemaId(0)
+	, LastSeq(0)
+	, bKeyframe(true)
+	, LastKeyframeTime(0.0)
+{
+	Settings.RotationBits = FMath::Clamp(Settings.RotationBits, FTFCompact::MinRotationBits, FTFCompact::MaxRotationBits);
+	Settings.TranslationStep = FMath::Max(Settings.TranslationStep, KINDA_SMALL_NUMBER);
+}
+
+// Forget the previous packets (the next packet is a keyframe)
+void FTFCompactEncoder::Reset()
+{
+	Schema.Reset();
+	References.Reset();
+	HasReference.Empty();
+}
+
+// Write the transforms in the [Start, End) positions of the snapshot as a packet
+void FTFCompactEncoder::WritePacket(TArray<uint8>& OutBuffer, const FTFSnapshot& InSnapshot,
+	const int32 InStart, const int32 InEnd)
+{
+	using namespace TFCompactCoding;
+
+	// The keyframe decision is taken on the first packet of every snapshot
+	const double StampTime = InSnapshot.Time.Secs + InSnapshot.Time.NSecs * 1e-9;
+	const bool bSchemaChanged = Schema != InSnapshot.Schema;
+	if (bSchemaChanged || InSnapshot.Seq != LastSeq)
+	{
+		bKeyframe = bSchemaChanged
+			|| Settings.KeyframeInterval <= 0.f
+			|| StampTime < LastKeyframeTime
+			|| StampTime - LastKeyframeTime >= Settings.KeyframeInterval;
+		if (bSchemaChanged)
+		{
+			if (Schema.IsValid())
+			{
+				++SchemaId;
+			}
+			Schema = InSnapshot.Schema;
+			References.SetNumZeroed(Schema->FrameIds.Num() * 3);
+			HasReference.Init(false, Schema->FrameIds.Num());
+		}
+		if (bKeyframe)
+		{
+			LastKeyframeTime = StampTime;
+		}
+		LastSeq = InSnapshot.Seq;
+	}
+
+	// Header, the schema is only written with the first chunk of a keyframe (the chunks keep their size limits)
+	const bool bWriteSchema = bKeyframe && InStart == 0;
+	const uint8 Flags = (bKeyframe ? FTFCompact::KeyframeFlag : 0) | (bWriteSchema ? FTFCompact::HasSchemaFlag : 0);
+	const uint8 RotationBits = static_cast<uint8>(Settings.RotationBits);
+	const uint32 Secs = InSnapshot.Time.Secs;
+	const uint32 NSecs = InSnapshot.Time.NSecs;
+	OutBuffer.Add(Flags);
+	OutBuffer.Add(RotationBits);
+	WriteBytes(OutBuffer, &SchemaId, sizeof(uint16));
+	WriteBytes(OutBuffer, &InSnapshot.Seq, sizeof(uint32));
+	WriteBytes(OutBuffer, &Secs, sizeof(uint32));
+	WriteBytes(OutBuffer, &NSecs, sizeof(uint32));
+	WriteBytes(OutBuffer, &Settings.TranslationStep, sizeof(float));
+
+	// Schema, sent with every keyframe for late joining listeners
+	if (bWriteSchema)
+	{
+		WriteVarUint(OutBuffer, Schema->FrameIds.Num());
+		for (int32 Idx = 0; Idx < Schema->FrameIds.Num(); ++Idx)
+		{
+			WriteFrameId(OutBuffer, *Schema, Schema->Utf8FrameIds[Idx]);
+			WriteFrameId(OutBuffer, *Schema, Schema->Utf8ParentFrameIds[Idx]);
+		}
+	}
+
+	// Transforms
+	WriteVarUint(OutBuffer, InEnd - InStart);
+	int32 PrevIdx = INDEX_NONE;
+	for (int32 Pos = InStart; Pos < InEnd; ++Pos)
+	{
+		const int32 Idx = InSnapshot.Indices[Pos];
+		const bool bAbsolute = bKeyframe || !HasReference[Idx];
+		WriteVarUint(OutBuffer, (ZigZag(Idx - PrevIdx - 1) << 1) | (bAbsolute ? 1 : 0));
+		PrevIdx = Idx;
+
+		// Transform to ROS coordinate system
+		const FTransform ROSTransf = FConversions::UToROS(InSnapshot.Transforms[Pos]);
+		const FVector Translation = ROSTransf.GetLocation();
+
+		int64* Reference = &References[Idx * 3];
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			const int64 Quantized = Quantize(Translation[Axis], Settings.TranslationStep);
+			WriteVarUint(OutBuffer, ZigZag(bAbsolute ? Quantized : Quantized - Reference[Axis]));
+			Reference[Axis] = Quantized;
+		}
+		HasReference[Idx] = true;
+
+		WriteRotation(OutBuffer, ROSTransf.GetRotation(), Settings.RotationBits);
+	}
+}
+
+// Decode the packet
+TSharedPtr<tf2_msgs::TFMessage> FTFCompactDecoder::Decode(const uint8* InData, const int32 InNum)
+{
+	using namespace TFCompactCoding;
+
+	FReader Reader(InData, InNum);
+	uint8 Flags, RotationBits;
+	uint16 PacketSchemaId;
+	uint32 Seq, Secs, NSecs;
+	float TranslationStep;
+	if (!Reader.Read(Flags) || !Reader.Read(RotationBits) || !Reader.Read(PacketSchemaId) ||
+		!Reader.Read(Seq) || !Reader.Read(Secs) || !Reader.Read(NSecs) || !Reader.Read(TranslationStep) ||
+		RotationBits < FTFCompact::MinRotationBits || RotationBits > FTFCompact::MaxRotationBits ||
+		!(TranslationStep > 0.f))
+	{
+		return nullptr;
+	}
+
+	// Every malformed packet invalidates the state, the decoding resumes with the next keyframe
+	auto Fail = [this]() -> TSharedPtr<tf2_msgs::TFMessage>
+	{
+		bHasSchema = false;
+		return nullptr;
+	};
+
+	if (Flags & FTFCompact::HasSchemaFlag)
+	{
+		uint64 NumFrames;
+		// Every frame takes at least two bytes
+		if (!Reader.ReadVarUint(NumFrames) || NumFrames > static_cast<uint64>(Reader.Remaining() / 2))
+		{
+			return Fail();
+		}
+		FrameIds.SetNum(static_cast<int32>(NumFrames));
+		ParentFrameIds.SetNum(static_cast<int32>(NumFrames));
+		for (int32 Idx = 0; Idx < FrameIds.Num(); ++Idx)
+		{
+			if (!Reader.ReadFrameId(FrameIds[Idx]) || !Reader.ReadFrameId(ParentFrameIds[Idx]))
+			{
+				return Fail();
+			}
+		}
+		if (!bHasSchema || SchemaId != PacketSchemaId || References.Num() != FrameIds.Num() * 3)
+		{
+			References.SetNumZeroed(FrameIds.Num() * 3);
+			HasReference.Init(false, FrameIds.Num());
+		}
+		SchemaId = PacketSchemaId;
+		bHasSchema = true;
+	}
+	else if (!bHasSchema || PacketSchemaId != SchemaId)
+	{
+		return nullptr;
+	}
+
+	uint64 NumTransforms;
+	if (!Reader.ReadVarUint(NumTransforms) || NumTransforms > static_cast<uint64>(FrameIds.Num()))
+	{
+		return Fail();
+	}
+
+	std_msgs::Header Header;
+	Header.SetSeq(Seq);
+	Header.SetStamp(FROSTime(Secs, NSecs));
+
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr = MakeShareable(new tf2_msgs::TFMessage());
+	int64 PrevIdx = INDEX_NONE;
+	for (uint64 Num = 0; Num < NumTransforms; ++Num)
+	{
+		uint64 Code;
+		if (!Reader.ReadVarUint(Code))
+		{
+			return Fail();
+		}
+		const bool bAbsolute = (Code & 1) != 0;
+		const int64 DecodedIdx = PrevIdx + 1 + UnZigZag(Code >> 1);
+		if (DecodedIdx < 0 || DecodedIdx >= FrameIds.Num())
+		{
+			return Fail();
+		}
+		const int32 Idx = static_cast<int32>(DecodedIdx);
+		if (!bAbsolute && !HasReference[Idx])
+		{
+			return Fail();
+		}
+		PrevIdx = Idx;
+
+		int64* Reference = &References[Idx * 3];
+		FVector Translation;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			int64 Value;
+			if (!Reader.ReadVarInt(Value))
+			{
+				return Fail();
+			}
+			Reference[Axis] = bAbsolute ? Value : Reference[Axis] + Value;
+			Translation[Axis] = static_cast<float>(Reference[Axis] * static_cast<double>(TranslationStep));
+		}
+		HasReference[Idx] = true;
+
+		FQuat Rotation;
+		if (!Reader.ReadRotation(RotationBits, Rotation))
+		{
+			return Fail();
+		}
+
+		Header.SetFrameId(ParentFrameIds[Idx]);
+		geometry_msgs::TransformStamped StampedTransformMsg;
+		StampedTransformMsg.SetHeader(Header);
+		StampedTransformMsg.SetChildFrameId(FrameIds[Idx]);
+		StampedTransformMsg.SetTransform(geometry_msgs::Transform(
+			geometry_msgs::Vector3(Translation),
+			geometry_msgs::Quaternion(Rotation)));
+		TFMsgPtr->AddTransform(StampedTransformMsg);
+	}
+	return TFMsgPtr;
+}
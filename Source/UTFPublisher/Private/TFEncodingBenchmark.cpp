@@ -0,0 +1,192 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "UTFPublisher.h"
+#include "HAL/IConsoleManager.h"
+#include "Conversions.h"
+#include "TFSnapshot.h"
+#include "TFBson.h"
+#include "TFCompact.h"
+#include "TFBenchmarkUtils.h"
+
+#if !UE_BUILD_SHIPPING
+/**
+* Compares the json and the BSON encoding of tf messages on synthetic trees,
+* the BSON output is decoded back with the reference decoder (as rosbridge_server would) and validated,
+* the compact packets (keyframe and delta of a slightly moved tree) are expanded and checked against the precision
+*
+* Usage: TF.BenchmarkEncoding [NumFrames ...] (default 1000 10000 50000)
+*/
+namespace TFEncodingBenchmark
+{
+	// Number of encodings averaged per tree size
+	static const int32 NumIterations = 10;
+
+	// Create a snapshot of a synthetic tree (every frame has four children)
+	static void CreateSnapshot(const int32 InNumFrames, FTFSnapshot& OutSnapshot)
+	{
+		TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe> Schema = MakeShareable(new FTFFrameSchema());
+		FRandomStream Random(InNumFrames);
+
+		TMap<FString, FTFInternedId> InternedIdsMap;
+
+		OutSnapshot.Reset();
+		OutSnapshot.Time = FROSTime::Now();
+		OutSnapshot.Seq = 0;
+		for (int32 Idx = 0; Idx < InNumFrames; ++Idx)
+		{
+			Schema->AddFrame(FString::Printf(TEXT("frame_%d"), Idx),
+				Idx == 0 ? TEXT("map") : FString::Printf(TEXT("frame_%d"), (Idx - 1) / 4), InternedIdsMap);
+			OutSnapshot.Indices.Emplace(Idx);
+			OutSnapshot.Transforms.Emplace(FTFBenchmarkUtils::RandomTransform(Random));
+		}
+		OutSnapshot.Schema = Schema;
+	}
+
+	// Decode the BSON publish operation and compare it with the snapshot
+	static bool ValidateBson(const TArray<uint8>& InBuffer, const FTFSnapshot& InSnapshot)
+	{
+		TSharedPtr<FJsonObject> OpObject = FTFBson::ReadDocument(InBuffer.GetData(), InBuffer.Num());
+		if (!OpObject.IsValid() || OpObject->GetStringField(TEXT("op")) != TEXT("publish"))
+		{
+			return false;
+		}
+
+		tf2_msgs::TFMessage TFMsg;
+		TFMsg.FromJson(OpObject->GetObjectField(TEXT("msg")));
+		const TArray<geometry_msgs::TransformStamped> Transforms = TFMsg.GetTransforms();
+		if (Transforms.Num() != InSnapshot.Num())
+		{
+			return false;
+		}
+
+		for (int32 Pos = 0; Pos < Transforms.Num(); ++Pos)
+		{
+			const int32 Idx = InSnapshot.Indices[Pos];
+			const FTransform ROSTransf = FConversions::UToROS(InSnapshot.Transforms[Pos]);
+			if (Transforms[Pos].GetChildFrameId() != InSnapshot.Schema->FrameIds[Idx] ||
+				Transforms[Pos].GetHeader().GetFrameId() != InSnapshot.Schema->ParentFrameIds[Idx] ||
+				!Transforms[Pos].GetTransform().GetTranslation().GetVector().Equals(ROSTransf.GetLocation(), KINDA_SMALL_NUMBER) ||
+				!Transforms[Pos].GetTransform().GetRotation().GetQuat().Equals(ROSTransf.GetRotation(), KINDA_SMALL_NUMBER))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Move every frame slightly (next publish of a slowly moving tree)
+	static void MoveSnapshot(FTFSnapshot& InOutSnapshot, FRandomStream& Random)
+	{
+		InOutSnapshot.Seq++;
+		InOutSnapshot.Time.Secs++;
+		for (auto& TransfItr : InOutSnapshot.Transforms)
+		{
+			TransfItr.AddToTranslation(Random.GetUnitVector() * Random.FRandRange(0.f, 0.5f));
+			TransfItr.ConcatenateRotation(FQuat(Random.GetUnitVector(), FMath::DegreesToRadians(Random.FRandRange(0.f, 0.5f))));
+		}
+	}
+
+	// Expand the compact packet with the decoder and compare it with the snapshot within the precision
+	static bool ValidateCompact(FTFCompactDecoder& Decoder, const TArray<uint8>& InPacket, const FTFSnapshot& InSnapshot,
+		const FTFCompactSettings& InSettings)
+	{
+		TSharedPtr<tf2_msgs::TFMessage> TFMsg = Decoder.Decode(InPacket.GetData(), InPacket.Num());
+		if (!TFMsg.IsValid())
+		{
+			return false;
+		}
+		const TArray<geometry_msgs::TransformStamped> Transforms = TFMsg->GetTransforms();
+		if (Transforms.Num() != InSnapshot.Num())
+		{
+			return false;
+		}
+
+		// Half a step per axis, the smallest-three components are off by half a step (about 0.7 / 2^bits) each
+		const float TranslationTolerance = InSettings.TranslationStep * 0.5f + KINDA_SMALL_NUMBER;
+		const float RotationTolerance = 8.f / (1 << InSettings.RotationBits) + KINDA_SMALL_NUMBER;
+		for (int32 Pos = 0; Pos < Transforms.Num(); ++Pos)
+		{
+			const int32 Idx = InSnapshot.Indices[Pos];
+			const FTransform ROSTransf = FConversions::UToROS(InSnapshot.Transforms[Pos]);
+			if (Transforms[Pos].GetChildFrameId() != InSnapshot.Schema->FrameIds[Idx] ||
+				Transforms[Pos].GetHeader().GetFrameId() != InSnapshot.Schema->ParentFrameIds[Idx] ||
+				!Transforms[Pos].GetTransform().GetTranslation().GetVector().Equals(ROSTransf.GetLocation(), TranslationTolerance) ||
+				Transforms[Pos].GetTransform().GetRotation().GetQuat().AngularDistance(ROSTransf.GetRotation()) > RotationTolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Run the benchmark for the given tree sizes
+	static void Run(const TArray<FString>& Args)
+	{
+		const TArray<int32> Sizes = FTFBenchmarkUtils::ParseSizes(Args, { 1000, 10000, 50000 });
+
+		for (const int32 NumFrames : Sizes)
+		{
+			FTFSnapshot Snapshot;
+			CreateSnapshot(NumFrames, Snapshot);
+
+			int32 JsonBytes = 0;
+			const double JsonStart = FPlatformTime::Seconds();
+			for (int32 Iter = 0; Iter < NumIterations; ++Iter)
+			{
+				JsonBytes = FTFBenchmarkUtils::EncodeJson(Snapshot.GetTFMessageMsg());
+			}
+			const double JsonMs = (FPlatformTime::Seconds() - JsonStart) * 1000.0 / NumIterations;
+
+			TArray<uint8> BsonBuffer;
+			const double BsonStart = FPlatformTime::Seconds();
+			for (int32 Iter = 0; Iter < NumIterations; ++Iter)
+			{
+				BsonBuffer.Reset();
+				FTFBson::WriteTFPublishOp(BsonBuffer, TEXT("/tf"), Snapshot);
+			}
+			const double BsonMs = (FPlatformTime::Seconds() - BsonStart) * 1000.0 / NumIterations;
+
+			UE_LOG(LogTF, Display, TEXT("%s::%d %d frames: JSON %.3f ms %d bytes, BSON %.3f ms %d bytes (x%.2f faster, x%.2f smaller), BSON decoding %s"),
+				TEXT(__FUNCTION__), __LINE__, NumFrames, JsonMs, JsonBytes, BsonMs, BsonBuffer.Num(),
+				BsonMs > 0.0 ? JsonMs / BsonMs : 0.0, BsonBuffer.Num() > 0 ? float(JsonBytes) / BsonBuffer.Num() : 0.f,
+				ValidateBson(BsonBuffer, Snapshot) ? TEXT("valid") : TEXT("INVALID"));
+
+			// Compact packets, a keyframe followed by a delta packet
+			FTFCompactSettings CompactSettings;
+			CompactSettings.KeyframeInterval = 0.f;
+			FTFCompactEncoder KeyframeEncoder(CompactSettings);
+			TArray<uint8> KeyframePacket;
+			const double CompactStart = FPlatformTime::Seconds();
+			for (int32 Iter = 0; Iter < NumIterations; ++Iter)
+			{
+				KeyframePacket.Reset();
+				KeyframeEncoder.WritePacket(KeyframePacket, Snapshot);
+			}
+			const double CompactMs = (FPlatformTime::Seconds() - CompactStart) * 1000.0 / NumIterations;
+
+			CompactSettings.KeyframeInterval = 1000.f;
+			FTFCompactEncoder Encoder(CompactSettings);
+			FTFCompactDecoder Decoder;
+			TArray<uint8> DeltaPacket;
+			KeyframePacket.Reset();
+			Encoder.WritePacket(KeyframePacket, Snapshot);
+			const bool bKeyframeValid = ValidateCompact(Decoder, KeyframePacket, Snapshot, CompactSettings);
+			FRandomStream Random(NumFrames);
+			MoveSnapshot(Snapshot, Random);
+			Encoder.WritePacket(DeltaPacket, Snapshot);
+			const bool bDeltaValid = ValidateCompact(Decoder, DeltaPacket, Snapshot, CompactSettings);
+
+			UE_LOG(LogTF, Display, TEXT("%s::%d %d frames: Compact %.3f ms, keyframe %d bytes, delta %d bytes (x%.2f smaller than BSON), compact decoding %s"),
+				TEXT(__FUNCTION__), __LINE__, NumFrames, CompactMs, KeyframePacket.Num(), DeltaPacket.Num(),
+				DeltaPacket.Num() > 0 ? float(BsonBuffer.Num()) / DeltaPacket.Num() : 0.f,
+				bKeyframeValid && bDeltaValid ? TEXT("valid") : TEXT("INVALID"));
+		}
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("TF.BenchmarkEncoding"),
+		TEXT("Compare the json, BSON and compact encoding of tf messages. Usage: TF.BenchmarkEncoding [NumFrames ...]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Run));
+}
+#endif // !UE_BUILD_SHIPPING
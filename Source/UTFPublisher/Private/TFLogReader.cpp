@@ -0,0 +1,508 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFLogReader.h"
+#include "HAL/PlatformFilemanager.h"
+
+/**
+* FTFLogRangeReader - Reads a byte range of the log, flags an error instead of asserting
+* when reading or seeking past its end (truncated or corrupt logs)
+*/
+class FTFLogRangeReader : public FArchive
+{
+public:
+	// Constructor
+	FTFLogRangeReader(const uint8* InData, const int64 InSize)
+		: Data(InData)
+		, Size(InData ? InSize : 0)
+		, Pos(0)
+	{
+		ArIsLoading = true;
+		ArIsPersistent = true;
+		// Strings and arrays cannot be larger than the range
+		ArMaxSerializeSize = Size;
+		ArIsError = InData == nullptr;
+	}
+
+	// Read the bytes, zeroes them and flags the error if they are past the end
+	virtual void Serialize(void* V, int64 Length) override
+	{
+		if (ArIsError || Length < 0 || Length > Size - Pos)
+		{
+			if (Length > 0)
+			{
+				FMemory::Memzero(V, Length);
+			}
+			ArIsError = true;
+			return;
+		}
+		FMemory::Memcpy(V, Data + Pos, Length);
+		Pos += Length;
+	}
+
+	// Move to the position, flags the error if it is outside of the range
+	virtual void Seek(int64 InPos) override
+	{
+		if (InPos < 0 || InPos > Size)
+		{
+			ArIsError = true;
+			return;
+		}
+		Pos = InPos;
+	}
+
+	// Current position
+	virtual int64 Tell() override { return Pos; }
+
+	// Size of the range
+	virtual int64 TotalSize() override { return Size; }
+
+	// Name of the archive
+	virtual FString GetArchiveName() const override { return TEXT("FTFLogRangeReader"); }
+
+	// Check that the remaining bytes can hold the number of elements, flags the error if not
+	bool CheckNum(const int32 InNum, const int64 InElementSize)
+	{
+		if (InNum < 0 || InNum * InElementSize > Size - Pos)
+		{
+			ArIsError = true;
+		}
+		return !ArIsError;
+	}
+
+private:
+	// Bytes of the range
+	const uint8* Data;
+
+	// Size of the range
+	int64 Size;
+
+	// Read position
+	int64 Pos;
+};
+
+// Serialized sizes of the log entries (bytes)
+namespace TFLogSize
+{
+	// Sample time and data offset
+	static const int64 SampleEntry = sizeof(double) + sizeof(int32);
+
+	// Frame idx, translation, rotation
+	static const int64 Transform = sizeof(int32) + 3 * sizeof(float) + 4 * sizeof(float);
+
+	// Two empty strings (length only)
+	static const int64 MinFrame = 2 * sizeof(int32);
+
+	// Index chunk entry
+	static const int64 ChunkInfo = 2 * sizeof(int64) + 2 * sizeof(double) + sizeof(int32);
+}
+
+// Constructor
+FTFLogReader::FTFLogReader()
+	: FileHandle(nullptr)
+	, MappedHandle(nullptr)
+	, MappedRegion(nullptr)
+	, FileSize(0)
+{
+}
+
+// Destructor
+FTFLogReader::~FTFLogReader()
+{
+	Close();
+}
+
+// Open the log and read its index
+bool FTFLogReader::Open(const FString& InFilePath)
+{
+	Close();
+
+	// Map the file, or read it on demand
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedHandle = PlatformFile.OpenMapped(*InFilePath);
+	if (MappedHandle)
+	{
+		FileSize = MappedHandle->GetFileSize();
+		MappedRegion = MappedHandle->MapRegion(0, FileSize);
+	}
+	if (MappedRegion == nullptr)
+	{
+		delete MappedHandle;
+		MappedHandle = nullptr;
+		FileHandle = PlatformFile.OpenRead(*InFilePath);
+		if (FileHandle == nullptr)
+		{
+			UE_LOG(LogTF, Error, TEXT("%s::%d Could not open %s.."), TEXT(__FUNCTION__), __LINE__, *InFilePath);
+			return false;
+		}
+		FileSize = FileHandle->Size();
+	}
+
+	// Check the header
+	const uint8* HeaderData = FileSize >= FTFLog::HeaderSize ? GetRange(0, FTFLog::HeaderSize) : nullptr;
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	if (HeaderData)
+	{
+		FTFLogRangeReader Reader(HeaderData, FTFLog::HeaderSize);
+		Reader << Magic << Version;
+	}
+	if (Magic != FTFLog::FileMagic || Version != FTFLog::Version)
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d %s is not a tf log (version %u).."),
+			TEXT(__FUNCTION__), __LINE__, *InFilePath, FTFLog::Version);
+		Close();
+		return false;
+	}
+
+	if (!ReadIndex() && !ScanRecords())
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d Could not index %s.."), TEXT(__FUNCTION__), __LINE__, *InFilePath);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+// Close the log
+void FTFLogReader::Close()
+{
+	delete MappedRegion;
+	MappedRegion = nullptr;
+	delete MappedHandle;
+	MappedHandle = nullptr;
+	delete FileHandle;
+	FileHandle = nullptr;
+	FileSize = 0;
+	ReadBuffer.Empty();
+	Schemas.Empty();
+	ParentIndices.Empty();
+	Chunks.Empty();
+}
+
+// Read the last sample at or before the given time into the snapshot
+bool FTFLogReader::ReadSample(const double InTime, FTFSnapshot& OutSnapshot, double& OutSampleTime, int32& OutSchemaIdx)
+{
+	if (Chunks.Num() == 0)
+	{
+		return false;
+	}
+
+	// Last chunk starting at or before the time (the first chunk for earlier times)
+	int32 ChunkIdx = 0;
+	int32 LastChunkIdx = Chunks.Num() - 1;
+	while (ChunkIdx < LastChunkIdx)
+	{
+		const int32 Mid = (ChunkIdx + LastChunkIdx + 1) / 2;
+		if (Chunks[Mid].FirstTime <= InTime)
+		{
+			ChunkIdx = Mid;
+		}
+		else
+		{
+			LastChunkIdx = Mid - 1;
+		}
+	}
+	const FTFLogChunkInfo& ChunkInfo = Chunks[ChunkIdx];
+
+	const uint8* ChunkData = GetRange(ChunkInfo.Offset, ChunkInfo.Size);
+	if (ChunkData == nullptr)
+	{
+		return false;
+	}
+	FTFLogRangeReader Reader(ChunkData, ChunkInfo.Size);
+	Reader.Seek(FTFLog::RecordHeaderSize);
+	int32 SchemaIdx = INDEX_NONE;
+	int32 NumSamples = 0;
+	int32 DataSize = 0;
+	Reader << SchemaIdx << NumSamples << DataSize;
+	if (!Schemas.IsValidIndex(SchemaIdx) || NumSamples <= 0 || !Reader.CheckNum(NumSamples, TFLogSize::SampleEntry))
+	{
+		return false;
+	}
+
+	// Last sample at or before the time (binary search over the sample times)
+	const int64 TimesOffset = FTFLog::RecordHeaderSize + FTFLog::ChunkFieldsSize;
+	auto GetSampleTime = [&Reader, TimesOffset](const int32 InSampleIdx)
+	{
+		double SampleTime;
+		Reader.Seek(TimesOffset + InSampleIdx * sizeof(double));
+		Reader << SampleTime;
+		return SampleTime;
+	};
+	int32 Low = 0;
+	int32 High = NumSamples - 1;
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High + 1) / 2;
+		if (GetSampleTime(Mid) <= InTime)
+		{
+			Low = Mid;
+		}
+		else
+		{
+			High = Mid - 1;
+		}
+	}
+	const double SampleTime = GetSampleTime(Low);
+
+	// Read the sample
+	int32 SampleOffset = 0;
+	const int64 OffsetsOffset = TimesOffset + NumSamples * sizeof(double);
+	Reader.Seek(OffsetsOffset + Low * sizeof(int32));
+	Reader << SampleOffset;
+	Reader.Seek(OffsetsOffset + NumSamples * sizeof(int32) + SampleOffset);
+
+	int32 NumTransforms = 0;
+	Reader << NumTransforms;
+	if (!Reader.CheckNum(NumTransforms, TFLogSize::Transform))
+	{
+		return false;
+	}
+	OutSnapshot.Reset();
+	OutSnapshot.Schema = Schemas[SchemaIdx];
+	OutSnapshot.Indices.SetNumUninitialized(NumTransforms, false);
+	OutSnapshot.Transforms.SetNumUninitialized(NumTransforms, false);
+	const int32 NumFrames = Schemas[SchemaIdx]->FrameIds.Num();
+	for (int32 Pos = 0; Pos < NumTransforms; ++Pos)
+	{
+		FVector Translation;
+		FQuat Rotation;
+		Reader << OutSnapshot.Indices[Pos] << Translation << Rotation;
+		if (OutSnapshot.Indices[Pos] < 0 || OutSnapshot.Indices[Pos] >= NumFrames)
+		{
+			return false; // Corrupt sample, the frame is not in the schema
+		}
+		OutSnapshot.Transforms[Pos] = FTransform(Rotation, Translation);
+	}
+	if (Reader.IsError())
+	{
+		return false;
+	}
+	OutSampleTime = SampleTime;
+	OutSchemaIdx = SchemaIdx;
+	return true;
+}
+
+// Read the index record from the footer offset
+bool FTFLogReader::ReadIndex()
+{
+	if (FileSize < FTFLog::HeaderSize + FTFLog::FooterSize)
+	{
+		return false;
+	}
+
+	const uint8* FooterData = GetRange(FileSize - FTFLog::FooterSize, FTFLog::FooterSize);
+	if (FooterData == nullptr)
+	{
+		return false;
+	}
+	int64 IndexOffset = 0;
+	uint32 Magic = 0;
+	{
+		FTFLogRangeReader FooterReader(FooterData, FTFLog::FooterSize);
+		FooterReader << IndexOffset << Magic;
+	}
+	const int64 IndexSize = FileSize - FTFLog::FooterSize - IndexOffset;
+	if (Magic != FTFLog::FileMagic || IndexOffset < FTFLog::HeaderSize || IndexSize < FTFLog::RecordHeaderSize)
+	{
+		return false;
+	}
+
+	const uint8* IndexData = GetRange(IndexOffset, IndexSize);
+	if (IndexData == nullptr)
+	{
+		return false;
+	}
+	TArray<int64> SchemaOffsets;
+	{
+		FTFLogRangeReader IndexReader(IndexData, IndexSize);
+		uint32 RecordMagic = 0;
+		int32 PayloadSize = 0;
+		IndexReader << RecordMagic << PayloadSize;
+		if (RecordMagic != FTFLog::IndexMagic)
+		{
+			return false;
+		}
+
+		// The array sizes are checked against the remaining bytes before allocating
+		int32 NumSchemas = 0;
+		IndexReader << NumSchemas;
+		if (IndexReader.CheckNum(NumSchemas, sizeof(int64)))
+		{
+			SchemaOffsets.SetNumUninitialized(NumSchemas);
+			for (int64& OffsetItr : SchemaOffsets)
+			{
+				IndexReader << OffsetItr;
+			}
+		}
+		int32 NumChunks = 0;
+		IndexReader << NumChunks;
+		if (IndexReader.CheckNum(NumChunks, TFLogSize::ChunkInfo))
+		{
+			Chunks.SetNum(NumChunks);
+			for (FTFLogChunkInfo& ChunkInfoItr : Chunks)
+			{
+				IndexReader << ChunkInfoItr;
+			}
+		}
+		if (IndexReader.IsError())
+		{
+			Chunks.Empty();
+			return false;
+		}
+	}
+
+	for (const int64 OffsetItr : SchemaOffsets)
+	{
+		if (!ReadSchema(OffsetItr))
+		{
+			Chunks.Empty();
+			return false;
+		}
+	}
+	return true;
+}
+
+// Index the log by scanning its records
+bool FTFLogReader::ScanRecords()
+{
+	UE_LOG(LogTF, Warning, TEXT("%s::%d The tf log has no index (interrupted write), scanning its records.."),
+		TEXT(__FUNCTION__), __LINE__);
+
+	Schemas.Empty();
+	ParentIndices.Empty();
+	Chunks.Empty();
+
+	int64 Offset = FTFLog::HeaderSize;
+	while (Offset + FTFLog::RecordHeaderSize <= FileSize)
+	{
+		uint32 RecordMagic = 0;
+		int32 PayloadSize = -1;
+		{
+			FTFLogRangeReader HeaderReader(GetRange(Offset, FTFLog::RecordHeaderSize), FTFLog::RecordHeaderSize);
+			HeaderReader << RecordMagic << PayloadSize;
+		}
+		const int64 RecordSize = FTFLog::RecordHeaderSize + PayloadSize;
+		if (PayloadSize < 0 || Offset + RecordSize > FileSize)
+		{
+			break; // Truncated record
+		}
+
+		if (RecordMagic == FTFLog::SchemaMagic)
+		{
+			if (!ReadSchema(Offset))
+			{
+				break;
+			}
+		}
+		else if (RecordMagic == FTFLog::ChunkMagic)
+		{
+			FTFLogRangeReader ChunkReader(GetRange(Offset, RecordSize), RecordSize);
+			ChunkReader.Seek(FTFLog::RecordHeaderSize);
+			int32 SchemaIdx = INDEX_NONE;
+			int32 NumSamples = 0;
+			int32 DataSize = 0;
+			ChunkReader << SchemaIdx << NumSamples << DataSize;
+			if (NumSamples > 0 && !ChunkReader.CheckNum(NumSamples, TFLogSize::SampleEntry))
+			{
+				break; // Corrupt record
+			}
+			if (NumSamples > 0)
+			{
+				FTFLogChunkInfo ChunkInfo;
+				ChunkInfo.Offset = Offset;
+				ChunkInfo.Size = RecordSize;
+				ChunkInfo.SchemaIdx = SchemaIdx;
+				ChunkReader << ChunkInfo.FirstTime;
+				ChunkReader.Seek(FTFLog::RecordHeaderSize + FTFLog::ChunkFieldsSize + (NumSamples - 1) * sizeof(double));
+				ChunkReader << ChunkInfo.LastTime;
+				if (ChunkReader.IsError())
+				{
+					break; // Corrupt record
+				}
+				Chunks.Emplace(ChunkInfo);
+			}
+		}
+		else if (RecordMagic != FTFLog::IndexMagic)
+		{
+			break; // Not a record
+		}
+		Offset += RecordSize;
+	}
+	return Chunks.Num() > 0;
+}
+
+// Read the schema record at the offset
+bool FTFLogReader::ReadSchema(const int64 InOffset)
+{
+	const uint8* HeaderData = GetRange(InOffset, FTFLog::RecordHeaderSize);
+	if (HeaderData == nullptr)
+	{
+		return false;
+	}
+	uint32 RecordMagic = 0;
+	int32 PayloadSize = -1;
+	{
+		FTFLogRangeReader HeaderReader(HeaderData, FTFLog::RecordHeaderSize);
+		HeaderReader << RecordMagic << PayloadSize;
+	}
+	if (RecordMagic != FTFLog::SchemaMagic || PayloadSize < 0 || InOffset + FTFLog::RecordHeaderSize + PayloadSize > FileSize)
+	{
+		return false;
+	}
+
+	FTFLogRangeReader Reader(GetRange(InOffset + FTFLog::RecordHeaderSize, PayloadSize), PayloadSize);
+	int32 NumFrames = 0;
+	Reader << NumFrames;
+	if (!Reader.CheckNum(NumFrames, TFLogSize::MinFrame))
+	{
+		return false;
+	}
+
+	TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe> Schema = MakeShareable(new FTFFrameSchema());
+	TMap<FString, FTFInternedId> InternedIdsMap;
+	TMap<FString, int32> FrameIdToIdx;
+	for (int32 Idx = 0; Idx < NumFrames && !Reader.IsError(); ++Idx)
+	{
+		FString FrameId;
+		FString ParentFrameId;
+		Reader << FrameId << ParentFrameId;
+		FrameIdToIdx.Emplace(FrameId, Idx);
+		Schema->AddFrame(FrameId, ParentFrameId, InternedIdsMap);
+	}
+	if (Reader.IsError())
+	{
+		return false;
+	}
+
+	// Parents are resolved by their frame ids (blank parents, e.g. the root, are not in the schema)
+	TArray<int32>& Parents = ParentIndices[ParentIndices.AddDefaulted()];
+	Parents.Reserve(NumFrames);
+	for (const auto& ParentFrameIdItr : Schema->ParentFrameIds)
+	{
+		const int32* ParentIdx = FrameIdToIdx.Find(ParentFrameIdItr);
+		Parents.Emplace(ParentIdx ? *ParentIdx : INDEX_NONE);
+	}
+	Schemas.Emplace(Schema);
+	return true;
+}
+
+// Get the bytes of the file range
+const uint8* FTFLogReader::GetRange(const int64 InOffset, const int64 InSize)
+{
+	if (InOffset < 0 || InSize < 0 || InOffset + InSize > FileSize)
+	{
+		return nullptr;
+	}
+	if (MappedRegion)
+	{
+		return MappedRegion->GetMappedPtr() + InOffset;
+	}
+	ReadBuffer.SetNumUninitialized(InSize, false);
+	if (!FileHandle->Seek(InOffset) || !FileHandle->Read(ReadBuffer.GetData(), InSize))
+	{
+		return nullptr;
+	}
+	return ReadBuffer.GetData();
+}
@@ -0,0 +1,246 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFLogWriter.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+// Constructor
+FTFLogWriter::FTFLogWriter(const FString& InFilePath, const int32 InSamplesPerChunk)
+	: FilePath(InFilePath)
+	, SamplesPerChunk(FMath::Max(InSamplesPerChunk, 1))
+	, FileHandle(nullptr)
+	, ChunkSchemaIdx(INDEX_NONE)
+	, WakeEvent(FPlatformProcess::GetSynchEventFromPool())
+	, bStopping(false)
+	, Thread(nullptr)
+{
+}
+
+// Destructor
+FTFLogWriter::~FTFLogWriter()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+// Open the file and start the writer thread
+bool FTFLogWriter::Start()
+{
+	if (Thread)
+	{
+		return true;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+	FileHandle = PlatformFile.OpenWrite(*FilePath);
+	if (FileHandle == nullptr)
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d Could not open %s for writing.."), TEXT(__FUNCTION__), __LINE__, *FilePath);
+		return false;
+	}
+
+	uint32 Magic = FTFLog::FileMagic;
+	uint32 Version = FTFLog::Version;
+	RecordBuffer.Reset();
+	FMemoryWriter Writer(RecordBuffer);
+	Writer << Magic << Version;
+	FileHandle->Write(RecordBuffer.GetData(), RecordBuffer.Num());
+
+	bStopping = false;
+	Thread = FRunnableThread::Create(this, TEXT("TFLogWriter"), 0, TPri_BelowNormal);
+	return true;
+}
+
+// Stop the writer thread, write the queued samples and the index, and close the file
+void FTFLogWriter::Shutdown()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (FileHandle)
+	{
+		WriteQueuedSamples();
+		FlushChunk();
+		WriteIndex();
+		delete FileHandle;
+		FileHandle = nullptr;
+		UE_LOG(LogTF, Log, TEXT("%s::%d Wrote %d chunks to %s.."), TEXT(__FUNCTION__), __LINE__, Chunks.Num(), *FilePath);
+	}
+}
+
+// Queue a copy of the snapshot transforms (game thread)
+void FTFLogWriter::Submit(const double InTime, const FTFSnapshot& InSnapshot)
+{
+	{
+		FScopeLock Lock(&QueueCriticalSection);
+		FSample& Sample = QueuedSamples[QueuedSamples.AddDefaulted()];
+		Sample.Time = InTime;
+		Sample.Schema = InSnapshot.Schema;
+		Sample.Indices = InSnapshot.Indices;
+		Sample.Transforms = InSnapshot.Transforms;
+	}
+	WakeEvent->Trigger();
+}
+
+// Take the queued samples and add them to the chunks
+void FTFLogWriter::WriteQueuedSamples()
+{
+	{
+		FScopeLock Lock(&QueueCriticalSection);
+		Swap(QueuedSamples, TakenSamples);
+	}
+	for (const auto& SampleItr : TakenSamples)
+	{
+		AddSample(SampleItr);
+	}
+	TakenSamples.Reset();
+}
+
+// Add the sample to the current chunk
+void FTFLogWriter::AddSample(const FSample& InSample)
+{
+	if (!InSample.Schema.IsValid())
+	{
+		return;
+	}
+
+	// The topology changed, start a new chunk with the new schema
+	if (InSample.Schema != ChunkSchema)
+	{
+		FlushChunk();
+		ChunkSchema = InSample.Schema;
+		ChunkSchemaIdx = SchemaOffsets.Num();
+		WriteSchema(*ChunkSchema);
+	}
+
+	ChunkTimes.Emplace(InSample.Time);
+	ChunkOffsets.Emplace(ChunkData.Num());
+
+	FMemoryWriter Writer(ChunkData, false, true);
+	int32 NumTransforms = InSample.Indices.Num();
+	Writer << NumTransforms;
+	for (int32 Pos = 0; Pos < NumTransforms; ++Pos)
+	{
+		int32 Idx = InSample.Indices[Pos];
+		FVector Translation = InSample.Transforms[Pos].GetTranslation();
+		FQuat Rotation = InSample.Transforms[Pos].GetRotation();
+		Writer << Idx << Translation << Rotation;
+	}
+
+	if (ChunkTimes.Num() >= SamplesPerChunk)
+	{
+		FlushChunk();
+	}
+}
+
+// Write the current chunk record
+void FTFLogWriter::FlushChunk()
+{
+	if (ChunkTimes.Num() == 0)
+	{
+		return;
+	}
+
+	FTFLogChunkInfo ChunkInfo;
+	ChunkInfo.Offset = FileHandle->Tell();
+	ChunkInfo.FirstTime = ChunkTimes[0];
+	ChunkInfo.LastTime = ChunkTimes.Last();
+	ChunkInfo.SchemaIdx = ChunkSchemaIdx;
+
+	RecordBuffer.Reset();
+	FMemoryWriter Writer(RecordBuffer);
+	int32 NumSamples = ChunkTimes.Num();
+	int32 DataSize = ChunkData.Num();
+	Writer << ChunkSchemaIdx << NumSamples << DataSize;
+	for (double& TimeItr : ChunkTimes)
+	{
+		Writer << TimeItr;
+	}
+	for (int32& OffsetItr : ChunkOffsets)
+	{
+		Writer << OffsetItr;
+	}
+	Writer.Serialize(ChunkData.GetData(), DataSize);
+	WriteRecord(FTFLog::ChunkMagic);
+
+	ChunkInfo.Size = FileHandle->Tell() - ChunkInfo.Offset;
+	Chunks.Emplace(ChunkInfo);
+
+	ChunkTimes.Reset();
+	ChunkOffsets.Reset();
+	ChunkData.Reset();
+}
+
+// Write the schema record
+void FTFLogWriter::WriteSchema(const FTFFrameSchema& InSchema)
+{
+	SchemaOffsets.Emplace(FileHandle->Tell());
+
+	RecordBuffer.Reset();
+	FMemoryWriter Writer(RecordBuffer);
+	int32 NumFrames = InSchema.FrameIds.Num();
+	Writer << NumFrames;
+	for (int32 Idx = 0; Idx < NumFrames; ++Idx)
+	{
+		Writer << const_cast<FString&>(InSchema.FrameIds[Idx]) << const_cast<FString&>(InSchema.ParentFrameIds[Idx]);
+	}
+	WriteRecord(FTFLog::SchemaMagic);
+}
+
+// Write the index record and the footer
+void FTFLogWriter::WriteIndex()
+{
+	int64 IndexOffset = FileHandle->Tell();
+
+	RecordBuffer.Reset();
+	FMemoryWriter Writer(RecordBuffer);
+	Writer << SchemaOffsets << Chunks;
+	WriteRecord(FTFLog::IndexMagic);
+
+	RecordBuffer.Reset();
+	FMemoryWriter FooterWriter(RecordBuffer);
+	uint32 Magic = FTFLog::FileMagic;
+	FooterWriter << IndexOffset << Magic;
+	FileHandle->Write(RecordBuffer.GetData(), RecordBuffer.Num());
+}
+
+// Write a record from the record buffer
+void FTFLogWriter::WriteRecord(const uint32 InMagic)
+{
+	uint8 Header[FTFLog::RecordHeaderSize];
+	const int32 PayloadSize = RecordBuffer.Num();
+	FMemory::Memcpy(Header, &InMagic, sizeof(uint32));
+	FMemory::Memcpy(Header + sizeof(uint32), &PayloadSize, sizeof(int32));
+	FileHandle->Write(Header, FTFLog::RecordHeaderSize);
+	FileHandle->Write(RecordBuffer.GetData(), PayloadSize);
+}
+
+// Writer loop
+uint32 FTFLogWriter::Run()
+{
+	while (!bStopping)
+	{
+		// Wake up on submits
+		WakeEvent->Wait(100);
+		WriteQueuedSamples();
+	}
+	return 0;
+}
+
+// Request the writer loop to stop
+void FTFLogWriter::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
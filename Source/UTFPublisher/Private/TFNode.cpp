@@ -3,197 +3,185 @@
 
 #include "TFNode.h"
 #include "TFTree.h"
-#include "Conversions.h"
-#include "geometry_msgs/TransformStamped.h"
+#include "GameFramework/Actor.h"
 
-// Sets default values for this component's properties
-UTFNode::UTFNode()
-{
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = false;
-
-	// ...
-}
-
-// Destructor
-UTFNode::~UTFNode()
-{
-}
-
-// Called when the game starts
-void UTFNode::BeginPlay()
+// Default constructor
+FTFNode::FTFNode()
 {
-	Super::BeginPlay();
-
-	// ...
-
-}
-
-// Called when the destroy process begins
-void UTFNode::BeginDestroy()
-{
-	Super::BeginDestroy();
-	
-	// Remove itself from the TF world tree
-	if (OwnerTree != nullptr)
-	{
-		OwnerTree->RemoveNode(this);
-	}
+	Parent = nullptr;
+	PublishRate = 0.f;
+	bStatic = false;
+	ActorBaseObject = nullptr;
+	SceneComponentBaseObject = nullptr;
+	Anchor = nullptr;
+
+	// Not in the tree (and its layout) yet
+	ArenaIndex = INDEX_NONE;
+	LayoutIndex = INDEX_NONE;
+	TreeIndex = INDEX_NONE;
+	ChildIndex = INDEX_NONE;
 }
 
 // Init node with attached parent as base class UObject
-void UTFNode::Init(const FString& InFrameId, FTFTree* InOwnerTree, UObject* InAttachedObject)
+void FTFNode::Init(const FString& InFrameId, UObject* InAttachedObject, float InPublishRate, bool bInStatic)
 {
 	FrameId = InFrameId;
-	OwnerTree = InOwnerTree;
-	GetTransformFunctionPtr = &UTFNode::GetTransform_AsIdentity;
+	PublishRate = InPublishRate;
+	bStatic = bInStatic;
 
 	// Check attached actor type
 	if (auto AA = Cast<AActor>(InAttachedObject))
 	{
 		ActorBaseObject = AA;
+		AttachedObject = AA;
+		AttachedActorKey = FObjectKey(AA);
 	}
 	else if (auto USC = Cast<USceneComponent>(InAttachedObject))
 	{
 		SceneComponentBaseObject = USC;
+		AttachedObject = USC;
+		AttachedActorKey = FObjectKey(USC->GetOwner());
 	}
 }
 
-// Bind transform function pointers
-void UTFNode::BindTransformFunction()
+// Get the actor of the attached object
+AActor* FTFNode::GetAttachedActor() const
 {
-	if (Parent)
+	return Cast<AActor>(AttachedActorKey.ResolveObjectPtr());
+}
+
+// Get the scene component providing the world transform
+USceneComponent* FTFNode::GetTransformSource() const
+{
+	if (SceneComponentBaseObject)
 	{
-		if (Parent->IsBlank())
-		{
-			// Node has parent, parent is blank, return world transform (avoid calculating unnecessary relative TFtransform)
-			if (ActorBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetWorldTransform_FromActor;
-			}
-			else if (SceneComponentBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetWorldTransform_FromSceneComponent;
-			}
-		}
-		else
-		{
-			// Node has parent, parent has a transform, calculate relative transform
-			if (ActorBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetRelativeTransform_FromActor;
-			}
-			else if (SceneComponentBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetRelativeTransform_FromSceneComponent;
-			}
-		}
+		return SceneComponentBaseObject;
 	}
-	else 
+	else if (ActorBaseObject)
 	{
-		// Node is root, not blank, return roots world transform (avoid calculating unnecessary relative TFtransform)
-		if (!IsBlank())
-		{
-			if (ActorBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetWorldTransform_FromActor;
-			}
-			else if (SceneComponentBaseObject)
-			{
-				GetTransformFunctionPtr = &UTFNode::GetWorldTransform_FromSceneComponent;
-			}
-		}
+		// The actor transform is the one of its root component
+		return ActorBaseObject->GetRootComponent();
 	}
+	return nullptr;
 }
 
-// Get as geometry_msgs::TransformStamped message
-geometry_msgs::TransformStamped UTFNode::GetTransformStampedMsg(const FROSTime& InTime, const uint32 InSeq) const
+// Add child
+void FTFNode::AddChild(FTFNode* InChildNode)
 {
-	geometry_msgs::TransformStamped StampedTransformMsg;
-
-	std_msgs::Header Header;
-	Header.SetSeq(InSeq);
-	const FString ParentFrameId = Parent != nullptr ?
-		Parent->FrameId : TEXT("None");
-	Header.SetFrameId(ParentFrameId);
-	Header.SetStamp(InTime);
-
-	// Transform to ROS coordinate system
-	FTransform ROSTransf = FConversions::UToROS(GetTransform());
-
-	geometry_msgs::Transform TransfMsg(
-		geometry_msgs::Vector3(ROSTransf.GetLocation()),
-		geometry_msgs::Quaternion(ROSTransf.GetRotation()));
-
-	StampedTransformMsg.SetHeader(Header);
-	StampedTransformMsg.SetChildFrameId(FrameId);
-	StampedTransformMsg.SetTransform(TransfMsg);
+	InChildNode->ChildIndex = Children.Emplace(InChildNode);
+	InChildNode->Parent = this;
+	InChildNode->TransformBuffer.Reset();
+}
 
-	return StampedTransformMsg;
+// Remove child, the last child is swapped into its place
+void FTFNode::RemoveChild(FTFNode* InChildNode)
+{
+	const int32 Idx = InChildNode->ChildIndex;
+	if (!Children.IsValidIndex(Idx) || Children[Idx] != InChildNode)
+	{
+		return; // Not a child of this node
+	}
+	Children.RemoveAtSwap(Idx, 1, false);
+	if (Children.IsValidIndex(Idx))
+	{
+		Children[Idx]->ChildIndex = Idx;
+	}
+	InChildNode->ChildIndex = INDEX_NONE;
+	InChildNode->Parent = nullptr;
 }
 
-// Add child
-void UTFNode::AddChild(UTFNode* InChildNode)
+// Move the node (with its subtree) from its parent to the new parent
+void FTFNode::AttachTo(FTFNode* InNewParent)
 {
-	Children.Emplace(InChildNode);
-	InChildNode->Parent = this;
+	if (Parent)
+	{
+		Parent->RemoveChild(this);
+	}
+	InNewParent->AddChild(this);
 }
 
 // Clear node linkings in tree, remove linking to parent, link children to parent
-void UTFNode::Clear()
+void FTFNode::Clear()
 {
 	if (!IsRoot())
 	{
 		// Remove yourself as a child of parent
-		Parent->Children.Remove(this);
+		FTFNode* PrevParent = Parent;
+		PrevParent->RemoveChild(this);
 		// Link your children to parent
 		for (auto& ChildItr : Children)
 		{
-			ChildItr->Parent = Parent;
-			// Recalculate transform binding function
-			// avoid unnecessary relative transform calculation
-			// if the child becomes a root child of a blank node
-			ChildItr->BindTransformFunction();
+			PrevParent->AddChild(ChildItr);
 		}
+		Children.Empty();
 	}
 	// If the node is root, the whole tree will get deleted;
 }
 
-// Get node transform
-FORCEINLINE FTransform UTFNode::GetTransform() const
+// Sets default values for this component's properties
+UTFNode::UTFNode()
 {
-	return (this->*GetTransformFunctionPtr)();
+	// The anchor only tracks the lifetime of its object
+	PrimaryComponentTick.bCanEverTick = false;
+
+	OwnerTree = nullptr;
+	Node = nullptr;
 }
 
-// Get the transform (default identity)
-FORCEINLINE FTransform UTFNode::GetTransform_AsIdentity() const
+// Called when the destroy process begins
+void UTFNode::BeginDestroy()
 {
-	return FTransform::Identity;
+	Super::BeginDestroy();
+
+	// Remove the node from the TF world tree
+	RemoveFromOwnerTree();
 }
 
-// Get the world transform of actor (node has non blank parent)
-FORCEINLINE FTransform UTFNode::GetRelativeTransform_FromActor() const
+// Called when the component (or its owner) is destroyed
+void UTFNode::OnComponentDestroyed(bool bDestroyingHierarchy)
 {
-	return ActorBaseObject->GetTransform().GetRelativeTransform(
-		Parent->ActorBaseObject->GetTransform());
+	Super::OnComponentDestroyed(bDestroyingHierarchy);
+
+	// Remove the node from the TF world tree right away (garbage collection happens later)
+	RemoveFromOwnerTree();
 }
 
-// Get the world transform of scene component
-FORCEINLINE FTransform UTFNode::GetRelativeTransform_FromSceneComponent() const
+// Anchor the node of the tree
+void UTFNode::Init(FTFTree* InOwnerTree, FTFNode* InNode)
 {
-	return SceneComponentBaseObject->GetComponentTransform().GetRelativeTransform(
-		Parent->SceneComponentBaseObject->GetComponentTransform());
+	OwnerTree = InOwnerTree;
+	Node = InNode;
+	Node->SetAnchor(this);
 }
 
-// Get the world transform of actor
-FORCEINLINE FTransform UTFNode::GetWorldTransform_FromActor() const
+// Stop removing the node from the owner tree on destruction
+void UTFNode::ReleaseOwnerTree()
 {
-	return ActorBaseObject->GetTransform();
+	if (Node != nullptr)
+	{
+		Node->SetAnchor(nullptr);
+	}
+	OwnerTree = nullptr;
+	Node = nullptr;
 }
 
-// Get the world transform of scene component
-FORCEINLINE FTransform UTFNode::GetWorldTransform_FromSceneComponent() const
+// Remove the node from the owner tree
+void UTFNode::RemoveFromOwnerTree()
 {
-	return SceneComponentBaseObject->GetComponentTransform();
+	if (OwnerTree != nullptr)
+	{
+		FTFTree* Tree = OwnerTree;
+		FTFNode* AnchoredNode = Node;
+		ReleaseOwnerTree();
+		Tree->RemoveNode(AnchoredNode);
+	}
+}
+
+// Called when a tracked actor is destroyed or its level is unloaded
+void UTFNodeListener::OnActorEndPlay(AActor* InActor, EEndPlayReason::Type InEndPlayReason)
+{
+	if (OwnerTree != nullptr)
+	{
+		OwnerTree->RemoveActorNodes(InActor);
+	}
 }
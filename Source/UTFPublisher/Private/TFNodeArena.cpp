@@ -0,0 +1,84 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFNodeArena.h"
+
+// Default constructor
+FTFNodeArena::FTFNodeArena()
+{
+	NumSlots = 0;
+	NumLive = 0;
+}
+
+// Destructor
+FTFNodeArena::~FTFNodeArena()
+{
+	Empty();
+}
+
+// Construct a node in a free slot
+FTFNode* FTFNodeArena::Allocate()
+{
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		// Reuse the last freed slot (still warm in the cache)
+		Slot = FreeSlots.Pop(false);
+	}
+	else
+	{
+		if (NumSlots == Pages.Num() * PageSize)
+		{
+			Pages.Emplace(static_cast<FTFNode*>(FMemory::Malloc(sizeof(FTFNode) * PageSize, alignof(FTFNode))));
+			LiveFlags.Add(false, PageSize);
+		}
+		Slot = NumSlots++;
+	}
+
+	FTFNode* Node = new (GetSlot(Slot)) FTFNode();
+	Node->SetArenaIndex(Slot);
+	LiveFlags[Slot] = true;
+	NumLive++;
+	return Node;
+}
+
+// Destruct the node and free its slot
+void FTFNodeArena::Free(FTFNode* InNode)
+{
+	const int32 Slot = InNode->GetArenaIndex();
+	if (!LiveFlags.IsValidIndex(Slot) || !LiveFlags[Slot] || GetSlot(Slot) != InNode)
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d Node %s is not live in the arena.."),
+			TEXT(__FUNCTION__), __LINE__, *InNode->GetFrameId());
+		return;
+	}
+	InNode->~FTFNode();
+	LiveFlags[Slot] = false;
+	FreeSlots.Push(Slot);
+	NumLive--;
+}
+
+// Destruct the live nodes and free the pages
+void FTFNodeArena::Empty()
+{
+	for (TConstSetBitIterator<> LiveItr(LiveFlags); LiveItr; ++LiveItr)
+	{
+		GetSlot(LiveItr.GetIndex())->~FTFNode();
+	}
+	for (FTFNode* PageItr : Pages)
+	{
+		FMemory::Free(PageItr);
+	}
+	Pages.Empty();
+	FreeSlots.Empty();
+	LiveFlags.Empty();
+	NumSlots = 0;
+	NumLive = 0;
+}
+
+// Allocated memory of the pages and the bookkeeping
+SIZE_T FTFNodeArena::GetAllocatedSize() const
+{
+	return Pages.Num() * PageSize * sizeof(FTFNode) + Pages.GetAllocatedSize()
+		+ FreeSlots.GetAllocatedSize() + LiveFlags.GetAllocatedSize();
+}
@@ -0,0 +1,139 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "UTFPublisher.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Engine/World.h"
+#include "UObject/UObjectArray.h"
+#include "TFTree.h"
+#include "TFBenchmarkUtils.h"
+
+#if !UE_BUILD_SHIPPING
+/**
+* Compares the node storages (an anchor component per node, or plain nodes in the arena of the tree)
+* on synthetic tag annotated worlds: build time, number of created UObjects, memory, garbage collection time
+* with the tree alive, and teardown time, the results are written as json to Saved/Benchmarks
+*
+* Usage: TF.BenchmarkNodeStorage [NumFrames ...] (default 1000 10000 100000)
+*/
+namespace TFNodeStorageBenchmark
+{
+	// Number of garbage collections averaged per run
+	static const int32 NumCollections = 5;
+
+	// Frame id of the root
+	static const TCHAR* RootFrameId = TEXT("map");
+
+	// Result of a run
+	struct FStorageResult
+	{
+		FString Storage;
+		int32 NumFrames;
+		double BuildMs;
+		int32 Objects;
+		int64 MemoryBytes;
+		int64 ArenaBytes;
+		double CollectMs;
+		double EmptyMs;
+	};
+
+	// Number of live UObjects
+	static int32 NumObjects()
+	{
+		return GUObjectArray.GetObjectArrayNumMinusAvailable();
+	}
+
+	// Build, collect and empty a tree with the given storage in a new world
+	static void RunStorage(const ETFNodeStorage InStorage, const int32 InNumFrames, TArray<FStorageResult>& OutResults)
+	{
+		// Every frame is a child of the root
+		UWorld* World = FTFBenchmarkUtils::CreateWorld();
+		FTFBenchmarkUtils::SpawnTaggedActors(World, InNumFrames, [](const int32 InIdx)
+		{
+			return FString(RootFrameId);
+		});
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+		FStorageResult& Result = OutResults[OutResults.AddDefaulted()];
+		Result.Storage = InStorage == ETFNodeStorage::Arena ? TEXT("arena") : TEXT("component");
+		Result.NumFrames = InNumFrames;
+		{
+			FTFTree TFTree;
+			TFTree.SetNodeStorage(InStorage);
+			TFTree.Init(RootFrameId);
+
+			const int32 ObjectsBefore = NumObjects();
+			const uint64 MemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+			const double BuildStart = FPlatformTime::Seconds();
+			TFTree.Build(World);
+			Result.BuildMs = (FPlatformTime::Seconds() - BuildStart) * 1000.0;
+			Result.Objects = NumObjects() - ObjectsBefore;
+			Result.MemoryBytes = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(MemoryBefore);
+			Result.ArenaBytes = TFTree.GetNodeArena().GetAllocatedSize();
+
+			// Every UObject is visited by the reachability analysis
+			const double CollectStart = FPlatformTime::Seconds();
+			for (int32 Iter = 0; Iter < NumCollections; ++Iter)
+			{
+				CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+			}
+			Result.CollectMs = (FPlatformTime::Seconds() - CollectStart) * 1000.0 / NumCollections;
+
+			const double EmptyStart = FPlatformTime::Seconds();
+			TFTree.Empty();
+			Result.EmptyMs = (FPlatformTime::Seconds() - EmptyStart) * 1000.0;
+		}
+
+		UE_LOG(LogTF, Display, TEXT("%s::%d %s %d frames: build %.3f ms, %d objects, %lld bytes (arena %lld bytes), gc %.3f ms, empty %.3f ms"),
+			TEXT(__FUNCTION__), __LINE__, *Result.Storage, InNumFrames, Result.BuildMs, Result.Objects, Result.MemoryBytes,
+			Result.ArenaBytes, Result.CollectMs, Result.EmptyMs);
+
+		FTFBenchmarkUtils::DestroyWorld(World);
+	}
+
+	// Write the results as json, returns the file path
+	static FString WriteResults(const TArray<FStorageResult>& InResults)
+	{
+		TArray<TSharedPtr<FJsonObject>> ResultObjects;
+		for (const auto& ResultItr : InResults)
+		{
+			TSharedPtr<FJsonObject> ResultObject = MakeShareable(new FJsonObject());
+			ResultObject->SetStringField(TEXT("storage"), ResultItr.Storage);
+			ResultObject->SetNumberField(TEXT("frames"), ResultItr.NumFrames);
+			ResultObject->SetNumberField(TEXT("build_ms"), ResultItr.BuildMs);
+			ResultObject->SetNumberField(TEXT("objects"), ResultItr.Objects);
+			ResultObject->SetNumberField(TEXT("memory_bytes"), ResultItr.MemoryBytes);
+			ResultObject->SetNumberField(TEXT("arena_bytes"), ResultItr.ArenaBytes);
+			ResultObject->SetNumberField(TEXT("gc_ms"), ResultItr.CollectMs);
+			ResultObject->SetNumberField(TEXT("empty_ms"), ResultItr.EmptyMs);
+			ResultObjects.Emplace(ResultObject);
+		}
+
+		TSharedRef<FJsonObject> RootObject = MakeShareable(new FJsonObject());
+		RootObject->SetNumberField(TEXT("collections"), NumCollections);
+		return FTFBenchmarkUtils::WriteResults(TEXT("TFNodeStorage"), RootObject, ResultObjects);
+	}
+
+	// Run the benchmark for the given tree sizes
+	static void Run(const TArray<FString>& Args)
+	{
+		const TArray<int32> Sizes = FTFBenchmarkUtils::ParseSizes(Args, { 1000, 10000, 100000 });
+
+		TArray<FStorageResult> Results;
+		for (const int32 NumFrames : Sizes)
+		{
+			RunStorage(ETFNodeStorage::Component, NumFrames, Results);
+			RunStorage(ETFNodeStorage::Arena, NumFrames, Results);
+		}
+
+		UE_LOG(LogTF, Display, TEXT("%s::%d Results written to %s"),
+			TEXT(__FUNCTION__), __LINE__, *WriteResults(Results));
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("TF.BenchmarkNodeStorage"),
+		TEXT("Compare the component and the arena node storage on synthetic worlds. Usage: TF.BenchmarkNodeStorage [NumFrames ...]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Run));
+}
+#endif // !UE_BUILD_SHIPPING
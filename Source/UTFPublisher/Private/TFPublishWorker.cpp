@@ -0,0 +1,499 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFPublishWorker.h"
+#include "TFBsonClient.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+#include "TFStats.h"
+
+// Constructor
+FTFPublishWorker::FTFPublishWorker(TSharedPtr<FROSBridgeHandler> InROSBridgeHandler, const FString& InTopic, const FString& InStaticTopic)
+	: ROSBridgeHandler(InROSBridgeHandler)
+	, Topic(InTopic)
+	, StaticTopic(InStaticTopic)
+	, WriteSnapshot(&Snapshots[0])
+	, PendingSnapshot(&Snapshots[1])
+	, ReadSnapshot(&Snapshots[2])
+	, bHasPendingSnapshot(false)
+	, ChunkQueueHead(0)
+	, ChunkQueueNum(0)
+	, bHasPendingStaticSnapshot(false)
+	, NumPendingSubmits(0)
+	, MaxSnapshotAge(0.f)
+	, FixedRate(0.f)
+	, bInterpolate(false)
+	, InterpolationDelay(0.f)
+	, SampledSeq(0)
+	, AchievedRate(0.f)
+	, JitterMs(0.f)
+	, WakeEvent(FPlatformProcess::GetSynchEventFromPool())
+	, bStopping(false)
+	, Thread(nullptr)
+{
+}
+
+// Constructor publishing with the BSON client
+FTFPublishWorker::FTFPublishWorker(TSharedPtr<FTFBsonClient> InBsonClient, const FString& InTopic, const FString& InStaticTopic)
+	: BsonClient(InBsonClient)
+	, Topic(InTopic)
+	, StaticTopic(InStaticTopic)
+	, WriteSnapshot(&Snapshots[0])
+	, PendingSnapshot(&Snapshots[1])
+	, ReadSnapshot(&Snapshots[2])
+	, bHasPendingSnapshot(false)
+	, ChunkQueueHead(0)
+	, ChunkQueueNum(0)
+	, bHasPendingStaticSnapshot(false)
+	, NumPendingSubmits(0)
+	, MaxSnapshotAge(0.f)
+	, FixedRate(0.f)
+	, bInterpolate(false)
+	, InterpolationDelay(0.f)
+	, SampledSeq(0)
+	, AchievedRate(0.f)
+	, JitterMs(0.f)
+	, WakeEvent(FPlatformProcess::GetSynchEventFromPool())
+	, bStopping(false)
+	, Thread(nullptr)
+{
+}
+
+// Destructor
+FTFPublishWorker::~FTFPublishWorker()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+// Add a channel topic, returns its index
+int32 FTFPublishWorker::AddChannel(const FString& InTopic)
+{
+	check(Thread == nullptr);
+	const int32 ChannelIdx = Channels.AddDefaulted();
+	Channels[ChannelIdx].Topic = InTopic;
+	Channels[ChannelIdx].bHasPendingSnapshot = false;
+	return ChannelIdx;
+}
+
+// Publish the latest snapshot at the given rate instead of on submit
+void FTFPublishWorker::SetFixedRate(const float InRate, const bool bInInterpolate, const float InInterpolationDelay)
+{
+	check(Thread == nullptr);
+	FixedRate = FMath::Max(InRate, 0.f);
+	bInterpolate = bInInterpolate;
+	InterpolationDelay = FMath::Max(InInterpolationDelay, 0.f);
+}
+
+// Get the achieved rate and the jitter of the last second
+void FTFPublishWorker::GetFixedRateStats(float& OutRate, float& OutJitterMs) const
+{
+	FScopeLock Lock(&StatsCriticalSection);
+	OutRate = AchievedRate;
+	OutJitterMs = JitterMs;
+}
+
+// Start the worker thread
+void FTFPublishWorker::Start()
+{
+	if (Thread == nullptr)
+	{
+		bStopping = false;
+		Thread = FRunnableThread::Create(this, TEXT("TFPublishWorker"), 0, TPri_Normal);
+	}
+}
+
+// Stop the worker thread and wait for it to finish
+void FTFPublishWorker::Shutdown()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+// Submit the written snapshot for publishing (game thread)
+void FTFPublishWorker::SubmitWriteSnapshot()
+{
+	{
+		FScopeLock Lock(&SwapCriticalSection);
+		Swap(WriteSnapshot, PendingSnapshot);
+		// A pending snapshot not yet taken by the worker is replaced (latest wins), the frames of a replaced
+		// partial snapshot count as published, they are carried over into the new one
+		if (bHasPendingSnapshot)
+		{
+			INC_DWORD_STAT(STAT_TFCoalescedSnapshots);
+			if (PendingSnapshot->bPartial)
+			{
+				PendingSnapshot->MergeOlder(*WriteSnapshot, MergeScratch);
+			}
+		}
+		bHasPendingSnapshot = true;
+		++NumPendingSubmits;
+	}
+	WakeEvent->Trigger();
+}
+
+// Queue a copy of the chunk of the snapshot for publishing, in submit order (game thread)
+void FTFPublishWorker::SubmitChunk(const FTFSnapshot& InSnapshot, const int32 InStart, const int32 InEnd)
+{
+	{
+		FScopeLock Lock(&SwapCriticalSection);
+		int32 Tail = (ChunkQueueHead + ChunkQueueNum) % FMath::Max(ChunkQueue.Num(), 1);
+		if (ChunkQueueNum == ChunkQueue.Num())
+		{
+			// Full, grow the ring with a slot before the oldest chunk
+			Tail = ChunkQueueHead;
+			ChunkQueue.Insert(FTFSnapshot(), Tail);
+			ChunkQueueHead = ChunkQueueNum > 0 ? ChunkQueueHead + 1 : 0;
+		}
+
+		FTFSnapshot& Chunk = ChunkQueue[Tail];
+		Chunk.Reset();
+		Chunk.Time = InSnapshot.Time;
+		Chunk.Seq = InSnapshot.Seq;
+		Chunk.bPartial = InSnapshot.bPartial;
+		Chunk.CaptureTime = InSnapshot.CaptureTime;
+		Chunk.Schema = InSnapshot.Schema;
+		Chunk.Indices.Append(InSnapshot.Indices.GetData() + InStart, InEnd - InStart);
+		Chunk.Transforms.Append(InSnapshot.Transforms.GetData() + InStart, InEnd - InStart);
+		++ChunkQueueNum;
+	}
+	WakeEvent->Trigger();
+}
+
+// Submit a copy of the static snapshot for publishing on the static topic (game thread)
+void FTFPublishWorker::SubmitStaticSnapshot(const FTFSnapshot& InStaticSnapshot)
+{
+	{
+		FScopeLock Lock(&SwapCriticalSection);
+		if (bHasPendingStaticSnapshot)
+		{
+			INC_DWORD_STAT(STAT_TFCoalescedSnapshots);
+		}
+		PendingStaticSnapshot = InStaticSnapshot;
+		bHasPendingStaticSnapshot = true;
+	}
+	WakeEvent->Trigger();
+}
+
+// Submit a copy of the channel snapshot for publishing on the channel topic (game thread)
+void FTFPublishWorker::SubmitChannelSnapshot(const int32 InChannelIdx, const FTFSnapshot& InSnapshot)
+{
+	{
+		FScopeLock Lock(&SwapCriticalSection);
+		FTFWorkerChannel& Channel = Channels[InChannelIdx];
+		if (Channel.bHasPendingSnapshot)
+		{
+			INC_DWORD_STAT(STAT_TFCoalescedSnapshots);
+		}
+		Channel.PendingSnapshot = InSnapshot;
+		Channel.bHasPendingSnapshot = true;
+	}
+	WakeEvent->Trigger();
+}
+
+// Take the pending snapshot for reading
+bool FTFPublishWorker::TakePendingSnapshot()
+{
+	int32 QueueDepth;
+	{
+		FScopeLock Lock(&SwapCriticalSection);
+		if (!bHasPendingSnapshot)
+		{
+			return false;
+		}
+		// Keep the current snapshot for the interpolation
+		if (FixedRate > 0.f && bInterpolate)
+		{
+			Swap(PrevSnapshot, *ReadSnapshot);
+		}
+		Swap(ReadSnapshot, PendingSnapshot);
+		bHasPendingSnapshot = false;
+		QueueDepth = NumPendingSubmits;
+		NumPendingSubmits = 0;
+	}
+	FScopeLock Lock(&StatsCriticalSection);
+	SendStats.MaxQueueDepth = FMath::Max(SendStats.MaxQueueDepth, QueueDepth);
+	return true;
+}
+
+// Check if the snapshot is older than the maximal age, counts it as stale
+bool FTFPublishWorker::IsStale(const FTFSnapshot& InSnapshot)
+{
+	if (MaxSnapshotAge > 0.f && FPlatformTime::Seconds() - InSnapshot.CaptureTime > MaxSnapshotAge)
+	{
+		INC_DWORD_STAT(STAT_TFStaleSnapshots);
+		FScopeLock Lock(&StatsCriticalSection);
+		SendStats.NumStale++;
+		return true;
+	}
+	return false;
+}
+
+// Add the latency of the sent snapshot to the send statistics
+void FTFPublishWorker::AddSent(const FTFSnapshot& InSnapshot)
+{
+	FScopeLock Lock(&StatsCriticalSection);
+	SendStats.LatencySum += FPlatformTime::Seconds() - InSnapshot.CaptureTime;
+	SendStats.NumSent++;
+}
+
+// Move the send statistics gathered since the last call into the given ones
+void FTFPublishWorker::ConsumeSendStats(FTFSendStats& OutSendStats)
+{
+	FScopeLock Lock(&StatsCriticalSection);
+	OutSendStats = SendStats;
+	SendStats = FTFSendStats();
+}
+
+// Take the oldest queued chunk for reading
+bool FTFPublishWorker::TakeChunk()
+{
+	FScopeLock Lock(&SwapCriticalSection);
+	if (ChunkQueueNum == 0)
+	{
+		return false;
+	}
+	Swap(ReadChunk, ChunkQueue[ChunkQueueHead]);
+	ChunkQueueHead = (ChunkQueueHead + 1) % ChunkQueue.Num();
+	--ChunkQueueNum;
+	return true;
+}
+
+// Take the pending static snapshot for reading
+bool FTFPublishWorker::TakeStaticSnapshot()
+{
+	FScopeLock Lock(&SwapCriticalSection);
+	if (!bHasPendingStaticSnapshot)
+	{
+		return false;
+	}
+	Swap(ReadStaticSnapshot, PendingStaticSnapshot);
+	bHasPendingStaticSnapshot = false;
+	return true;
+}
+
+// Take the pending snapshot of the channel for reading
+bool FTFPublishWorker::TakeChannelSnapshot(const int32 InChannelIdx)
+{
+	FScopeLock Lock(&SwapCriticalSection);
+	FTFWorkerChannel& Channel = Channels[InChannelIdx];
+	if (!Channel.bHasPendingSnapshot)
+	{
+		return false;
+	}
+	Swap(Channel.ReadSnapshot, Channel.PendingSnapshot);
+	Channel.bHasPendingSnapshot = false;
+	return true;
+}
+
+// Publish the snapshot to the topic (one message per chunk)
+void FTFPublishWorker::Publish(const FString& InTopic, const FTFSnapshot& InSnapshot)
+{
+	if (BsonClient.IsValid())
+	{
+		BsonClient->Publish(InTopic, InSnapshot);
+	}
+	else
+	{
+		for (int32 ChunkIdx = 0; ChunkIdx < InSnapshot.NumChunks(); ++ChunkIdx)
+		{
+			int32 Start, End;
+			InSnapshot.GetChunk(ChunkIdx, Start, End);
+			SCOPE_CYCLE_COUNTER(STAT_TFPublishMsg);
+			ROSBridgeHandler->PublishMsg(InTopic, InSnapshot.GetTFMessageMsg(Start, End));
+			INC_DWORD_STAT(STAT_TFPublishedMessages);
+			TF_STAT_PUBLISH_LATENCY(FPlatformTime::Seconds() - InSnapshot.CaptureTime);
+		}
+	}
+}
+
+// Worker loop
+uint32 FTFPublishWorker::Run()
+{
+	if (FixedRate > 0.f)
+	{
+		RunFixedRate();
+		return 0;
+	}
+
+	while (!bStopping)
+	{
+		// Wake up on submits, or periodically to keep processing the connection
+		WakeEvent->Wait(10);
+
+		if (TakeStaticSnapshot() && ReadStaticSnapshot.Num() > 0)
+		{
+			Publish(StaticTopic, ReadStaticSnapshot);
+		}
+		// Stale transforms are never sent, except partial snapshots (their frames count as published,
+		// they are still counted as stale for the adaptive rate)
+		if (TakePendingSnapshot() && ReadSnapshot->Num() > 0 && (!IsStale(*ReadSnapshot) || ReadSnapshot->bPartial))
+		{
+			Publish(Topic, *ReadSnapshot);
+			AddSent(*ReadSnapshot);
+		}
+		// Every queued chunk is sent, in order
+		while (TakeChunk())
+		{
+			Publish(Topic, ReadChunk);
+			AddSent(ReadChunk);
+		}
+		PublishSecondary();
+	}
+	return 0;
+}
+
+// Fixed rate worker loop
+void FTFPublishWorker::RunFixedRate()
+{
+	const double Period = 1.0 / FixedRate;
+	bool bHasReadSnapshot = false;
+
+	// Publish intervals of the current stats window
+	double NextPublishTime = FPlatformTime::Seconds();
+	double LastPublishTime = 0.0;
+	double WindowStart = NextPublishTime;
+	int32 WindowPublishes = 0;
+	double WindowDeviation = 0.0;
+
+	while (!bStopping)
+	{
+		WaitUntil(NextPublishTime);
+		const double Now = FPlatformTime::Seconds();
+
+		if (TakePendingSnapshot())
+		{
+			bHasReadSnapshot = true;
+		}
+		// Stale transforms are never sent (the game thread stopped providing new ones)
+		if (bHasReadSnapshot && ReadSnapshot->Num() > 0 && !IsStale(*ReadSnapshot))
+		{
+			SampleReadSnapshot(Now);
+			Publish(Topic, SampledSnapshot);
+			AddSent(SampledSnapshot);
+		}
+		if (TakeStaticSnapshot() && ReadStaticSnapshot.Num() > 0)
+		{
+			Publish(StaticTopic, ReadStaticSnapshot);
+		}
+		PublishSecondary();
+
+		// Deviation of the interval from the period
+		if (LastPublishTime > 0.0)
+		{
+			WindowDeviation += FMath::Abs((Now - LastPublishTime) - Period);
+			++WindowPublishes;
+		}
+		LastPublishTime = Now;
+		if (Now - WindowStart >= 1.0)
+		{
+			{
+				FScopeLock Lock(&StatsCriticalSection);
+				AchievedRate = static_cast<float>(WindowPublishes / (Now - WindowStart));
+				JitterMs = WindowPublishes > 0 ? static_cast<float>(WindowDeviation / WindowPublishes * 1000.0) : 0.f;
+				SET_FLOAT_STAT(STAT_TFFixedRate, AchievedRate);
+				SET_FLOAT_STAT(STAT_TFFixedRateJitter, JitterMs);
+				UE_LOG(LogTF, Verbose, TEXT("%s::%d Fixed rate publishing at %.1f Hz (target %.1f Hz), jitter %.3f ms.."),
+					TEXT(__FUNCTION__), __LINE__, AchievedRate, FixedRate, JitterMs);
+			}
+			WindowStart = Now;
+			WindowPublishes = 0;
+			WindowDeviation = 0.0;
+		}
+
+		// Keep the schedule, if the worker fell behind skip the missed publishes
+		NextPublishTime += Period;
+		if (NextPublishTime < FPlatformTime::Seconds())
+		{
+			NextPublishTime = FPlatformTime::Seconds() + Period;
+		}
+	}
+}
+
+// Sleep until the given platform time, the last millisecond is spent yielding for accuracy
+void FTFPublishWorker::WaitUntil(const double InTime) const
+{
+	while (!bStopping)
+	{
+		const double Remaining = InTime - FPlatformTime::Seconds();
+		if (Remaining <= 0.0)
+		{
+			return;
+		}
+		FPlatformProcess::Sleep(Remaining > 0.002 ? static_cast<float>(Remaining - 0.001) : 0.f);
+	}
+}
+
+// Sample the read snapshot at the given platform time into the sampled snapshot
+void FTFPublishWorker::SampleReadSnapshot(const double InTime)
+{
+	const FTFSnapshot& Newest = *ReadSnapshot;
+	const double SampleTime = InTime - (bInterpolate ? InterpolationDelay : 0.0);
+
+	SampledSnapshot.Reset();
+	SampledSnapshot.CaptureTime = InTime;
+	SampledSnapshot.Seq = SampledSeq++;
+	SampledSnapshot.bPartial = Newest.bPartial;
+	SampledSnapshot.Schema = Newest.Schema;
+	SampledSnapshot.Indices.Append(Newest.Indices);
+	SampledSnapshot.ChunkEnds.Append(Newest.ChunkEnds);
+
+	// Stamp with the sample time, relative to the ROS time of the newest snapshot
+	const double NewestStamp = Newest.Time.Secs + Newest.Time.NSecs * 1e-9;
+	const double SampleStamp = FMath::Max(NewestStamp + (SampleTime - Newest.CaptureTime), 0.0);
+	const double StampSecs = FMath::FloorToDouble(SampleStamp);
+	SampledSnapshot.Time = FROSTime(static_cast<uint32>(StampSecs),
+		FMath::Min(static_cast<uint32>((SampleStamp - StampSecs) * 1e9), 999999999u));
+
+	// Blend between the two latest snapshots if they have the same frames and bracket the sample time,
+	// otherwise hold the newest transforms
+	const bool bBlend = bInterpolate
+		&& PrevSnapshot.Schema == Newest.Schema
+		&& PrevSnapshot.CaptureTime < Newest.CaptureTime
+		&& SampleTime < Newest.CaptureTime
+		&& PrevSnapshot.Indices == Newest.Indices;
+	if (bBlend)
+	{
+		const float Alpha = FMath::Clamp(static_cast<float>(
+			(SampleTime - PrevSnapshot.CaptureTime) / (Newest.CaptureTime - PrevSnapshot.CaptureTime)), 0.f, 1.f);
+		SampledSnapshot.Transforms.SetNumUninitialized(Newest.Num(), false);
+		for (int32 Pos = 0; Pos < Newest.Num(); ++Pos)
+		{
+			SampledSnapshot.Transforms[Pos].Blend(PrevSnapshot.Transforms[Pos], Newest.Transforms[Pos], Alpha);
+		}
+	}
+	else
+	{
+		SampledSnapshot.Transforms.Append(Newest.Transforms);
+	}
+}
+
+// Publish the pending channel snapshots, and process the connection
+void FTFPublishWorker::PublishSecondary()
+{
+	for (int32 ChannelIdx = 0; ChannelIdx < Channels.Num(); ++ChannelIdx)
+	{
+		if (TakeChannelSnapshot(ChannelIdx) && Channels[ChannelIdx].ReadSnapshot.Num() > 0)
+		{
+			Publish(Channels[ChannelIdx].Topic, Channels[ChannelIdx].ReadSnapshot);
+		}
+	}
+	if (ROSBridgeHandler.IsValid())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TFProcess);
+		ROSBridgeHandler->Process();
+	}
+}
+
+// Request the worker loop to stop
+void FTFPublishWorker::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
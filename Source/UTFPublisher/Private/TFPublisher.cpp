@@ -2,6 +2,10 @@
 // Author: Andrei Haidu (http://haidu.eu)
 
 #include "TFPublisher.h"
+#include "TFBsonClient.h"
+#include "TFTopologyCache.h"
+#include "TFStats.h"
+#include "Engine/World.h"
 #include "tf2_msgs/TFMessage.h"
 
 // Sets default values
@@ -15,13 +19,89 @@ ATFPublisher::ATFPublisher()
 
 	// Update on tick by default
 	bUseConstantPublishRate = false;
+	bUseMultiRatePublishing = false;
 
 	// Use root node as blank (no relative transformations calculated with identity transform)
 	bUseBlankRootNode = true;
 
+	// One anchor component per node by default
+	NodeStorage = ETFNodeStorage::Component;
+
 	// Default timer delta time (s) (0 = on Tick)
 	ConstantPublishRate = 0.0f;
 
+	// Publish all frames every time by default
+	bUseDeltaPublishing = false;
+	DeltaTranslationEpsilon = 0.1f;
+	DeltaRotationEpsilon = 0.1f;
+	KeyframeInterval = 1.0f;
+
+	// Publish every frame on /tf, no channels by default
+	bPublishAllFrames = true;
+
+	// Single publisher for every namespace by default
+	bShardByNamespace = false;
+	bUseNamespaceTopics = false;
+
+	// Add the TF tagged actors spawned at runtime
+	bTrackSpawnedActors = true;
+
+	// Build the tree at BeginPlay by default
+	bUseAsyncBuild = false;
+	AsyncBuildFrameBudget = 2.f;
+	bUseTopologyCache = false;
+
+	// Publish every frame on /tf by default
+	bUseStaticDetection = false;
+	StaticInvarianceSamples = 50;
+	StaticCheckInterval = 1.0f;
+	StaticRepublishInterval = 5.0f;
+
+	// No transform history by default
+	bUseTransformBuffer = false;
+	TransformBufferSize = 100;
+
+	// Publish every frame in a single message by default
+	MaxTransformsPerMessage = 0;
+	MaxMessageBytes = 0;
+	bSpreadChunksOverTicks = false;
+
+	// Publish from the game thread by default
+	bUsePipelinedPublishing = false;
+
+	// Publish with the tick or timer by default
+	bUseFixedRatePublishing = false;
+	FixedPublishRate = 200.f;
+	bInterpolateFixedRate = true;
+	FixedRateInterpolationDelay = 0.02f;
+
+	// Publish at the tick or timer rate regardless of the backpressure by default
+	bUseAdaptiveRate = false;
+	AdaptiveMaxRate = 60.f;
+	AdaptiveMinRate = 5.f;
+	AdaptiveLatencyThreshold = 50.f;
+	AdaptiveQueueDepthThreshold = 2;
+	bAdaptiveDeltaMode = true;
+	MaxSnapshotAge = 100.f;
+
+	// No shared memory transport by default
+	bUseSharedMemory = false;
+	SharedMemoryName = TEXT("UTFPublisher_tf");
+	SharedMemorySlots = 8;
+	SharedMemoryMaxFrames = 16384;
+	bSharedMemoryOnly = false;
+
+	// Serial gathering by default
+	bUseParallelGather = false;
+	ParallelGatherMinNodes = 2048;
+	ParallelGatherChunkSize = 512;
+
+	// rosbridge json messages by default
+	Encoding = ETFEncoding::JSON;
+	CompactTranslationPrecision = 0.1f;
+	CompactRotationBits = 14;
+	CompactKeyframeInterval = 1.0f;
+
 	// ROSBridge server default values
 	ServerIP = "127.0.0.1";
 	ServerPORT = 9090;
@@ -35,42 +115,225 @@ void ATFPublisher::BeginPlay()
 	// Build TF tree
 	BuildTFTree();
 
-	// Create the ROSBridge handler for connecting with ROS
-	ROSBridgeHandler = MakeShareable<FROSBridgeHandler>(
-		new FROSBridgeHandler(ServerIP, ServerPORT));
+	// First publish is a keyframe
+	LastKeyframeTime = -KeyframeInterval;
+
+	// No chunks waiting to be published
+	NextChunkIdx = INDEX_NONE;
+
+	// Static frames are published once classified
+	LastStaticPublishTime = 0.f;
+	bStaticPublishPending = false;
+	bStaticSharedMemoryPending = false;
+	StaticSharedMemoryVersion = 0;
+
+	// Compact packets are published next to the standard topics (the relay republishes them as tf messages),
+	// namespaced publishers can use the topics of their namespace
+	const FString TopicPrefix = bUseNamespaceTopics && !Namespace.IsEmpty() ? TEXT("/") + Namespace : FString();
+	TFTopic = TopicPrefix + (Encoding == ETFEncoding::Compact ? TEXT("/tf_compact") : TEXT("/tf"));
+	TFStaticTopic = TopicPrefix + (Encoding == ETFEncoding::Compact ? TEXT("/tf_static_compact") : TEXT("/tf_static"));
 
-	// Create the tf publisher
-	TFPublisher = MakeShareable<FROSBridgePublisher>(
-		new FROSBridgePublisher("tf", "tf2_msgs/TFMessage"));
+	// Create the shared memory ring for the consumers on the same host
+	if (bUseSharedMemory)
+	{
+		SharedMemoryWriter = MakeShareable(new FTFSharedMemoryWriter());
+		if (!SharedMemoryWriter->Open(SharedMemoryName, SharedMemorySlots, SharedMemoryMaxFrames))
+		{
+			SharedMemoryWriter.Reset();
+		}
+	}
 
-	// Connect to ROS
-	ROSBridgeHandler->Connect();
+	if (bSharedMemoryOnly && SharedMemoryWriter.IsValid())
+	{
+		// No connection to ROS, the snapshots are written from the game thread
+		if (bUsePipelinedPublishing || bUseFixedRatePublishing || bUseAdaptiveRate || Channels.Num() > 0)
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d Pipelined, fixed rate, adaptive rate publishing and the channels are not used with shared memory only.."),
+				TEXT(__FUNCTION__), __LINE__);
+		}
+		bUsePipelinedPublishing = false;
+		bUseFixedRatePublishing = false;
+		bUseAdaptiveRate = false;
+	}
+	else if (Encoding == ETFEncoding::BSON || Encoding == ETFEncoding::Compact)
+	{
+		// Create the BSON client and connect to ROS (the rosbridge handler json messages would be rejected)
+		BsonClient = MakeShareable(new FTFBsonClient(ServerIP, ServerPORT));
+		if (Encoding == ETFEncoding::Compact)
+		{
+			FTFCompactSettings CompactSettings;
+			CompactSettings.TranslationStep = CompactTranslationPrecision * 0.001f;
+			CompactSettings.RotationBits = CompactRotationBits;
+			CompactSettings.KeyframeInterval = CompactKeyframeInterval;
+			BsonClient->SetCompactEncoding(CompactSettings);
+		}
+		BsonClient->AddTopic(TFTopic);
+		if (bUseStaticDetection)
+		{
+			BsonClient->AddTopic(TFStaticTopic, true);
+		}
+		for (const auto& ChannelItr : Channels)
+		{
+			BsonClient->AddTopic(ChannelItr.Topic);
+		}
+		BsonClient->Connect();
+	}
+	else
+	{
+		// Create the ROSBridge handler for connecting with ROS
+		ROSBridgeHandler = MakeShareable<FROSBridgeHandler>(
+			new FROSBridgeHandler(ServerIP, ServerPORT));
 
-	// Add publisher
-	ROSBridgeHandler->AddPublisher(TFPublisher);
+		// Create the tf publisher
+		TFPublisher = MakeShareable<FROSBridgePublisher>(
+			new FROSBridgePublisher(TFTopic, "tf2_msgs/TFMessage"));
+
+		// Connect to ROS
+		ROSBridgeHandler->Connect();
+
+		// Add publisher
+		ROSBridgeHandler->AddPublisher(TFPublisher);
+
+		// Create and add the static tf publisher
+		if (bUseStaticDetection)
+		{
+			TFStaticPublisher = MakeShareable<FROSBridgePublisher>(
+				new FROSBridgePublisher(TFStaticTopic, "tf2_msgs/TFMessage"));
+			ROSBridgeHandler->AddPublisher(TFStaticPublisher);
+		}
+
+		// Create and add the channel publishers
+		for (const auto& ChannelItr : Channels)
+		{
+			TSharedPtr<FROSBridgePublisher> ChannelPublisher = MakeShareable<FROSBridgePublisher>(
+				new FROSBridgePublisher(ChannelItr.Topic, "tf2_msgs/TFMessage"));
+			ROSBridgeHandler->AddPublisher(ChannelPublisher);
+			ChannelPublishers.Emplace(ChannelPublisher);
+		}
+	}
+
+	// The fixed rate thread samples complete copies of the dynamic frames, taken after physics
+	if (bUseFixedRatePublishing)
+	{
+		bUseDeltaPublishing = false;
+		bSpreadChunksOverTicks = false;
+		SetTickGroup(TG_PostPhysics);
+	}
+
+	// The fixed rate thread keeps its own rate
+	if (bUseAdaptiveRate && bUseFixedRatePublishing)
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d Adaptive rate is not used with fixed rate publishing.."),
+			TEXT(__FUNCTION__), __LINE__);
+		bUseAdaptiveRate = false;
+	}
+	if (bUseAdaptiveRate)
+	{
+		FTFAdaptiveSettings AdaptiveSettings;
+		AdaptiveSettings.MaxRate = AdaptiveMaxRate;
+		AdaptiveSettings.MinRate = AdaptiveMinRate;
+		AdaptiveSettings.LatencyThreshold = AdaptiveLatencyThreshold * 0.001f;
+		AdaptiveSettings.QueueDepthThreshold = AdaptiveQueueDepthThreshold;
+		AdaptiveSettings.bAllowDeltaMode = bAdaptiveDeltaMode;
+		AdaptiveSettings.EvaluationInterval = 1.f;
+		AdaptiveRate.Init(AdaptiveSettings);
+	}
+
+	// Hand over the message creation and the connection to the worker thread
+	// (the adaptive rate measures the backpressure on the worker)
+	if (bUsePipelinedPublishing || bUseFixedRatePublishing || bUseAdaptiveRate)
+	{
+		PublishWorker = BsonClient.IsValid() ?
+			MakeShareable(new FTFPublishWorker(BsonClient, TFTopic, TFStaticTopic)) :
+			MakeShareable(new FTFPublishWorker(ROSBridgeHandler, TFTopic, TFStaticTopic));
+		for (const auto& ChannelItr : Channels)
+		{
+			PublishWorker->AddChannel(ChannelItr.Topic);
+		}
+		if (bUseFixedRatePublishing)
+		{
+			PublishWorker->SetFixedRate(FixedPublishRate, bInterpolateFixedRate, FixedRateInterpolationDelay);
+		}
+		// Stale snapshots are only dropped under the adaptive rate (backpressure handling)
+		PublishWorker->SetMaxSnapshotAge(bUseAdaptiveRate ? MaxSnapshotAge * 0.001f : 0.f);
+		PublishWorker->Start();
+	}
+
+	// Add the TF tagged actors spawned from now on (destroyed nodes remove themselves)
+	if (bTrackSpawnedActors)
+	{
+		ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(
+			FOnActorSpawned::FDelegate::CreateUObject(this, &ATFPublisher::OnActorSpawned));
+	}
 
 	// Bind publish function to timer
 	if (bUseConstantPublishRate)
 	{
 		if (ConstantPublishRate > 0.f)
 		{
-			// Disable tick
-			SetActorTickEnabled(false);
+			// Disable tick (once the nodes of the asynchronous build are created)
+			SetActorTickEnabled(TFTree.IsBuilding());
 			// Setup timer
 			GetWorldTimerManager().SetTimer(TFPubTimer, this, &ATFPublisher::PublishTF, ConstantPublishRate, true);
 		}
 	}
-	else
+	else if (!bUseFixedRatePublishing)
 	{
-		// Take into account the PublishRate Tag key value pair (if missing, publish on tick)
+		// Publish on tick, the frames are published at their PublishRate Tag key value pair (if missing, on every tick)
+		bUseMultiRatePublishing = true;
 	}
 }
 
 // Called when destroyed or game stopped
 void ATFPublisher::EndPlay(const EEndPlayReason::Type Reason)
 {
+	// Stop tracking the spawned actors
+	if (ActorSpawnedHandle.IsValid())
+	{
+		GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+		ActorSpawnedHandle.Reset();
+	}
+
+	// The shards are destroyed with their owner (on level teardown they end by themselves)
+	if (Reason == EEndPlayReason::Destroyed)
+	{
+		for (ATFPublisher* ShardItr : Shards)
+		{
+			if (ShardItr && !ShardItr->IsPendingKillPending())
+			{
+				ShardItr->Destroy();
+			}
+		}
+	}
+	Shards.Empty();
+	ShardNamespaces.Empty();
+
+	// Stop the worker before disconnecting
+	if (PublishWorker.IsValid())
+	{
+		PublishWorker->Shutdown();
+		PublishWorker.Reset();
+	}
+
+	// Remove the shared memory region
+	if (SharedMemoryWriter.IsValid())
+	{
+		SharedMemoryWriter->Close();
+		SharedMemoryWriter.Reset();
+	}
+
 	// Disconnect before parent ends
-	ROSBridgeHandler->Disconnect();
+	if (BsonClient.IsValid())
+	{
+		BsonClient->Disconnect();
+	}
+	if (ROSBridgeHandler.IsValid())
+	{
+		ROSBridgeHandler->Disconnect();
+	}
+
+	// Remove the nodes (and their anchors)
+	TFTree.Empty();
 
 	Super::EndPlay(Reason);
 }
@@ -80,6 +343,18 @@ void ATFPublisher::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	// Create the nodes of the asynchronous build within the frame budget
+	if (TFTree.IsBuilding())
+	{
+		const bool bBuilt = TFTree.UpdateAsyncBuild(AsyncBuildFrameBudget * 0.001f);
+		if (TFPubTimer.IsValid())
+		{
+			// Published by the timer
+			SetActorTickEnabled(!bBuilt);
+			return;
+		}
+	}
+
 	// Publish tf
 	PublishTF();
 }
@@ -87,52 +362,509 @@ void ATFPublisher::Tick(float DeltaTime)
 // Build TF tree
 void ATFPublisher::BuildTFTree()
 {
-	// Create root node
-	TFRootNode = NewObject<UTFNode>(this);
-	TFRootNode->RegisterComponent();
+	// Initialize tree with the root node, blank (no relative transform calculation with root children),
+	// or using this actor as origin position (relative calculation now need to happen between root and its children)
+	TFTree.SetNodeStorage(NodeStorage);
+	TFTree.Init(TFRootFrameName, bUseBlankRootNode ? nullptr : this);
 
-	if (bUseBlankRootNode)
+	// Keep only the frames of the namespace, the frames without namespace when sharding
+	if (bShardByNamespace || !Namespace.IsEmpty())
 	{
-		// Init node as blank (no relative transform calculation with root children)
-		TFRootNode->Init(TFRootFrameName, &TFTree);
+		TFTree.SetNamespaceFilter(Namespace);
 	}
-	else
+
+	// Set parallel gathering
+	FTFParallelSettings ParallelSettings;
+	ParallelSettings.bEnabled = bUseParallelGather;
+	ParallelSettings.MinNodes = ParallelGatherMinNodes;
+	ParallelSettings.ChunkSize = ParallelGatherChunkSize;
+	TFTree.SetParallelSettings(ParallelSettings);
+
+	// Set message chunking
+	FTFChunkSettings ChunkSettings;
+	ChunkSettings.MaxTransforms = MaxTransformsPerMessage;
+	ChunkSettings.MaxBytes = MaxMessageBytes;
+	TFTree.SetChunkSettings(ChunkSettings);
+
+	// Set static frames detection
+	FTFStaticSettings StaticSettings;
+	StaticSettings.bEnabled = bUseStaticDetection;
+	StaticSettings.InvarianceSamples = StaticInvarianceSamples;
+	StaticSettings.Tolerance = 1.e-3f;
+	StaticSettings.CheckInterval = StaticCheckInterval;
+	TFTree.SetStaticSettings(StaticSettings);
+
+	// Set the transform history
+	TFTree.SetBufferCapacity(bUseTransformBuffer ? TransformBufferSize : 0);
+
+	// Add the channels, their members are resolved with the layout
+	for (const auto& ChannelItr : Channels)
 	{
-		// TF root node uses this actor as origin position
-		// relative calculation now need to happen between root and its children
-		TFRootNode->Init(TFRootFrameName, &TFTree, this);
+		TFTree.AddChannel(ChannelItr.Topic, ChannelItr.SubtreeRootFrameId, ChannelItr.FramePattern, ChannelItr.PublishRate);
 	}
 
-	// Initialize tree with the root node
-	TFTree.Init(TFRootNode);
-
-	// Bind root node transform function pointer (call after adding to tree)
-	TFRootNode->BindTransformFunction();
+	// Build tree (or start building it in the background, the tick creates the nodes),
+	// from the topology cache of the level if its tags did not change
+	const FString CacheFilePath = bUseTopologyCache ? FTFTopologyCache::GetFilePath(GetWorld(), Namespace) : FString();
+	if (bUseAsyncBuild)
+	{
+		TFTree.BeginAsyncBuild(GetWorld(), CacheFilePath);
+	}
+	else if (bUseTopologyCache)
+	{
+		TFTree.BuildCached(GetWorld(), CacheFilePath);
+	}
+	else
+	{
+		TFTree.Build(GetWorld());
+	}
 
-	// Build tree
-	TFTree.Build(GetWorld());
+	// Hand over the other namespaces to their shards
+	if (bShardByNamespace)
+	{
+		SpawnShards(FTags::GetObjectKeyValuePairsMap(GetWorld(), TEXT("TF")));
+	}
 }
 
 // Publish tf tree
 void ATFPublisher::PublishTF()
 {
+	SCOPE_CYCLE_COUNTER(STAT_TFPublish);
+
 	// Current time as ROS time
 	FROSTime TimeNow = FROSTime::Now();
 
+	const float CurrTime = GetWorld()->GetTimeSeconds();
+
+	// Record the transforms of every frame for the lookups
+	if (bUseTransformBuffer)
+	{
+		TFTree.RecordTransforms(CurrTime);
+	}
+
+	// Republish the static frames when they change, and periodically for late joining listeners
+	if (bUseStaticDetection)
+	{
+		if (TFTree.UpdateStaticNodes(CurrTime) ||
+			(StaticRepublishInterval > 0.f && CurrTime - LastStaticPublishTime >= StaticRepublishInterval))
+		{
+			bStaticPublishPending = true;
+			bStaticSharedMemoryPending = true;
+		}
+		// The latched static frames reference the schema, rewrite them with the new layout
+		if (SharedMemoryWriter.IsValid() && TFTree.GetTopologyVersion() != StaticSharedMemoryVersion)
+		{
+			bStaticSharedMemoryPending = true;
+		}
+		if (bStaticPublishPending || bStaticSharedMemoryPending)
+		{
+			PublishStaticTF(TimeNow, CurrTime);
+		}
+	}
+
+	// Publish the due channels
+	if (TFTree.NumChannels() > 0)
+	{
+		PublishChannels(TimeNow, CurrTime);
+	}
+
+	// Throttle on the backpressure of the worker
+	if (bUseAdaptiveRate && PublishWorker.IsValid())
+	{
+		FTFSendStats SendStats;
+		PublishWorker->ConsumeSendStats(SendStats);
+		AdaptiveRate.AddSendStats(SendStats);
+		AdaptiveRate.Update(CurrTime);
+	}
+
+	// The remaining chunks of the last snapshot are published first, one per publish (also while throttled)
+	if (NextChunkIdx != INDEX_NONE)
+	{
+		PublishTFSnapshotChunk(NextChunkIdx);
+		NextChunkIdx = NextChunkIdx + 1 < Snapshot.NumChunks() ? NextChunkIdx + 1 : INDEX_NONE;
+		if (!PublishWorker.IsValid() && ROSBridgeHandler.IsValid())
+		{
+			ProcessROSBridge();
+		}
+		return;
+	}
+
+	// Only the channels and the static frames are published (or the adaptive rate is not due yet)
+	if (!bPublishAllFrames || (bUseAdaptiveRate && !AdaptiveRate.ShouldPublish(CurrTime)))
+	{
+		if (!PublishWorker.IsValid() && ROSBridgeHandler.IsValid())
+		{
+			ProcessROSBridge();
+		}
+		return;
+	}
+
+	// Delta thresholds, periodically publish every frame so late joining listeners converge
+	const bool bUseDelta = bUseDeltaPublishing || (bUseAdaptiveRate && AdaptiveRate.IsDeltaModeForced());
+	FTFDeltaSettings DeltaSettings;
+	if (bUseDelta)
+	{
+		DeltaSettings.TranslationEpsilon = DeltaTranslationEpsilon;
+		DeltaSettings.RotationEpsilon = FMath::DegreesToRadians(DeltaRotationEpsilon);
+		DeltaSettings.bKeyframe = CurrTime - LastKeyframeTime >= KeyframeInterval;
+		if (DeltaSettings.bKeyframe)
+		{
+			LastKeyframeTime = CurrTime;
+		}
+	}
+
+	// Pipelined, BSON encoded, chunked or shared memory, only copy the raw transforms
+	if (PublishWorker.IsValid() || BsonClient.IsValid() || SharedMemoryWriter.IsValid() ||
+		MaxTransformsPerMessage > 0 || MaxMessageBytes > 0)
+	{
+		PublishTFSnapshot(TimeNow, CurrTime, bUseDelta ? &DeltaSettings : nullptr);
+		return;
+	}
+
 	// Create TFMessage
-	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr = TFTree.GetTFMessageMsg(TimeNow, Seq);
+	const double CaptureTime = FPlatformTime::Seconds();
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr;
+	if (bUseMultiRatePublishing)
+	{
+		TFMsgPtr = TFTree.GetMultiRateTFMessageMsg(TimeNow, Seq, CurrTime,
+			bUseDelta ? &DeltaSettings : nullptr);
+	}
+	else if (bUseDelta)
+	{
+		TFMsgPtr = TFTree.GetDeltaTFMessageMsg(TimeNow, Seq, DeltaSettings);
+	}
+	else
+	{
+		TFMsgPtr = TFTree.GetTFMessageMsg(TimeNow, Seq);
+	}
 
-	// PUB
-	ROSBridgeHandler->PublishMsg("/tf", TFMsgPtr);
+	// PUB (nothing to publish if no frame changed or no rate bucket was due)
+	if (TFMsgPtr.IsValid())
+	{
+		PublishJsonMsg(TFTopic, TFMsgPtr, CaptureTime);
+	}
 
-	ROSBridgeHandler->Process();
+	ProcessROSBridge();
 
 	// Update message sequence
 	Seq++;
 }
 
+// Publish tf tree as a snapshot
+void ATFPublisher::PublishTFSnapshot(const FROSTime& InTime, const float InWorldTime, const FTFDeltaSettings* InDeltaSettings)
+{
+	const bool bSendToROS = ROSBridgeHandler.IsValid() || (BsonClient.IsValid() && BsonClient->IsReady());
+
+	// Without a connection to ROS only full snapshots are taken (no delta or multi-rate selection)
+	if (!ROSBridgeHandler.IsValid() && !BsonClient.IsValid())
+	{
+		InDeltaSettings = nullptr;
+	}
+	const bool bMultiRate = bUseMultiRatePublishing && (ROSBridgeHandler.IsValid() || BsonClient.IsValid());
+
+	if (PublishWorker.IsValid() && !bSpreadChunksOverTicks)
+	{
+		// The worker creates and publishes the messages (one per chunk)
+		if (TFTree.GetSnapshot(PublishWorker->GetWriteSnapshot(), InTime, Seq, InWorldTime,
+			InDeltaSettings, bMultiRate))
+		{
+			if (SharedMemoryWriter.IsValid())
+			{
+				WriteSharedMemory(PublishWorker->GetWriteSnapshot(), InTime);
+			}
+			PublishWorker->SubmitWriteSnapshot();
+			Seq++;
+		}
+	}
+	else if (bSendToROS || SharedMemoryWriter.IsValid())
+	{
+		if (TFTree.GetSnapshot(Snapshot, InTime, Seq, InWorldTime, InDeltaSettings, bMultiRate))
+		{
+			// The shared memory is written whole, regardless of the chunks and the connection
+			if (SharedMemoryWriter.IsValid())
+			{
+				WriteSharedMemory(Snapshot, InTime);
+			}
+
+			if (bSendToROS && bSpreadChunksOverTicks)
+			{
+				// Publish the first chunk now, the others on the next publishes
+				PublishTFSnapshotChunk(0);
+				NextChunkIdx = Snapshot.NumChunks() > 1 ? 1 : INDEX_NONE;
+			}
+			else if (bSendToROS)
+			{
+				for (int32 ChunkIdx = 0; ChunkIdx < Snapshot.NumChunks(); ++ChunkIdx)
+				{
+					PublishTFSnapshotChunk(ChunkIdx);
+				}
+			}
+			else if (BsonClient.IsValid())
+			{
+				// Not connected, only written to the shared memory
+				INC_DWORD_STAT(STAT_TFDroppedMessages);
+			}
+			Seq++;
+		}
+	}
+	else
+	{
+		// Not connected, the publish is skipped
+		INC_DWORD_STAT(STAT_TFDroppedMessages);
+	}
+
+	// Json messages without a worker are sent from the game thread
+	if (!PublishWorker.IsValid() && ROSBridgeHandler.IsValid())
+	{
+		ProcessROSBridge();
+	}
+}
+
+// Write the frames to the shared memory, a partial snapshot is replaced by a full copy
+void ATFPublisher::WriteSharedMemory(const FTFSnapshot& InSnapshot, const FROSTime& InTime)
+{
+	// The readers skip to the newest slot, every slot carries every published frame
+	if (InSnapshot.bPartial)
+	{
+		if (TFTree.GetDynamicSnapshot(SharedMemorySnapshot, InTime, InSnapshot.Seq))
+		{
+			SharedMemoryWriter->Write(SharedMemorySnapshot);
+		}
+	}
+	else
+	{
+		SharedMemoryWriter->Write(InSnapshot);
+	}
+}
+
+// Publish a chunk of the snapshot as a separate message
+void ATFPublisher::PublishTFSnapshotChunk(const int32 InChunkIdx)
+{
+	int32 Start, End;
+	Snapshot.GetChunk(InChunkIdx, Start, End);
+
+	if (PublishWorker.IsValid())
+	{
+		// Queued in order on the worker (a chunk is never replaced by the next one)
+		PublishWorker->SubmitChunk(Snapshot, Start, End);
+	}
+	else if (BsonClient.IsValid())
+	{
+		BsonClient->PublishChunk(TFTopic, Snapshot, InChunkIdx);
+	}
+	else
+	{
+		PublishJsonMsg(TFTopic, Snapshot.GetTFMessageMsg(Start, End), Snapshot.CaptureTime);
+	}
+}
+
+// Publish the static frames on /tf_static
+void ATFPublisher::PublishStaticTF(const FROSTime& InTime, const float InWorldTime)
+{
+	const bool bConnecting = BsonClient.IsValid() && !BsonClient->IsReady();
+	if (bConnecting && !bStaticSharedMemoryPending)
+	{
+		return; // Keep pending until connected
+	}
+
+	const bool bHasStaticFrames = TFTree.GetStaticSnapshot(StaticSnapshot, InTime, Seq);
+
+	// The shared memory does not wait for the rosbridge connection (latched, also rewritten when empty)
+	if (bStaticSharedMemoryPending && SharedMemoryWriter.IsValid())
+	{
+		SharedMemoryWriter->WriteStatic(StaticSnapshot);
+		StaticSharedMemoryVersion = TFTree.GetTopologyVersion();
+	}
+	bStaticSharedMemoryPending = false;
+	if (!bStaticPublishPending || bConnecting)
+	{
+		return; // Only the shared memory was due, or keep pending until connected
+	}
+
+	if (bHasStaticFrames)
+	{
+		if (PublishWorker.IsValid())
+		{
+			PublishWorker->SubmitStaticSnapshot(StaticSnapshot);
+		}
+		else if (BsonClient.IsValid())
+		{
+			BsonClient->Publish(TFStaticTopic, StaticSnapshot);
+		}
+		else if (ROSBridgeHandler.IsValid())
+		{
+			PublishJsonMsg(TFStaticTopic, StaticSnapshot.GetTFMessageMsg(), StaticSnapshot.CaptureTime);
+		}
+	}
+	LastStaticPublishTime = InWorldTime;
+	bStaticPublishPending = false;
+}
+
+// Get the achieved rate and the jitter of the last second of the fixed rate publishing
+bool ATFPublisher::GetFixedRateStats(float& OutRate, float& OutJitterMs) const
+{
+	if (!bUseFixedRatePublishing || !PublishWorker.IsValid())
+	{
+		return false;
+	}
+	PublishWorker->GetFixedRateStats(OutRate, OutJitterMs);
+	return true;
+}
+
+// Publish the snapshots of the due channels on their topics
+void ATFPublisher::PublishChannels(const FROSTime& InTime, const float InWorldTime)
+{
+	if ((BsonClient.IsValid() && !BsonClient->IsReady()) || (!BsonClient.IsValid() && !ROSBridgeHandler.IsValid()))
+	{
+		return; // Not connected (or shared memory only)
+	}
+
+	for (int32 ChannelIdx = 0; ChannelIdx < TFTree.NumChannels(); ++ChannelIdx)
+	{
+		if (!TFTree.GetChannelSnapshot(ChannelIdx, ChannelSnapshot, InTime, Seq, InWorldTime))
+		{
+			continue;
+		}
+
+		const FString& ChannelTopic = TFTree.GetChannel(ChannelIdx).Topic;
+		if (PublishWorker.IsValid())
+		{
+			PublishWorker->SubmitChannelSnapshot(ChannelIdx, ChannelSnapshot);
+		}
+		else if (BsonClient.IsValid())
+		{
+			BsonClient->Publish(ChannelTopic, ChannelSnapshot);
+		}
+		else
+		{
+			for (int32 ChunkIdx = 0; ChunkIdx < ChannelSnapshot.NumChunks(); ++ChunkIdx)
+			{
+				int32 Start, End;
+				ChannelSnapshot.GetChunk(ChunkIdx, Start, End);
+				PublishJsonMsg(ChannelTopic, ChannelSnapshot.GetTFMessageMsg(Start, End), ChannelSnapshot.CaptureTime);
+			}
+		}
+	}
+}
+
+// Publish the json message with the rosbridge handler
+void ATFPublisher::PublishJsonMsg(const FString& InTopic, TSharedPtr<FROSBridgeMsg> InMsg, const double InCaptureTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFPublishMsg);
+	ROSBridgeHandler->PublishMsg(InTopic, InMsg);
+	INC_DWORD_STAT(STAT_TFPublishedMessages);
+	TF_STAT_PUBLISH_LATENCY(FPlatformTime::Seconds() - InCaptureTime);
+}
+
+// Let the rosbridge handler process its queues (game thread)
+void ATFPublisher::ProcessROSBridge()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFProcess);
+	ROSBridgeHandler->Process();
+}
+
+// Get the transform of the source frame relative to the target frame at the given world time
+bool ATFPublisher::LookupTransform(const FString& InTargetFrameId, const FString& InSourceFrameId, const float InWorldTime,
+	FTransform& OutTransform)
+{
+	return TFTree.LookupTransform(InTargetFrameId, InSourceFrameId, InWorldTime, OutTransform);
+}
+
+// Add the object to the tree using its TF tag key value pairs (missing frame ids default to its name and the root)
 void ATFPublisher::AddObject(UObject* InObject)
 {
-  UE_LOG(LogTF, Warning, TEXT("Object created %s"), *InObject->GetName());
-  TFTree.AddRootChildNode(InObject->GetName(), InObject);
+	TMap<FString, FString> TagData;
+	if (AActor* Actor = Cast<AActor>(InObject))
+	{
+		TagData = FTags::GetKeyValuePairs(Actor, TEXT("TF"));
+	}
+	else if (UActorComponent* Component = Cast<UActorComponent>(InObject))
+	{
+		TagData = FTags::GetKeyValuePairs(Component, TEXT("TF"));
+	}
+	TFTree.AddObject(InObject, TagData);
+}
+
+// Add the TF tagged spawned actor and its TF tagged components to the tree
+void ATFPublisher::OnActorSpawned(AActor* InActor)
+{
+	// New namespaces get their shard (which builds its tree with the spawned actor)
+	if (bShardByNamespace && !InActor->IsA(ATFPublisher::StaticClass()))
+	{
+		TMap<UObject*, TMap<FString, FString>> ObjToTagData;
+		if (FTags::GetTagTypeIndex(InActor, TEXT("TF")) != INDEX_NONE)
+		{
+			ObjToTagData.Emplace(InActor, FTags::GetKeyValuePairs(InActor, TEXT("TF")));
+		}
+		TInlineComponentArray<USceneComponent*> TaggedComponents(InActor);
+		for (USceneComponent* ComponentItr : TaggedComponents)
+		{
+			if (FTags::GetTagTypeIndex(ComponentItr, TEXT("TF")) != INDEX_NONE)
+			{
+				ObjToTagData.Emplace(ComponentItr, FTags::GetKeyValuePairs(ComponentItr, TEXT("TF")));
+			}
+		}
+		SpawnShards(ObjToTagData);
+	}
+
+	if (FTags::GetTagTypeIndex(InActor, TEXT("TF")) != INDEX_NONE)
+	{
+		TFTree.AddObject(InActor, FTags::GetKeyValuePairs(InActor, TEXT("TF")));
+	}
+
+	TInlineComponentArray<USceneComponent*> Components(InActor);
+	for (USceneComponent* ComponentItr : Components)
+	{
+		if (FTags::GetTagTypeIndex(ComponentItr, TEXT("TF")) != INDEX_NONE)
+		{
+			TFTree.AddObject(ComponentItr, FTags::GetKeyValuePairs(ComponentItr, TEXT("TF")));
+		}
+	}
+}
+
+// Spawn the shard publishers of the namespaces of the tagged objects which have none yet
+void ATFPublisher::SpawnShards(const TMap<UObject*, TMap<FString, FString>>& InObjectsToTagData)
+{
+	for (const auto& MapItr : InObjectsToTagData)
+	{
+		const FString ObjectNamespace = FTFTree::GetNamespace(MapItr.Value);
+		if (!ObjectNamespace.IsEmpty() && !ShardNamespaces.Contains(ObjectNamespace))
+		{
+			SpawnShard(ObjectNamespace);
+		}
+	}
+}
+
+// Spawn a shard publisher for the namespace (copy of the settings of this publisher)
+void ATFPublisher::SpawnShard(const FString& InNamespace)
+{
+	ShardNamespaces.Add(InNamespace);
+
+	// The shard starts playing once its namespace is set
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Template = this;
+	SpawnParams.Owner = this;
+	SpawnParams.bDeferConstruction = true;
+	SpawnParams.Name = MakeUniqueObjectName(GetLevel(), GetClass(),
+		*FString::Printf(TEXT("%s_%s"), *GetName(), *InNamespace.Replace(TEXT("/"), TEXT("_"))));
+	ATFPublisher* Shard = GetWorld()->SpawnActor<ATFPublisher>(GetClass(), GetActorTransform(), SpawnParams);
+	if (Shard == nullptr)
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d Could not spawn the shard publisher of the namespace %s.."),
+			TEXT(__FUNCTION__), __LINE__, *InNamespace);
+		return;
+	}
+
+	// Own tree, connection and sequence, the messages are created and sent from the shard worker thread
+	Shard->Namespace = InNamespace;
+	Shard->SharedMemoryName = SharedMemoryName + TEXT("_") + InNamespace.Replace(TEXT("/"), TEXT("_"));
+	Shard->bShardByNamespace = false;
+	Shard->bUsePipelinedPublishing = true;
+	Shard->Channels.Empty();
+	Shard->Shards.Empty();
+	Shard->FinishSpawning(GetActorTransform());
+	Shards.Emplace(Shard);
+
+	UE_LOG(LogTF, Log, TEXT("%s::%d Publishing the namespace %s from the shard %s.."),
+		TEXT(__FUNCTION__), __LINE__, *InNamespace, *Shard->GetName());
 }
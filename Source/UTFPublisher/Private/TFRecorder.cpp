@@ -0,0 +1,89 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFRecorder.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "Misc/Paths.h"
+
+// Sets default values
+ATFRecorder::ATFRecorder()
+{
+	// Set this actor to call Tick() every frame
+	PrimaryActorTick.bCanEverTick = true;
+
+	// Default root frame name
+	TFRootFrameName = TEXT("map");
+
+	// Record on every tick by default
+	RecordRate = 0.f;
+
+	// One second of samples at 60 Hz per chunk
+	SamplesPerChunk = 60;
+
+	Seq = 0;
+}
+
+// Called when the game starts or when spawned
+void ATFRecorder::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Build the tree with a blank root, the frames are recorded relative to their parents (or the world)
+	TFTree.Init(TFRootFrameName);
+	TFTree.Build(GetWorld());
+
+	// Start the writer
+	const FString LogFileName = FileName.IsEmpty() ? FString::Printf(TEXT("TF_%s"), *FDateTime::Now().ToString()) : FileName;
+	const FString FilePath = FPaths::ProjectSavedDir() / TEXT("TFLogs") / LogFileName + TEXT(".tflog");
+	LogWriter = MakeShareable(new FTFLogWriter(FilePath, SamplesPerChunk));
+	if (!LogWriter->Start())
+	{
+		LogWriter.Reset();
+		SetActorTickEnabled(false);
+		return;
+	}
+	UE_LOG(LogTF, Log, TEXT("%s::%d Recording the tf transforms to %s.."), TEXT(__FUNCTION__), __LINE__, *FilePath);
+
+	// Bind record function to timer
+	if (RecordRate > 0.f)
+	{
+		SetActorTickEnabled(false);
+		GetWorldTimerManager().SetTimer(RecordTimer, this, &ATFRecorder::Record, RecordRate, true);
+	}
+}
+
+// Called when destroyed or game stopped
+void ATFRecorder::EndPlay(const EEndPlayReason::Type Reason)
+{
+	// Write the remaining samples and the index
+	if (LogWriter.IsValid())
+	{
+		LogWriter->Shutdown();
+		LogWriter.Reset();
+	}
+
+	// Remove the nodes (and their anchors)
+	TFTree.Empty();
+
+	Super::EndPlay(Reason);
+}
+
+// Called every frame
+void ATFRecorder::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Record tf
+	Record();
+}
+
+// Copy the transforms of every frame and queue them for writing
+void ATFRecorder::Record()
+{
+	if (TFTree.GetSnapshot(Snapshot, FROSTime::Now(), Seq, 0.f, nullptr, false))
+	{
+		LogWriter->Submit(GetWorld()->GetTimeSeconds(), Snapshot);
+		Seq++;
+	}
+}
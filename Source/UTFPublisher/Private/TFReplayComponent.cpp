@@ -0,0 +1,175 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFReplayComponent.h"
+#include "GameFramework/Actor.h"
+#include "Components/SceneComponent.h"
+#include "Misc/Paths.h"
+#include "Tags.h"
+
+// Sets default values for this component's properties
+UTFReplayComponent::UTFReplayComponent()
+{
+	// Replay every tick
+	PrimaryComponentTick.bCanEverTick = true;
+
+	bDriveActors = true;
+	bRepublishTF = false;
+	ServerIP = "127.0.0.1";
+	ServerPORT = 9090;
+	PlaybackRate = 1.f;
+	StartOffset = 0.f;
+	bLoop = false;
+
+	ReplayTime = 0.0;
+	AppliedSampleTime = -1.0;
+	ObjectsSchemaIdx = INDEX_NONE;
+}
+
+// Called when the game starts
+void UTFReplayComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const FString FilePath = FPaths::IsRelative(FileName) ? FPaths::ProjectSavedDir() / TEXT("TFLogs") / FileName : FileName;
+	if (!LogReader.Open(FilePath))
+	{
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Index the TF tagged objects by their frame ids (the object name if not tagged)
+	if (bDriveActors)
+	{
+		for (const auto& ObjToTagDataItr : FTags::GetObjectKeyValuePairsMap(GetWorld(), TEXT("TF")))
+		{
+			const FString* ChildFrameId = ObjToTagDataItr.Value.Find(TEXT("ChildFrameId"));
+			FrameIdToObject.Emplace(ChildFrameId ? *ChildFrameId : ObjToTagDataItr.Key->GetName(), ObjToTagDataItr.Key);
+		}
+	}
+
+	if (bRepublishTF)
+	{
+		ROSBridgeHandler = MakeShareable<FROSBridgeHandler>(new FROSBridgeHandler(ServerIP, ServerPORT));
+		TFPublisher = MakeShareable<FROSBridgePublisher>(new FROSBridgePublisher("tf", "tf2_msgs/TFMessage"));
+		ROSBridgeHandler->Connect();
+		ROSBridgeHandler->AddPublisher(TFPublisher);
+	}
+
+	UE_LOG(LogTF, Log, TEXT("%s::%d Replaying %s (%.2f s to %.2f s).."),
+		TEXT(__FUNCTION__), __LINE__, *FilePath, GetStartTime(), GetEndTime());
+	Seek(GetStartTime() + StartOffset);
+}
+
+// Called when destroyed or game stopped
+void UTFReplayComponent::EndPlay(const EEndPlayReason::Type Reason)
+{
+	if (ROSBridgeHandler.IsValid())
+	{
+		ROSBridgeHandler->Disconnect();
+	}
+	LogReader.Close();
+
+	Super::EndPlay(Reason);
+}
+
+// Called every frame
+void UTFReplayComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	double NextTime = ReplayTime + DeltaTime * PlaybackRate;
+	if (NextTime > GetEndTime() && bLoop)
+	{
+		NextTime = GetStartTime() + StartOffset;
+	}
+	Seek(FMath::Min(NextTime, GetEndTime()));
+
+	if (ROSBridgeHandler.IsValid())
+	{
+		ROSBridgeHandler->Process();
+	}
+}
+
+// Jump to the log time and apply the sample recorded at or before it
+void UTFReplayComponent::Seek(const double InTime)
+{
+	ReplayTime = InTime;
+
+	// Read into the scratch snapshot, the applied sample is kept if the read fails (corrupt or truncated log)
+	double SampleTime;
+	int32 SchemaIdx;
+	if (!LogReader.ReadSample(InTime, ReadSnapshot, SampleTime, SchemaIdx) || SampleTime == AppliedSampleTime)
+	{
+		return; // No valid sample, or already applied
+	}
+	Exchange(Snapshot, ReadSnapshot);
+	AppliedSampleTime = SampleTime;
+
+	if (bDriveActors)
+	{
+		DriveActors(SchemaIdx);
+	}
+
+	if (ROSBridgeHandler.IsValid())
+	{
+		Snapshot.Time = FROSTime::Now();
+		ROSBridgeHandler->PublishMsg("/tf", Snapshot.GetTFMessageMsg());
+	}
+}
+
+// Move the objects of the frames of the current sample to their world transforms
+void UTFReplayComponent::DriveActors(const int32 InSchemaIdx)
+{
+	UpdateSchemaObjects(InSchemaIdx);
+
+	// The frames are stored parents first, compose the tf transforms with the world transforms of their parents
+	const TArray<int32>& ParentIndices = LogReader.GetParentIndices(InSchemaIdx);
+	WorldTransformFlags.Init(false, ParentIndices.Num());
+	for (int32 Pos = 0; Pos < Snapshot.Num(); ++Pos)
+	{
+		const int32 Idx = Snapshot.Indices[Pos];
+		const int32 ParentIdx = ParentIndices[Idx];
+		if (ParentIdx != INDEX_NONE && !WorldTransformFlags[ParentIdx])
+		{
+			continue; // The parent is not in the sample
+		}
+		WorldTransforms[Idx] = ParentIdx == INDEX_NONE ? Snapshot.Transforms[Pos] :
+			Snapshot.Transforms[Pos] * WorldTransforms[ParentIdx];
+		WorldTransformFlags[Idx] = true;
+
+		// Skip the frames without object, or whose object was destroyed or streamed out
+		UObject* Object = SchemaObjects[Idx].Get();
+		if (Object == nullptr)
+		{
+			continue;
+		}
+		if (AActor* Actor = Cast<AActor>(Object))
+		{
+			Actor->SetActorTransform(WorldTransforms[Idx], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+		else if (USceneComponent* SceneComponent = Cast<USceneComponent>(Object))
+		{
+			SceneComponent->SetWorldTransform(WorldTransforms[Idx], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+}
+
+// Find the TF tagged objects of the frames of the schema
+void UTFReplayComponent::UpdateSchemaObjects(const int32 InSchemaIdx)
+{
+	if (ObjectsSchemaIdx == InSchemaIdx)
+	{
+		return;
+	}
+	ObjectsSchemaIdx = InSchemaIdx;
+
+	const TArray<FString>& FrameIds = Snapshot.Schema->FrameIds;
+	SchemaObjects.Reset(FrameIds.Num());
+	for (const auto& FrameIdItr : FrameIds)
+	{
+		const TWeakObjectPtr<UObject>* Object = FrameIdToObject.Find(FrameIdItr);
+		SchemaObjects.Emplace(Object ? *Object : TWeakObjectPtr<UObject>());
+	}
+	WorldTransforms.SetNum(FrameIds.Num());
+}
@@ -0,0 +1,584 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFSharedMemory.h"
+#include "TFStats.h"
+#include "Conversions.h"
+#include "HAL/IConsoleManager.h"
+
+// Average bytes of the interned frame ids of a frame reserved in the schema area
+static const uint32 TFShmInternedBytesPerFrame = 64;
+
+// Number of attempts to copy a slot which is being overwritten
+static const int32 TFShmReadAttempts = 4;
+
+// Read and write access of the region
+static uint32 GetShmAccess(const bool bInWrite)
+{
+	uint32 Access = static_cast<uint32>(FPlatformMemory::ESharedMemoryAccess::Read);
+	if (bInWrite)
+	{
+		Access |= static_cast<uint32>(FPlatformMemory::ESharedMemoryAccess::Write);
+	}
+	return Access;
+}
+
+// Frame id from its UTF-8 characters
+static FString FromUtf8(const ANSICHAR* InUtf8, const int32 InLength)
+{
+	FUTF8ToTCHAR Converted(InUtf8, InLength);
+	return FString(Converted.Length(), Converted.Get());
+}
+
+// Default constructor
+FTFSharedMemoryWriter::FTFSharedMemoryWriter()
+{
+	Region = nullptr;
+	Header = nullptr;
+	SchemaArea = nullptr;
+	StaticArea = nullptr;
+	Slots = nullptr;
+	SlotSize = 0;
+	NumSchemaFrames = 0;
+	bSlotTruncationWarned = false;
+	bSchemaTruncationWarned = false;
+}
+
+// Destructor
+FTFSharedMemoryWriter::~FTFSharedMemoryWriter()
+{
+	Close();
+}
+
+// Size of a slot with the given capacity
+SIZE_T FTFSharedMemoryWriter::GetSlotSize(const int32 InSlotCapacity)
+{
+	return sizeof(FTFShmSlot) + InSlotCapacity * sizeof(FTFShmTransform);
+}
+
+// Size of the schema area for the given slot capacity
+uint32 FTFSharedMemoryWriter::GetSchemaCapacity(const int32 InSlotCapacity)
+{
+	return static_cast<uint32>(Align(2 * sizeof(int32) + InSlotCapacity * (sizeof(FTFShmFrame) + TFShmInternedBytesPerFrame), 8));
+}
+
+// Size of a region with the given number of slots and capacity (the static area has the size of a slot)
+SIZE_T FTFSharedMemoryWriter::GetRegionSize(const int32 InNumSlots, const int32 InSlotCapacity)
+{
+	return sizeof(FTFShmHeader) + GetSchemaCapacity(InSlotCapacity) + (InNumSlots + 1) * GetSlotSize(InSlotCapacity);
+}
+
+// Create the named region
+bool FTFSharedMemoryWriter::Open(const FString& InName, const int32 InNumSlots, const int32 InSlotCapacity)
+{
+	Close();
+	if (InNumSlots < 1 || InSlotCapacity < 1)
+	{
+		return false;
+	}
+
+	const SIZE_T RegionSize = GetRegionSize(InNumSlots, InSlotCapacity);
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, true, GetShmAccess(true), RegionSize);
+	if (Region == nullptr)
+	{
+		UE_LOG(LogTF, Error, TEXT("%s::%d Could not create the shared memory region %s (%llu bytes).."),
+			TEXT(__FUNCTION__), __LINE__, *InName, static_cast<uint64>(RegionSize));
+		return false;
+	}
+
+	uint8* Base = static_cast<uint8*>(Region->GetAddress());
+	Header = reinterpret_cast<FTFShmHeader*>(Base);
+	SchemaArea = Base + sizeof(FTFShmHeader);
+	StaticArea = SchemaArea + GetSchemaCapacity(InSlotCapacity);
+	SlotSize = GetSlotSize(InSlotCapacity);
+	Slots = StaticArea + SlotSize;
+	FMemory::Memzero(Base, RegionSize);
+
+	Header->Version = Version;
+	Header->NumSlots = InNumSlots;
+	Header->SlotCapacity = InSlotCapacity;
+	Header->SchemaCapacity = GetSchemaCapacity(InSlotCapacity);
+	Header->SchemaLock = 0;
+	Header->SchemaId = 0;
+	Header->WriteCount = 0;
+	// The magic marks the header as complete
+	FPlatformMisc::MemoryBarrier();
+	Header->Magic = FileMagic;
+
+	WrittenSchema.Reset();
+	NumSchemaFrames = 0;
+	bSlotTruncationWarned = false;
+	bSchemaTruncationWarned = false;
+	UE_LOG(LogTF, Log, TEXT("%s::%d Writing the tf snapshots to the shared memory region %s (%d slots of %d transforms).."),
+		TEXT(__FUNCTION__), __LINE__, *InName, InNumSlots, InSlotCapacity);
+	return true;
+}
+
+// Unmap (and remove) the region
+void FTFSharedMemoryWriter::Close()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		Header = nullptr;
+		SchemaArea = nullptr;
+		StaticArea = nullptr;
+		Slots = nullptr;
+	}
+	WrittenSchema.Reset();
+}
+
+// Write the snapshot into the next slot
+void FTFSharedMemoryWriter::Write(const FTFSnapshot& InSnapshot)
+{
+	if (!UpdateSchema(InSnapshot))
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFSharedMemoryWrite);
+
+	const int64 WriteCount = Header->WriteCount;
+	const int32 NumTransforms = WriteSlot(Slots + (WriteCount % Header->NumSlots) * SlotSize, InSnapshot, 0);
+
+	// Publish the slot
+	FPlatformMisc::MemoryBarrier();
+	Header->WriteCount = WriteCount + 1;
+	INC_DWORD_STAT_BY(STAT_TFSharedMemoryBytes, sizeof(FTFShmSlot) + NumTransforms * sizeof(FTFShmTransform));
+}
+
+// Rewrite the static area with the static frames
+void FTFSharedMemoryWriter::WriteStatic(const FTFSnapshot& InSnapshot)
+{
+	if (!UpdateSchema(InSnapshot))
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFSharedMemoryWrite);
+
+	const int32 NumTransforms = WriteSlot(StaticArea, InSnapshot, StaticFlag);
+	INC_DWORD_STAT_BY(STAT_TFSharedMemoryBytes, sizeof(FTFShmSlot) + NumTransforms * sizeof(FTFShmTransform));
+}
+
+// Rewrite the schema area if the layout of the snapshot changed
+bool FTFSharedMemoryWriter::UpdateSchema(const FTFSnapshot& InSnapshot)
+{
+	if (Region == nullptr || !InSnapshot.Schema.IsValid())
+	{
+		return false;
+	}
+
+	// New layout, the slots written from now on reference the new schema
+	if (InSnapshot.Schema != WrittenSchema)
+	{
+		WriteSchema(*InSnapshot.Schema);
+		WrittenSchema = InSnapshot.Schema;
+	}
+
+	if (!bSlotTruncationWarned && InSnapshot.Num() > static_cast<int32>(Header->SlotCapacity))
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d Snapshot of %d transforms does not fit a slot of %u, the rest is dropped.."),
+			TEXT(__FUNCTION__), __LINE__, InSnapshot.Num(), Header->SlotCapacity);
+		bSlotTruncationWarned = true;
+	}
+	return true;
+}
+
+// Write the snapshot into the slot under its sequence lock
+int32 FTFSharedMemoryWriter::WriteSlot(uint8* InSlotData, const FTFSnapshot& InSnapshot, const uint32 InFlags)
+{
+	const int32 SlotCapacity = static_cast<int32>(Header->SlotCapacity);
+	FTFShmSlot* Slot = reinterpret_cast<FTFShmSlot*>(InSlotData);
+	FTFShmTransform* Transforms = reinterpret_cast<FTFShmTransform*>(InSlotData + sizeof(FTFShmSlot));
+
+	// Odd while written
+	const uint32 Lock = Slot->Lock;
+	Slot->Lock = Lock + 1;
+	FPlatformMisc::MemoryBarrier();
+
+	Slot->SchemaId = Header->SchemaId;
+	Slot->Seq = InSnapshot.Seq;
+	Slot->Secs = InSnapshot.Time.Secs;
+	Slot->NSecs = InSnapshot.Time.NSecs;
+	Slot->Flags = InFlags;
+	int32 NumTransforms = 0;
+	for (int32 Pos = 0; Pos < InSnapshot.Num() && NumTransforms < SlotCapacity; ++Pos)
+	{
+		// Frames beyond the written schema are dropped
+		if (InSnapshot.Indices[Pos] >= NumSchemaFrames)
+		{
+			continue;
+		}
+
+		// Converted straight into the slot
+		const FTransform ROSTransf = FConversions::UToROS(InSnapshot.Transforms[Pos]);
+		const FVector Translation = ROSTransf.GetLocation();
+		const FQuat Rotation = ROSTransf.GetRotation();
+		FTFShmTransform& ShmTransform = Transforms[NumTransforms++];
+		ShmTransform.FrameIdx = InSnapshot.Indices[Pos];
+		ShmTransform.Translation[0] = Translation.X;
+		ShmTransform.Translation[1] = Translation.Y;
+		ShmTransform.Translation[2] = Translation.Z;
+		ShmTransform.Rotation[0] = Rotation.X;
+		ShmTransform.Rotation[1] = Rotation.Y;
+		ShmTransform.Rotation[2] = Rotation.Z;
+		ShmTransform.Rotation[3] = Rotation.W;
+	}
+	Slot->NumTransforms = NumTransforms;
+	Slot->WriteTime = FPlatformTime::Seconds();
+
+	// Even again
+	FPlatformMisc::MemoryBarrier();
+	Slot->Lock = Lock + 2;
+	return NumTransforms;
+}
+
+// Write the frame ids of the schema into the schema area
+void FTFSharedMemoryWriter::WriteSchema(const FTFFrameSchema& InSchema)
+{
+	// Keep the first frames fitting the schema area (with the interned ids they reference)
+	int32 NumFrames = 0;
+	int32 InternedSize = 0;
+	for (; NumFrames < InSchema.FrameIds.Num(); ++NumFrames)
+	{
+		const FTFInternedId& FrameId = InSchema.Utf8FrameIds[NumFrames];
+		const FTFInternedId& ParentFrameId = InSchema.Utf8ParentFrameIds[NumFrames];
+		const int32 FrameInternedSize = FMath::Max3(InternedSize,
+			FrameId.Offset + FrameId.Length + 1, ParentFrameId.Offset + ParentFrameId.Length + 1);
+		if (2 * sizeof(int32) + (NumFrames + 1) * sizeof(FTFShmFrame) + FrameInternedSize > Header->SchemaCapacity)
+		{
+			break;
+		}
+		InternedSize = FrameInternedSize;
+	}
+	if (NumFrames < InSchema.FrameIds.Num() && !bSchemaTruncationWarned)
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d The frame ids of %d frames do not fit the schema area (%u bytes), only %d are written.."),
+			TEXT(__FUNCTION__), __LINE__, InSchema.FrameIds.Num(), Header->SchemaCapacity, NumFrames);
+		bSchemaTruncationWarned = true;
+	}
+
+	// Odd while written
+	const uint32 Lock = Header->SchemaLock;
+	Header->SchemaLock = Lock + 1;
+	FPlatformMisc::MemoryBarrier();
+
+	int32* Counts = reinterpret_cast<int32*>(SchemaArea);
+	Counts[0] = NumFrames;
+	Counts[1] = InternedSize;
+	FTFShmFrame* Frames = reinterpret_cast<FTFShmFrame*>(SchemaArea + 2 * sizeof(int32));
+	for (int32 Idx = 0; Idx < NumFrames; ++Idx)
+	{
+		Frames[Idx].FrameIdOffset = InSchema.Utf8FrameIds[Idx].Offset;
+		Frames[Idx].FrameIdLength = InSchema.Utf8FrameIds[Idx].Length;
+		Frames[Idx].ParentFrameIdOffset = InSchema.Utf8ParentFrameIds[Idx].Offset;
+		Frames[Idx].ParentFrameIdLength = InSchema.Utf8ParentFrameIds[Idx].Length;
+	}
+	// The interned ids are already UTF-8, copied as they are
+	FMemory::Memcpy(Frames + NumFrames, InSchema.InternedIds.GetData(), InternedSize);
+	Header->SchemaId = Header->SchemaId + 1;
+	NumSchemaFrames = NumFrames;
+
+	FPlatformMisc::MemoryBarrier();
+	Header->SchemaLock = Lock + 2;
+}
+
+// Default constructor
+FTFSharedMemoryReader::FTFSharedMemoryReader()
+{
+	Region = nullptr;
+	Header = nullptr;
+	SchemaArea = nullptr;
+	StaticArea = nullptr;
+	Slots = nullptr;
+	SlotSize = 0;
+	SchemaId = 0;
+	LastReadCount = 0;
+}
+
+// Destructor
+FTFSharedMemoryReader::~FTFSharedMemoryReader()
+{
+	Close();
+}
+
+// Map an existing region
+bool FTFSharedMemoryReader::Open(const FString& InName)
+{
+	Close();
+
+	// Map the header first for the size of the region
+	FPlatformMemory::FSharedMemoryRegion* HeaderRegion =
+		FPlatformMemory::MapNamedSharedMemoryRegion(InName, false, GetShmAccess(false), sizeof(FTFShmHeader));
+	if (HeaderRegion == nullptr)
+	{
+		return false;
+	}
+	const FTFShmHeader HeaderCopy = *static_cast<const FTFShmHeader*>(HeaderRegion->GetAddress());
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(HeaderRegion);
+	if (HeaderCopy.Magic != FTFSharedMemoryWriter::FileMagic || HeaderCopy.Version != FTFSharedMemoryWriter::Version ||
+		HeaderCopy.NumSlots == 0 || HeaderCopy.SlotCapacity == 0)
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d %s is not a tf shared memory region (version %u).."),
+			TEXT(__FUNCTION__), __LINE__, *InName, FTFSharedMemoryWriter::Version);
+		return false;
+	}
+
+	// The static area has the size of a slot
+	const SIZE_T RegionSize = sizeof(FTFShmHeader) + HeaderCopy.SchemaCapacity +
+		(HeaderCopy.NumSlots + 1) * FTFSharedMemoryWriter::GetSlotSize(HeaderCopy.SlotCapacity);
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, false, GetShmAccess(false), RegionSize);
+	if (Region == nullptr)
+	{
+		return false;
+	}
+
+	const uint8* Base = static_cast<const uint8*>(Region->GetAddress());
+	Header = reinterpret_cast<const FTFShmHeader*>(Base);
+	SchemaArea = Base + sizeof(FTFShmHeader);
+	StaticArea = SchemaArea + HeaderCopy.SchemaCapacity;
+	SlotSize = FTFSharedMemoryWriter::GetSlotSize(HeaderCopy.SlotCapacity);
+	Slots = StaticArea + SlotSize;
+	SchemaId = 0;
+	Schema.Reset();
+
+	// Start at the newest slot
+	LastReadCount = 0;
+	return true;
+}
+
+// Unmap the region
+void FTFSharedMemoryReader::Close()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		Header = nullptr;
+		SchemaArea = nullptr;
+		StaticArea = nullptr;
+		Slots = nullptr;
+	}
+	Schema.Reset();
+}
+
+// Number of slots written so far
+int64 FTFSharedMemoryReader::GetWriteCount() const
+{
+	return Header ? Header->WriteCount : 0;
+}
+
+// Copy the newest slot into the snapshot
+bool FTFSharedMemoryReader::ReadLatest(FTFSnapshot& OutSnapshot, uint32& OutFlags, double& OutWriteTime)
+{
+	if (Region == nullptr)
+	{
+		return false;
+	}
+
+	for (int32 Attempt = 0; Attempt < TFShmReadAttempts; ++Attempt)
+	{
+		const int64 WriteCount = Header->WriteCount;
+		if (WriteCount == 0 || WriteCount == LastReadCount)
+		{
+			return false; // Nothing new
+		}
+		FPlatformMisc::MemoryBarrier();
+
+		FTFShmSlot SlotCopy;
+		if (!CopySlot(Slots + ((WriteCount - 1) % Header->NumSlots) * SlotSize, OutSnapshot, SlotCopy))
+		{
+			continue; // Being written, or overwritten while copied
+		}
+		if (!BindSchema(SlotCopy, OutSnapshot))
+		{
+			return false;
+		}
+		OutFlags = SlotCopy.Flags;
+		OutWriteTime = SlotCopy.WriteTime;
+		LastReadCount = WriteCount;
+		return true;
+	}
+	return false;
+}
+
+// Copy the static frames into the snapshot
+bool FTFSharedMemoryReader::ReadStatic(FTFSnapshot& OutSnapshot, double& OutWriteTime)
+{
+	if (Region == nullptr)
+	{
+		return false;
+	}
+
+	for (int32 Attempt = 0; Attempt < TFShmReadAttempts; ++Attempt)
+	{
+		if (reinterpret_cast<const FTFShmSlot*>(StaticArea)->Lock == 0)
+		{
+			return false; // Never written
+		}
+
+		FTFShmSlot SlotCopy;
+		if (!CopySlot(StaticArea, OutSnapshot, SlotCopy))
+		{
+			continue; // Being written, or rewritten while copied
+		}
+		if (!BindSchema(SlotCopy, OutSnapshot))
+		{
+			return false;
+		}
+		OutWriteTime = SlotCopy.WriteTime;
+		return true;
+	}
+	return false;
+}
+
+// Copy the slot into the snapshot and its header
+bool FTFSharedMemoryReader::CopySlot(const uint8* InSlotData, FTFSnapshot& OutSnapshot, FTFShmSlot& OutSlot) const
+{
+	const FTFShmSlot* Slot = reinterpret_cast<const FTFShmSlot*>(InSlotData);
+	const FTFShmTransform* Transforms = reinterpret_cast<const FTFShmTransform*>(InSlotData + sizeof(FTFShmSlot));
+
+	const uint32 Lock = Slot->Lock;
+	if (Lock & 1)
+	{
+		return false; // Being written
+	}
+	FPlatformMisc::MemoryBarrier();
+
+	OutSlot = *Slot;
+	const int32 NumTransforms = FMath::Clamp<int32>(OutSlot.NumTransforms, 0, Header->SlotCapacity);
+	OutSnapshot.Reset();
+	for (int32 Pos = 0; Pos < NumTransforms; ++Pos)
+	{
+		const FTFShmTransform& ShmTransform = Transforms[Pos];
+		OutSnapshot.Indices.Emplace(ShmTransform.FrameIdx);
+		OutSnapshot.Transforms.Emplace(FConversions::ROSToU(FTransform(
+			FQuat(ShmTransform.Rotation[0], ShmTransform.Rotation[1], ShmTransform.Rotation[2], ShmTransform.Rotation[3]),
+			FVector(ShmTransform.Translation[0], ShmTransform.Translation[1], ShmTransform.Translation[2]))));
+	}
+
+	FPlatformMisc::MemoryBarrier();
+	return Slot->Lock == Lock; // Not overwritten while copied
+}
+
+// Bind the frame ids of the copied slot to the snapshot
+bool FTFSharedMemoryReader::BindSchema(const FTFShmSlot& InSlot, FTFSnapshot& OutSnapshot)
+{
+	if (!ReadSchema(InSlot.SchemaId))
+	{
+		return false;
+	}
+	for (const int32 FrameIdx : OutSnapshot.Indices)
+	{
+		if (!Schema->FrameIds.IsValidIndex(FrameIdx))
+		{
+			return false; // Not the schema of the slot
+		}
+	}
+
+	OutSnapshot.Time = FROSTime(InSlot.Secs, InSlot.NSecs);
+	OutSnapshot.Seq = InSlot.Seq;
+	OutSnapshot.Schema = Schema;
+	return true;
+}
+
+// Copy the schema area if it changed
+bool FTFSharedMemoryReader::ReadSchema(const uint32 InSchemaId)
+{
+	if (Schema.IsValid() && InSchemaId == SchemaId)
+	{
+		return true;
+	}
+
+	const uint32 Lock = Header->SchemaLock;
+	if ((Lock & 1) || Header->SchemaId != InSchemaId)
+	{
+		return false; // Being written, or the slot was written with a previous schema
+	}
+	FPlatformMisc::MemoryBarrier();
+
+	const int32* Counts = reinterpret_cast<const int32*>(SchemaArea);
+	const int32 NumFrames = Counts[0];
+	const int32 InternedSize = Counts[1];
+	if (NumFrames < 0 || InternedSize < 0 ||
+		2 * sizeof(int32) + NumFrames * sizeof(FTFShmFrame) + InternedSize > Header->SchemaCapacity)
+	{
+		return false;
+	}
+	const FTFShmFrame* Frames = reinterpret_cast<const FTFShmFrame*>(SchemaArea + 2 * sizeof(int32));
+	const ANSICHAR* Interned = reinterpret_cast<const ANSICHAR*>(Frames + NumFrames);
+
+	TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe> NewSchema = MakeShareable(new FTFFrameSchema());
+	TMap<FString, FTFInternedId> InternedIdsMap;
+	for (int32 Idx = 0; Idx < NumFrames; ++Idx)
+	{
+		const FTFShmFrame& Frame = Frames[Idx];
+		if (Frame.FrameIdOffset < 0 || Frame.FrameIdLength < 0 || Frame.FrameIdOffset + Frame.FrameIdLength > InternedSize ||
+			Frame.ParentFrameIdOffset < 0 || Frame.ParentFrameIdLength < 0 ||
+			Frame.ParentFrameIdOffset + Frame.ParentFrameIdLength > InternedSize)
+		{
+			return false; // Torn read
+		}
+		NewSchema->AddFrame(FromUtf8(Interned + Frame.FrameIdOffset, Frame.FrameIdLength),
+			FromUtf8(Interned + Frame.ParentFrameIdOffset, Frame.ParentFrameIdLength), InternedIdsMap);
+	}
+
+	FPlatformMisc::MemoryBarrier();
+	if (Header->SchemaLock != Lock)
+	{
+		return false; // Rewritten while copied
+	}
+	Schema = NewSchema;
+	SchemaId = InSchemaId;
+	return true;
+}
+
+/**
+* Reads the tf shared memory region of a publisher (also from another process on the same host),
+* and logs the newest snapshot with its hand-off latency, and the number of latched static frames
+*
+* Usage: TF.ReadSharedMemory [Name] (default UTFPublisher_tf)
+*/
+namespace TFSharedMemoryCommands
+{
+	// Read and log the newest snapshot
+	static void Read(const TArray<FString>& Args)
+	{
+		const FString Name = Args.Num() > 0 ? Args[0] : TEXT("UTFPublisher_tf");
+		FTFSharedMemoryReader Reader;
+		if (!Reader.Open(Name))
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d No tf shared memory region %s.."), TEXT(__FUNCTION__), __LINE__, *Name);
+			return;
+		}
+
+		FTFSnapshot Snapshot;
+		uint32 Flags;
+		double WriteTime;
+		if (!Reader.ReadLatest(Snapshot, Flags, WriteTime))
+		{
+			UE_LOG(LogTF, Display, TEXT("%s::%d No consistent snapshot in %s (%lld written).."),
+				TEXT(__FUNCTION__), __LINE__, *Name, Reader.GetWriteCount());
+			return;
+		}
+
+		FTFSnapshot StaticSnapshot;
+		double StaticWriteTime;
+		const int32 NumStatic = Reader.ReadStatic(StaticSnapshot, StaticWriteTime) ? StaticSnapshot.Num() : 0;
+
+		UE_LOG(LogTF, Display, TEXT("%s::%d %s: seq %u, %d transforms of %d frames (%d static), written %.3f ms ago (%lld written)"),
+			TEXT(__FUNCTION__), __LINE__, *Name, Snapshot.Seq, Snapshot.Num(), Snapshot.Schema->FrameIds.Num(), NumStatic,
+			(FPlatformTime::Seconds() - WriteTime) * 1000.0, Reader.GetWriteCount());
+		for (int32 Pos = 0; Pos < FMath::Min(Snapshot.Num(), 10); ++Pos)
+		{
+			const int32 Idx = Snapshot.Indices[Pos];
+			UE_LOG(LogTF, Display, TEXT("%s::%d   %s -> %s: %s"), TEXT(__FUNCTION__), __LINE__,
+				*Snapshot.Schema->ParentFrameIds[Idx], *Snapshot.Schema->FrameIds[Idx], *Snapshot.Transforms[Pos].ToString());
+		}
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("TF.ReadSharedMemory"),
+		TEXT("Log the newest tf snapshot of a shared memory region. Usage: TF.ReadSharedMemory [Name]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Read));
+}
@@ -0,0 +1,126 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFSnapshot.h"
+#include "Conversions.h"
+
+// Append the frame ids of a layout node
+void FTFFrameSchema::AddFrame(const FString& InFrameId, const FString& InParentFrameId,
+	TMap<FString, FTFInternedId>& InternedIdsMap)
+{
+	FrameIds.Emplace(InFrameId);
+	ParentFrameIds.Emplace(InParentFrameId);
+	Utf8FrameIds.Emplace(Intern(InFrameId, InternedIdsMap));
+	Utf8ParentFrameIds.Emplace(Intern(InParentFrameId, InternedIdsMap));
+}
+
+// Intern the frame id, returns the existing entry if it was already interned
+FTFInternedId FTFFrameSchema::Intern(const FString& InFrameId, TMap<FString, FTFInternedId>& InternedIdsMap)
+{
+	if (const FTFInternedId* Found = InternedIdsMap.Find(InFrameId))
+	{
+		return *Found;
+	}
+
+	FTCHARToUTF8 Utf8Id(*InFrameId);
+	FTFInternedId NewId;
+	NewId.Offset = InternedIds.Num();
+	NewId.Length = Utf8Id.Length();
+	InternedIds.Append(Utf8Id.Get(), Utf8Id.Length());
+	InternedIds.Add('\0');
+	InternedIdsMap.Emplace(InFrameId, NewId);
+	return NewId;
+}
+
+// Append the frames of the older snapshot this snapshot does not carry
+void FTFSnapshot::MergeOlder(const FTFSnapshot& InOlder, TBitArray<>& CarriedScratch)
+{
+	if (!Schema.IsValid() || !InOlder.Schema.IsValid() || InOlder.Num() == 0)
+	{
+		return;
+	}
+
+	// Layout changed in between, the frames are looked up by id (removed or reparented frames are dropped)
+	const bool bSameSchema = Schema == InOlder.Schema;
+	TMap<FString, int32> FrameIdToIndex;
+	if (!bSameSchema)
+	{
+		FrameIdToIndex.Reserve(Schema->FrameIds.Num());
+		for (int32 Idx = 0; Idx < Schema->FrameIds.Num(); ++Idx)
+		{
+			FrameIdToIndex.Emplace(Schema->FrameIds[Idx], Idx);
+		}
+	}
+
+	CarriedScratch.Init(false, Schema->FrameIds.Num());
+	for (const int32 Idx : Indices)
+	{
+		CarriedScratch[Idx] = true;
+	}
+
+	// The merged frames are published as separate chunks if either snapshot is chunked
+	const bool bChunked = ChunkEnds.Num() > 0 || InOlder.ChunkEnds.Num() > 0;
+	if (bChunked && ChunkEnds.Num() == 0 && Num() > 0)
+	{
+		ChunkEnds.Add(Num());
+	}
+
+	for (int32 ChunkIdx = 0; ChunkIdx < InOlder.NumChunks(); ++ChunkIdx)
+	{
+		int32 Start, End;
+		InOlder.GetChunk(ChunkIdx, Start, End);
+		for (int32 Pos = Start; Pos < End; ++Pos)
+		{
+			int32 Idx = InOlder.Indices[Pos];
+			if (!bSameSchema)
+			{
+				const int32* NewIdx = FrameIdToIndex.Find(InOlder.Schema->FrameIds[Idx]);
+				if (NewIdx == nullptr || Schema->ParentFrameIds[*NewIdx] != InOlder.Schema->ParentFrameIds[Idx])
+				{
+					continue;
+				}
+				Idx = *NewIdx;
+			}
+			if (!CarriedScratch[Idx])
+			{
+				CarriedScratch[Idx] = true;
+				Indices.Add(Idx);
+				Transforms.Add(InOlder.Transforms[Pos]);
+			}
+		}
+		if (bChunked && Num() > (ChunkEnds.Num() > 0 ? ChunkEnds.Last() : 0))
+		{
+			ChunkEnds.Add(Num());
+		}
+	}
+}
+
+// Convert the transforms in the [Start, End) positions to a tf message
+TSharedPtr<tf2_msgs::TFMessage> FTFSnapshot::GetTFMessageMsg(const int32 InStart, const int32 InEnd) const
+{
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr =
+		MakeShareable(new tf2_msgs::TFMessage());
+
+	for (int32 Pos = InStart; Pos < InEnd; ++Pos)
+	{
+		const int32 Idx = Indices[Pos];
+
+		std_msgs::Header Header;
+		Header.SetSeq(Seq);
+		Header.SetFrameId(Schema->ParentFrameIds[Idx]);
+		Header.SetStamp(Time);
+
+		// Transform to ROS coordinate system
+		const FTransform ROSTransf = FConversions::UToROS(Transforms[Pos]);
+
+		geometry_msgs::TransformStamped StampedTransformMsg;
+		StampedTransformMsg.SetHeader(Header);
+		StampedTransformMsg.SetChildFrameId(Schema->FrameIds[Idx]);
+		StampedTransformMsg.SetTransform(geometry_msgs::Transform(
+			geometry_msgs::Vector3(ROSTransf.GetLocation()),
+			geometry_msgs::Quaternion(ROSTransf.GetRotation())));
+
+		TFMsgPtr->AddTransform(StampedTransformMsg);
+	}
+	return TFMsgPtr;
+}
@@ -0,0 +1,82 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFStats.h"
+
+DEFINE_STAT(STAT_TFPublish);
+DEFINE_STAT(STAT_TFBuild);
+DEFINE_STAT(STAT_TFTagScan);
+DEFINE_STAT(STAT_TFBuildResolve);
+DEFINE_STAT(STAT_TFBuildNodes);
+DEFINE_STAT(STAT_TFNodeSweep);
+DEFINE_STAT(STAT_TFUpdateLayout);
+DEFINE_STAT(STAT_TFGather);
+DEFINE_STAT(STAT_TFSelectChanged);
+DEFINE_STAT(STAT_TFUpdateStatic);
+DEFINE_STAT(STAT_TFBuildMessages);
+DEFINE_STAT(STAT_TFCopySnapshot);
+DEFINE_STAT(STAT_TFRecordTransforms);
+DEFINE_STAT(STAT_TFLookupTransform);
+DEFINE_STAT(STAT_TFSerializeBson);
+DEFINE_STAT(STAT_TFPublishMsg);
+DEFINE_STAT(STAT_TFProcess);
+DEFINE_STAT(STAT_TFSubscribeParse);
+DEFINE_STAT(STAT_TFSubscribeApply);
+DEFINE_STAT(STAT_TFSharedMemoryWrite);
+
+DEFINE_STAT(STAT_TFPublishedNodes);
+DEFINE_STAT(STAT_TFPublishedMessages);
+DEFINE_STAT(STAT_TFSerializedBytes);
+DEFINE_STAT(STAT_TFSubscribeApplied);
+DEFINE_STAT(STAT_TFSharedMemoryBytes);
+
+DEFINE_STAT(STAT_TFNodes);
+DEFINE_STAT(STAT_TFDroppedMessages);
+DEFINE_STAT(STAT_TFCoalescedSnapshots);
+DEFINE_STAT(STAT_TFStaleSnapshots);
+DEFINE_STAT(STAT_TFSubscribeSkipped);
+
+DEFINE_STAT(STAT_TFAdaptiveRate);
+DEFINE_STAT(STAT_TFAdaptiveRateDecreases);
+DEFINE_STAT(STAT_TFAdaptiveRateIncreases);
+DEFINE_STAT(STAT_TFAdaptiveDeltaEnables);
+DEFINE_STAT(STAT_TFAdaptiveDeltaDisables);
+
+DEFINE_STAT(STAT_TFFixedRate);
+DEFINE_STAT(STAT_TFFixedRateJitter);
+
+DEFINE_STAT(STAT_TFLatencyLast);
+DEFINE_STAT(STAT_TFLatencyUnder1ms);
+DEFINE_STAT(STAT_TFLatency1To5ms);
+DEFINE_STAT(STAT_TFLatency5To20ms);
+DEFINE_STAT(STAT_TFLatency20To100ms);
+DEFINE_STAT(STAT_TFLatencyOver100ms);
+
+#if STATS
+// Add the latency to the histogram bucket, and set it as the last one
+void FTFStats::AddPublishLatency(const double InSeconds)
+{
+	const float Ms = static_cast<float>(InSeconds * 1000.0);
+	SET_FLOAT_STAT(STAT_TFLatencyLast, Ms);
+	if (Ms < 1.f)
+	{
+		INC_DWORD_STAT(STAT_TFLatencyUnder1ms);
+	}
+	else if (Ms < 5.f)
+	{
+		INC_DWORD_STAT(STAT_TFLatency1To5ms);
+	}
+	else if (Ms < 20.f)
+	{
+		INC_DWORD_STAT(STAT_TFLatency5To20ms);
+	}
+	else if (Ms < 100.f)
+	{
+		INC_DWORD_STAT(STAT_TFLatency20To100ms);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_TFLatencyOver100ms);
+	}
+}
+#endif // STATS
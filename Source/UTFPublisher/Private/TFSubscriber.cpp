@@ -0,0 +1,337 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFSubscriber.h"
+#include "TFPublisher.h"
+#include "TFStats.h"
+#include "Conversions.h"
+#include "EngineUtils.h"
+#include "Components/SceneComponent.h"
+#include "tf2_msgs/TFMessage.h"
+
+// Remove the leading slash of a tf1 style frame id, and prefix it with the namespace
+static FString MakeFrameId(const FString& InFrameId, const FString& InPrefix, const FString& InRootFrameId)
+{
+	FString FrameId = InFrameId;
+	FrameId.RemoveFromStart(TEXT("/"));
+	if (InPrefix.IsEmpty() || FrameId == InRootFrameId || FrameId.StartsWith(InPrefix))
+	{
+		return FrameId;
+	}
+	return InPrefix + FrameId;
+}
+
+// Constructor
+FTFMessageSubscriber::FTFMessageSubscriber(const FString& InTopic, ATFSubscriber* InOwner)
+	: FROSBridgeSubscriber(InTopic, TEXT("tf2_msgs/TFMessage"))
+{
+	Owner = InOwner;
+}
+
+// Parse the message and convert its transforms in one pass (websocket thread)
+TSharedPtr<FROSBridgeMsg> FTFMessageSubscriber::ParseMessage(TSharedPtr<FJsonObject> InJsonObject) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFSubscribeParse);
+	tf2_msgs::TFMessage TFMsg;
+	TFMsg.FromJson(InJsonObject);
+	const TArray<geometry_msgs::TransformStamped>& Transforms = TFMsg.GetTransforms();
+
+	// The settings of the owner are constant while subscribed
+	const FString Prefix = Owner->Namespace.IsEmpty() ? FString() : Owner->Namespace + TEXT("/");
+	const FString& RootFrameId = Owner->TFRootFrameName;
+
+	TSharedPtr<FTFReceivedMsg> ReceivedMsg = MakeShareable(new FTFReceivedMsg());
+	ReceivedMsg->FrameIds.Reserve(Transforms.Num());
+	ReceivedMsg->ParentFrameIds.Reserve(Transforms.Num());
+	ReceivedMsg->Transforms.Reserve(Transforms.Num());
+	for (const auto& TransformItr : Transforms)
+	{
+		const geometry_msgs::Transform& TransfMsg = TransformItr.GetTransform();
+		ReceivedMsg->FrameIds.Emplace(MakeFrameId(TransformItr.GetChildFrameId(), Prefix, RootFrameId));
+		ReceivedMsg->ParentFrameIds.Emplace(MakeFrameId(TransformItr.GetHeader().GetFrameId(), Prefix, RootFrameId));
+		ReceivedMsg->Transforms.Emplace(FConversions::ROSToU(FTransform(
+			TransfMsg.GetRotation().GetQuat(), TransfMsg.GetTranslation().GetVector())));
+	}
+	return ReceivedMsg;
+}
+
+// Hand the converted message over to the owner (game thread)
+void FTFMessageSubscriber::Callback(TSharedPtr<FROSBridgeMsg> InMsg)
+{
+	Owner->AddReceived(*StaticCastSharedPtr<FTFReceivedMsg>(InMsg));
+}
+
+// Sets default values
+ATFSubscriber::ATFSubscriber()
+{
+	// Set this actor to call Tick() every frame
+	PrimaryActorTick.bCanEverTick = true;
+
+	// ROSBridge server default values
+	ServerIP = "127.0.0.1";
+	ServerPORT = 9090;
+
+	TFTopic = TEXT("/tf");
+	bSubscribeStatic = true;
+	TFRootFrameName = TEXT("map");
+	bSkipSelfPublished = true;
+	PublishersVersion = 0;
+}
+
+// Called when the game starts or when spawned
+void ATFSubscriber::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Bind the frame ids to the tagged objects (no node component, the nodes are removed with their actors)
+	TFTree.SetNodeStorage(ETFNodeStorage::Arena);
+	TFTree.Init(TFRootFrameName);
+	if (!Namespace.IsEmpty())
+	{
+		TFTree.SetNamespaceFilter(Namespace);
+	}
+	TFTree.Build(GetWorld());
+
+	ROSBridgeHandler = MakeShareable<FROSBridgeHandler>(new FROSBridgeHandler(ServerIP, ServerPORT));
+	ROSBridgeHandler->AddSubscriber(MakeShareable(new FTFMessageSubscriber(TFTopic, this)));
+	if (bSubscribeStatic)
+	{
+		ROSBridgeHandler->AddSubscriber(MakeShareable(new FTFMessageSubscriber(TEXT("/tf_static"), this)));
+	}
+	ROSBridgeHandler->Connect();
+
+	UE_LOG(LogTF, Log, TEXT("%s::%d Driving %d tagged objects from %s.."),
+		TEXT(__FUNCTION__), __LINE__, TFTree.TFNodes.Num(), *TFTopic);
+}
+
+// Called when destroyed or game stopped
+void ATFSubscriber::EndPlay(const EEndPlayReason::Type Reason)
+{
+	// No callbacks after this point
+	if (ROSBridgeHandler.IsValid())
+	{
+		ROSBridgeHandler->Disconnect();
+		ROSBridgeHandler.Reset();
+	}
+	TFTree.Empty();
+
+	Super::EndPlay(Reason);
+}
+
+// Called every frame
+void ATFSubscriber::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Frames added to the publishers of this world after their first receive are skipped from now on
+	if (bSkipSelfPublished)
+	{
+		UpdateSelfPublished();
+	}
+
+	// Hand over the parsed messages (callbacks)
+	if (ROSBridgeHandler.IsValid())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TFProcess);
+		ROSBridgeHandler->Process();
+	}
+
+	ApplyReceived();
+}
+
+// Keep the newest transforms of the received frames (game thread)
+void ATFSubscriber::AddReceived(const FTFReceivedMsg& InMsg)
+{
+	for (int32 Idx = 0; Idx < InMsg.FrameIds.Num(); ++Idx)
+	{
+		const FString& FrameId = InMsg.FrameIds[Idx];
+		const FString& ParentFrameId = InMsg.ParentFrameIds[Idx];
+
+		FTFReceivedFrame* Frame = ReceivedFrames.Find(FrameId);
+		if (Frame == nullptr)
+		{
+			// First receive, check once if the frame comes from this world
+			Frame = &ReceivedFrames.Emplace(FrameId);
+			Frame->bSelfPublished = bSkipSelfPublished && IsSelfPublished(FrameId);
+			if (Frame->bSelfPublished)
+			{
+				INC_DWORD_STAT(STAT_TFSubscribeSkipped);
+				UE_LOG(LogTF, Log, TEXT("%s::%d Frame %s is published from this world, skipping it.."),
+					TEXT(__FUNCTION__), __LINE__, *FrameId);
+			}
+			ReceivedChildren.FindOrAdd(ParentFrameId).Emplace(FrameId);
+		}
+		else if (Frame->ParentFrameId != ParentFrameId)
+		{
+			// Reparented
+			if (TArray<FString>* PrevSiblings = ReceivedChildren.Find(Frame->ParentFrameId))
+			{
+				PrevSiblings->RemoveSingleSwap(FrameId, false);
+			}
+			ReceivedChildren.FindOrAdd(ParentFrameId).Emplace(FrameId);
+		}
+		// The parent is kept for the skipped frames as well (the children lists stay in sync)
+		Frame->ParentFrameId = ParentFrameId;
+		if (Frame->bSelfPublished)
+		{
+			continue;
+		}
+		Frame->Transform = InMsg.Transforms[Idx];
+		UpdatedFrameIds.Add(FrameId);
+	}
+}
+
+// Resolve the updated frames into world transforms and apply them to their objects
+void ATFSubscriber::ApplyReceived()
+{
+	if (UpdatedFrameIds.Num() == 0)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFSubscribeApply);
+
+	// The received descendants of the updated frames move with them
+	TArray<FString> Pending = UpdatedFrameIds.Array();
+	while (Pending.Num() > 0)
+	{
+		const FString FrameId = Pending.Pop(false);
+		if (const TArray<FString>* Children = ReceivedChildren.Find(FrameId))
+		{
+			for (const auto& ChildItr : *Children)
+			{
+				bool bAlreadyUpdated = false;
+				UpdatedFrameIds.Add(ChildItr, &bAlreadyUpdated);
+				if (!bAlreadyUpdated)
+				{
+					Pending.Emplace(ChildItr);
+				}
+			}
+		}
+	}
+
+	// Resolve the world transforms, the objects are queued parents first
+	ResolvedWorldTransforms.Reset();
+	ApplyObjects.Reset();
+	ApplyTransforms.Reset();
+	for (const auto& FrameIdItr : UpdatedFrameIds)
+	{
+		ResolveWorldTransform(FrameIdItr);
+	}
+	UpdatedFrameIds.Reset();
+
+	// Apply in one pass, teleporting (no sweep, the physics velocities are kept)
+	for (int32 Idx = 0; Idx < ApplyObjects.Num(); ++Idx)
+	{
+		if (AActor* Actor = Cast<AActor>(ApplyObjects[Idx]))
+		{
+			Actor->SetActorTransform(ApplyTransforms[Idx], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+		else if (USceneComponent* SceneComponent = Cast<USceneComponent>(ApplyObjects[Idx]))
+		{
+			SceneComponent->SetWorldTransform(ApplyTransforms[Idx], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+	}
+	INC_DWORD_STAT_BY(STAT_TFSubscribeApplied, ApplyObjects.Num());
+}
+
+// Resolve the world transform of the received frame (memoized for the current pass)
+bool ATFSubscriber::ResolveWorldTransform(const FString& InFrameId)
+{
+	// Walk up the received frames until a resolved frame, the root, or a frame of the simulation
+	ResolveChain.Reset();
+	FTransform ParentWorldTransform = FTransform::Identity;
+	const FString* FrameId = &InFrameId;
+	while (true)
+	{
+		if (const FTransform* Resolved = ResolvedWorldTransforms.Find(*FrameId))
+		{
+			ParentWorldTransform = *Resolved;
+			break;
+		}
+
+		const FTFReceivedFrame* Frame = ReceivedFrames.Find(*FrameId);
+		if (Frame == nullptr || Frame->bSelfPublished)
+		{
+			if (*FrameId == TFRootFrameName)
+			{
+				break; // World origin
+			}
+			const FTFNode* Node = TFTree.FindNode(*FrameId);
+			USceneComponent* Source = Node ? Node->GetTransformSource() : nullptr;
+			if (Source == nullptr)
+			{
+				return false; // Not connected to the world (yet)
+			}
+			ParentWorldTransform = Source->GetComponentTransform();
+			break;
+		}
+
+		if (ResolveChain.Num() > ReceivedFrames.Num())
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d The received frames of %s form a cycle.."),
+				TEXT(__FUNCTION__), __LINE__, *InFrameId);
+			return false;
+		}
+		ResolveChain.Emplace(FrameId);
+		FrameId = &Frame->ParentFrameId;
+	}
+
+	// Compose down the chain, parents first
+	for (int32 Idx = ResolveChain.Num() - 1; Idx >= 0; --Idx)
+	{
+		const FString& ChainFrameId = *ResolveChain[Idx];
+		ParentWorldTransform = ReceivedFrames[ChainFrameId].Transform * ParentWorldTransform;
+		ResolvedWorldTransforms.Emplace(ChainFrameId, ParentWorldTransform);
+
+		if (UpdatedFrameIds.Contains(ChainFrameId))
+		{
+			const FTFNode* Node = TFTree.FindNode(ChainFrameId);
+			if (UObject* Object = Node ? Node->GetAttachedObject() : nullptr)
+			{
+				ApplyObjects.Emplace(Object);
+				ApplyTransforms.Emplace(ParentWorldTransform);
+			}
+		}
+	}
+	return true;
+}
+
+// Re-check the driven frames if the topology of a publisher of this world changed
+void ATFSubscriber::UpdateSelfPublished()
+{
+	uint32 Version = 0;
+	for (TActorIterator<ATFPublisher> PublisherItr(GetWorld()); PublisherItr; ++PublisherItr)
+	{
+		Version = HashCombine(Version, HashCombine(PublisherItr->GetUniqueID(), PublisherItr->GetTopologyVersion()));
+	}
+	if (Version == PublishersVersion)
+	{
+		return;
+	}
+	PublishersVersion = Version;
+
+	for (auto& FrameItr : ReceivedFrames)
+	{
+		if (!FrameItr.Value.bSelfPublished && IsSelfPublished(FrameItr.Key))
+		{
+			FrameItr.Value.bSelfPublished = true;
+			UpdatedFrameIds.Remove(FrameItr.Key);
+			INC_DWORD_STAT(STAT_TFSubscribeSkipped);
+			UE_LOG(LogTF, Log, TEXT("%s::%d Frame %s is now published from this world, skipping it.."),
+				TEXT(__FUNCTION__), __LINE__, *FrameItr.Key);
+		}
+	}
+}
+
+// Check if a TFPublisher of this world publishes the frame
+bool ATFSubscriber::IsSelfPublished(const FString& InFrameId) const
+{
+	for (TActorIterator<ATFPublisher> PublisherItr(GetWorld()); PublisherItr; ++PublisherItr)
+	{
+		if (PublisherItr->PublishesFrame(InFrameId))
+		{
+			return true;
+		}
+	}
+	return false;
+}
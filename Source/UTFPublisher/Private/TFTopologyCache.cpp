@@ -0,0 +1,132 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFTopologyCache.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/Actor.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+// Get the cache file path of the level (and namespace) of the world
+FString FTFTopologyCache::GetFilePath(UWorld* InWorld, const FString& InNamespace)
+{
+	FString FileName = UWorld::RemovePIEPrefix(InWorld->GetMapName());
+	if (!InNamespace.IsEmpty())
+	{
+		FileName += TEXT("_") + InNamespace.Replace(TEXT("/"), TEXT("_"));
+	}
+	return FPaths::ProjectSavedDir() / TEXT("TFCache") / FileName + TEXT(".tftopo");
+}
+
+// Load the creation order if the cache matches the tag hash
+bool FTFTopologyCache::Load(const FString& InFilePath, const uint64 InTagHash, UWorld* InWorld,
+	TArray<FTFNodeBuildData>& OutBuildOrder)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *InFilePath, FILEREAD_Silent))
+	{
+		return false; // Not cached yet
+	}
+
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	uint32 FileVersion = 0;
+	uint64 TagHash = 0;
+	int32 NumEntries = 0;
+	Reader << Magic << FileVersion << TagHash << NumEntries;
+	if (Reader.IsError() || Magic != FileMagic || FileVersion != Version || NumEntries < 0 ||
+		NumEntries * MinEntrySize > Reader.TotalSize() - Reader.Tell())
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d %s is not a tf topology cache (version %u), rebuilding.."),
+			TEXT(__FUNCTION__), __LINE__, *InFilePath, Version);
+		return false;
+	}
+	if (TagHash != InTagHash)
+	{
+		UE_LOG(LogTF, Log, TEXT("%s::%d The tags changed since %s was cached, rebuilding.."),
+			TEXT(__FUNCTION__), __LINE__, *InFilePath);
+		return false;
+	}
+
+	// Worlds of the loaded levels (persistent and streamed) by name
+	TMap<FString, UWorld*> LevelWorlds;
+	for (ULevel* LevelItr : InWorld->GetLevels())
+	{
+		if (UWorld* LevelWorld = LevelItr ? LevelItr->GetTypedOuter<UWorld>() : nullptr)
+		{
+			LevelWorlds.Emplace(UWorld::RemovePIEPrefix(LevelWorld->GetName()), LevelWorld);
+		}
+	}
+
+	OutBuildOrder.Reset(NumEntries);
+	for (int32 Idx = 0; Idx < NumEntries; ++Idx)
+	{
+		FString LevelWorldName;
+		FString ObjectPath;
+		uint8 Binding = 0;
+		FTFNodeBuildData NodeData;
+		Reader << LevelWorldName << ObjectPath << Binding << NodeData.Namespace << NodeData.ChildFrameId
+			<< NodeData.ParentFrameId << NodeData.PublishRate << NodeData.bStatic << NodeData.bRootChild;
+		if (Reader.IsError())
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d %s is truncated, rebuilding.."), TEXT(__FUNCTION__), __LINE__, *InFilePath);
+			OutBuildOrder.Reset();
+			return false;
+		}
+
+		// Bind to the object directly, its kind has to match
+		UWorld* const* LevelWorld = LevelWorlds.Find(LevelWorldName);
+		UObject* Object = LevelWorld ? StaticFindObject(UObject::StaticClass(), *LevelWorld, *ObjectPath) : nullptr;
+		const bool bBound = Binding == ActorBinding ? Cast<AActor>(Object) != nullptr : Cast<USceneComponent>(Object) != nullptr;
+		if (!bBound)
+		{
+			UE_LOG(LogTF, Log, TEXT("%s::%d Cached object %s.%s not found, rebuilding.."),
+				TEXT(__FUNCTION__), __LINE__, *LevelWorldName, *ObjectPath);
+			OutBuildOrder.Reset();
+			return false;
+		}
+		NodeData.Object = Object;
+		OutBuildOrder.Emplace(MoveTemp(NodeData));
+	}
+	return true;
+}
+
+// Save the creation order with the tag hash
+bool FTFTopologyCache::Save(const FString& InFilePath, const uint64 InTagHash, const TArray<FTFNodeBuildData>& InBuildOrder)
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	uint32 Magic = FileMagic;
+	uint32 FileVersion = Version;
+	uint64 TagHash = InTagHash;
+	int32 NumEntries = InBuildOrder.Num();
+	Writer << Magic << FileVersion << TagHash << NumEntries;
+
+	for (const auto& NodeDataItr : InBuildOrder)
+	{
+		UObject* Object = NodeDataItr.Object.Get();
+		if (Object == nullptr)
+		{
+			return false; // Destroyed during the build, the topology is not the one of the level
+		}
+		UWorld* LevelWorld = Object->GetTypedOuter<UWorld>();
+		FString LevelWorldName = LevelWorld ? UWorld::RemovePIEPrefix(LevelWorld->GetName()) : FString();
+		FString ObjectPath = Object->GetPathName(LevelWorld);
+		uint8 Binding = Object->IsA(AActor::StaticClass()) ? ActorBinding : ComponentBinding;
+		FTFNodeBuildData NodeData = NodeDataItr;
+		Writer << LevelWorldName << ObjectPath << Binding << NodeData.Namespace << NodeData.ChildFrameId
+			<< NodeData.ParentFrameId << NodeData.PublishRate << NodeData.bStatic << NodeData.bRootChild;
+	}
+
+	if (!FFileHelper::SaveArrayToFile(Data, *InFilePath))
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d Could not write %s.."), TEXT(__FUNCTION__), __LINE__, *InFilePath);
+		return false;
+	}
+	UE_LOG(LogTF, Log, TEXT("%s::%d Cached the tf topology (%d frames) to %s.."),
+		TEXT(__FUNCTION__), __LINE__, NumEntries, *InFilePath);
+	return true;
+}
@@ -0,0 +1,1802 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "TFTree.h"
+#include "Async/ParallelFor.h"
+#include "Async/Async.h"
+#include "EngineUtils.h"
+#include "Conversions.h"
+#include "TFStats.h"
+#include "TFTopologyCache.h"
+#include "UObject/UObjectGlobals.h"
+
+// Default constructor
+FTFTree::FTFTree()
+{
+	Root = nullptr;
+	NodeStorage = ETFNodeStorage::Component;
+	NodeArena = MakeUnique<FTFNodeArena>();
+	NodeListener = nullptr;
+	SweepFrame = 0;
+	bUseNamespaceFilter = false;
+	bLayoutDirty = true;
+	TopologyVersion = 0;
+	bDeferTopologyChanges = false;
+	bTopologyChangeDeferred = false;
+	GatherStamp = 0;
+	BufferCapacity = 0;
+
+	// Serial gathering by default
+	ParallelSettings.bEnabled = false;
+	ParallelSettings.MinNodes = 2048;
+	ParallelSettings.ChunkSize = 512;
+
+	// Single message by default
+	ChunkSettings.MaxTransforms = 0;
+	ChunkSettings.MaxBytes = 0;
+
+	// No static nodes by default
+	StaticSettings.bEnabled = false;
+	StaticSettings.InvarianceSamples = 0;
+	StaticSettings.Tolerance = 1.e-3f;
+	StaticSettings.CheckInterval = 1.f;
+	NextStaticCheckTime = 0.f;
+	bStaticSelectionDirty = true;
+	bStaticNodesChanged = false;
+}
+
+// Destructor
+FTFTree::~FTFTree()
+{
+	Empty();
+}
+
+// Init with the root frame, blank if no object is given (a blank root will be ignored in the array)
+void FTFTree::Init(const FString& InRootFrameId, UObject* InRootObject)
+{
+	if (Root)
+	{
+		Empty();
+	}
+
+	// Root node (not anchored, it is removed with the tree)
+	Root = NodeArena->Allocate();
+	Root->Init(InRootFrameId, InRootObject);
+	FrameIdToNode.Emplace(Root->GetFrameId(), Root);
+	// If root is not blank, add to nodes array
+	if (!Root->IsBlank())
+	{
+		Root->SetTreeIndex(TFNodes.Emplace(Root));
+	}
+
+	if (NodeStorage == ETFNodeStorage::Arena)
+	{
+		// Forward the end play of the actors of the nodes
+		NodeListener = NewObject<UTFNodeListener>();
+		NodeListener->AddToRoot();
+		NodeListener->Init(this);
+
+		// Components destroyed without their actor are only detected as gone, remove them before they are freed
+		PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddRaw(this, &FTFTree::RemoveGoneNodes);
+	}
+	MarkTopologyChanged();
+}
+
+// Build tree from world
+bool FTFTree::Build(UWorld* InWorld)
+{
+	if (Root == nullptr)
+	{
+		// Tree is not initialized
+		return false;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFBuild);
+
+	// Get all objects with TF tags
+	TMap<UObject*, TMap<FString, FString>> ObjToTagData;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TFTagScan);
+		ObjToTagData = FTags::GetObjectKeyValuePairsMap(InWorld, TEXT("TF"));
+	}
+
+	// Group the objects by their parent frame id (O(n))
+	TMap<FString, TArray<FTFNodeBuildData>> ParentFrameIdToChildren;
+	GroupByParentFrameId(ObjToTagData, ParentFrameIdToChildren);
+
+	// Parents before their children, then the orphans and cycles as new root trees
+	TArray<FTFNodeBuildData> BuildOrder;
+	ResolveBuildOrder(Root->GetFrameId(), ParentFrameIdToChildren, BuildOrder);
+
+	for (const auto& NodeDataItr : BuildOrder)
+	{
+		AddBuildData(NodeDataItr);
+	}
+	return true;
+}
+
+// Build tree from the topology cache file if it matches the tags of the world
+bool FTFTree::BuildCached(UWorld* InWorld, const FString& InCacheFilePath)
+{
+	if (Root == nullptr)
+	{
+		// Tree is not initialized
+		return false;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFBuild);
+
+	// The tags are only hashed, they are parsed if the topology changed
+	TArray<FTFTaggedObject> TaggedObjects;
+	const uint64 TagHash = GatherTaggedObjects(InWorld, TaggedObjects, true);
+
+	TArray<FTFNodeBuildData> BuildOrder;
+	const bool bCached = FTFTopologyCache::Load(InCacheFilePath, TagHash, InWorld, BuildOrder);
+	if (!bCached)
+	{
+		ResolveTaggedObjects(TaggedObjects, Root->GetFrameId(), bUseNamespaceFilter, NamespaceFilter, BuildOrder);
+	}
+
+	for (const auto& NodeDataItr : BuildOrder)
+	{
+		AddBuildData(NodeDataItr);
+	}
+
+	if (!bCached)
+	{
+		FTFTopologyCache::Save(InCacheFilePath, TagHash, BuildOrder);
+	}
+	return true;
+}
+
+// Start building the tree from the world in the background
+bool FTFTree::BeginAsyncBuild(UWorld* InWorld, const FString& InCacheFilePath)
+{
+	if (Root == nullptr || AsyncBuild.IsValid())
+	{
+		// Tree is not initialized, or already building
+		return false;
+	}
+
+	// Only copy the raw tags on the game thread (or bind the cached topology)
+	AsyncBuild = MakeShareable(new FTFAsyncBuild());
+	AsyncBuild->StartTime = FPlatformTime::Seconds();
+	AsyncBuild->RootFrameId = Root->GetFrameId();
+	AsyncBuild->NamespaceFilter = NamespaceFilter;
+	AsyncBuild->bUseNamespaceFilter = bUseNamespaceFilter;
+	const bool bUseCache = !InCacheFilePath.IsEmpty();
+	const uint64 TagHash = GatherTaggedObjects(InWorld, AsyncBuild->TaggedObjects, bUseCache);
+	if (bUseCache)
+	{
+		if (FTFTopologyCache::Load(InCacheFilePath, TagHash, InWorld, AsyncBuild->BuildOrder))
+		{
+			AsyncBuild->TaggedObjects.Empty();
+		}
+		else
+		{
+			AsyncBuild->CacheFilePath = InCacheFilePath;
+			AsyncBuild->TagHash = TagHash;
+		}
+	}
+
+	// The task only reads the build state (the tree waits for it before it is emptied),
+	// the build state is only read by the game thread once it is ready
+	FTFAsyncBuild* Build = AsyncBuild.Get();
+	AsyncBuild->Task = Async<void>(EAsyncExecution::ThreadPool, [Build]()
+	{
+		ResolveAsyncBuild(*Build);
+	});
+	return true;
+}
+
+// Create the nodes of the asynchronous build within the time budget
+bool FTFTree::UpdateAsyncBuild(const double InTimeBudget)
+{
+	if (!AsyncBuild.IsValid())
+	{
+		return true;
+	}
+	if (!AsyncBuild->Task.IsReady())
+	{
+		return false; // Still resolving
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFBuildNodes);
+
+	// At least one node per call, the build always progresses,
+	// the layout is invalidated once for the nodes of the slice instead of once per node
+	const double EndTime = FPlatformTime::Seconds() + InTimeBudget;
+	const TArray<FTFNodeBuildData>& BuildOrder = AsyncBuild->BuildOrder;
+	bDeferTopologyChanges = true;
+	while (AsyncBuild->NextIdx < BuildOrder.Num())
+	{
+		const FTFNodeBuildData& NodeData = BuildOrder[AsyncBuild->NextIdx++];
+		AsyncBuild->QueuedFrameIds.Remove(NodeData.ChildFrameId);
+		AddBuildData(NodeData);
+		if (FPlatformTime::Seconds() >= EndTime)
+		{
+			break;
+		}
+	}
+	bDeferTopologyChanges = false;
+	if (AsyncBuild->NextIdx < BuildOrder.Num())
+	{
+		if (bTopologyChangeDeferred)
+		{
+			bTopologyChangeDeferred = false;
+			MarkTopologyChanged();
+		}
+		return false;
+	}
+	bTopologyChangeDeferred = false;
+
+	UE_LOG(LogTF, Log, TEXT("%s::%d Asynchronous build of %d nodes done in %.2f s.."),
+		TEXT(__FUNCTION__), __LINE__, BuildOrder.Num(), FPlatformTime::Seconds() - AsyncBuild->StartTime);
+	if (!AsyncBuild->CacheFilePath.IsEmpty())
+	{
+		FTFTopologyCache::Save(AsyncBuild->CacheFilePath, AsyncBuild->TagHash, BuildOrder);
+	}
+	AsyncBuild.Reset();
+
+	// Nodes still waiting for a parent are now published as root children
+	MarkTopologyChanged();
+	return true;
+}
+
+// Add node (if bAddAsOrphanIfParentNotFound is true, add node as a root child node if the parent was not found)
+bool FTFTree::AddNode(const FString& InChildFrameId, UObject* InAttachedObject, const FString& InParentFrameId,
+	bool bAddAsOrphanIfParentNotFound, float InPublishRate, bool bInStatic)
+{
+	// Check if parent in the tree
+	if (FTFNode* FoundNode = FindNode(InParentFrameId))
+	{
+		return CreateNode(InChildFrameId, InAttachedObject, FoundNode, InPublishRate, bInStatic) != nullptr;
+	}
+	else if (bAddAsOrphanIfParentNotFound && Root)
+	{
+		// Add orphan node as a root child, it is moved to its parent once the parent is added
+		if (FTFNode* OrphanNode = CreateNode(InChildFrameId, InAttachedObject, Root, InPublishRate, bInStatic))
+		{
+			AddPendingChild(OrphanNode, InParentFrameId);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Add a tagged object (at runtime), the node waits under the root if its parent frame is not in the tree yet
+bool FTFTree::AddObject(UObject* InObject, const TMap<FString, FString>& InTagData)
+{
+	if (Root == nullptr || !IsInNamespace(InTagData))
+	{
+		return false; // Tree not initialized, or object of another namespace
+	}
+	return AddBuildData(MakeBuildData(InObject, InObject->GetFName(), InTagData, Root->GetFrameId()));
+}
+
+// Only add the objects of the given namespace (empty = the objects without namespace)
+void FTFTree::SetNamespaceFilter(const FString& InNamespace)
+{
+	NamespaceFilter = InNamespace;
+	bUseNamespaceFilter = true;
+}
+
+// Check if the object with the given tag key value pairs belongs to the tree namespace
+bool FTFTree::IsInNamespace(const TMap<FString, FString>& InTagData) const
+{
+	return IsInNamespace(InTagData, bUseNamespaceFilter, NamespaceFilter);
+}
+
+// Check if the object with the given tag key value pairs belongs to the namespace (any thread)
+bool FTFTree::IsInNamespace(const TMap<FString, FString>& InTagData, const bool bInUseNamespaceFilter, const FString& InNamespaceFilter)
+{
+	return !bInUseNamespaceFilter || GetNamespace(InTagData) == InNamespaceFilter;
+}
+
+// Get the namespace of a tagged object
+FString FTFTree::GetNamespace(const TMap<FString, FString>& InTagData)
+{
+	const FString* Namespace = InTagData.Find(TEXT("Namespace"));
+	if (Namespace == nullptr)
+	{
+		return FString();
+	}
+	FString Trimmed = *Namespace;
+	Trimmed.RemoveFromStart(TEXT("/"));
+	Trimmed.RemoveFromEnd(TEXT("/"));
+	return Trimmed;
+}
+
+// Find node (O(1) lookup in the frame id index)
+FTFNode* FTFTree::FindNode(const FString& InFrameId) const
+{
+	if (FTFNode* const* FoundNode = FrameIdToNode.Find(InFrameId))
+	{
+		return *FoundNode;
+	}
+	return nullptr; // Node not found
+}
+
+// Add root child node (add child node directly to the root)
+bool FTFTree::AddRootChildNode(const FString& InChildFrameId, UObject* InAttachedObject, float InPublishRate,
+	bool bInStatic)
+{
+	if (Root)
+	{
+		return CreateNode(InChildFrameId, InAttachedObject, Root, InPublishRate, bInStatic) != nullptr;
+	}
+	return false; // Tree not initialized
+}
+
+// Remove node (O(1) besides relinking its children)
+void FTFTree::RemoveNode(FTFNode* InNode)
+{
+	if (InNode == Root)
+	{
+		// Empty tree
+		Empty();
+	}
+	else
+	{
+		const int32 TreeIdx = InNode->GetTreeIndex();
+		if (!TFNodes.IsValidIndex(TreeIdx) || TFNodes[TreeIdx] != InNode)
+		{
+			return; // Not in the tree
+		}
+
+		// Stop waiting for a parent
+		RemovePendingChild(InNode);
+
+		// Remove linking to parent, link children to parent, the children wait for a node with the same frame id
+		const TArray<FTFNode*> Children = InNode->GetChildren();
+		InNode->Clear();
+		for (const auto& ChildItr : Children)
+		{
+			AddPendingChild(ChildItr, InNode->GetFrameId());
+		}
+
+		// Remove node from the frame id index (only if it was not taken over by another node)
+		if (FindNode(InNode->GetFrameId()) == InNode)
+		{
+			FrameIdToNode.Remove(InNode->GetFrameId());
+		}
+
+		// Remove node from tree array, the last node is swapped into its slot
+		TFNodes.RemoveAtSwap(TreeIdx, 1, false);
+		if (TFNodes.IsValidIndex(TreeIdx))
+		{
+			TFNodes[TreeIdx]->SetTreeIndex(TreeIdx);
+		}
+		MarkTopologyChanged();
+
+		// Destroy the anchor if the tree removes the node (the anchor released the node if it is being destroyed)
+		if (UTFNode* Anchor = InNode->GetAnchor())
+		{
+			Anchor->ReleaseOwnerTree();
+			Anchor->DestroyComponent();
+		}
+		UntrackActorNode(InNode);
+		NodeArena->Free(InNode);
+	}
+}
+
+// Remove the nodes attached to the actor or its components (arena storage)
+void FTFTree::RemoveActorNodes(AActor* InActor)
+{
+	TArray<FTFNode*> Nodes;
+	if (ActorNodes.RemoveAndCopyValue(FObjectKey(InActor), Nodes))
+	{
+		InActor->OnEndPlay.RemoveDynamic(NodeListener, &UTFNodeListener::OnActorEndPlay);
+		for (FTFNode* NodeItr : Nodes)
+		{
+			RemoveNode(NodeItr);
+		}
+	}
+}
+
+// Remove the nodes whose object is gone (arena storage)
+void FTFTree::RemoveGoneNodes()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFNodeSweep);
+	TArray<FTFNode*> GoneNodes;
+	for (FTFNode* NodeItr : TFNodes)
+	{
+		if (NodeItr != Root && NodeItr->IsAttachedObjectGone())
+		{
+			GoneNodes.Emplace(NodeItr);
+		}
+	}
+	for (FTFNode* NodeItr : GoneNodes)
+	{
+		RemoveNode(NodeItr);
+	}
+}
+
+// Set the static nodes detection settings
+void FTFTree::SetStaticSettings(const FTFStaticSettings& InStaticSettings)
+{
+	StaticSettings = InStaticSettings;
+	bLayoutDirty = true;
+}
+
+// Get tf message
+TSharedPtr<tf2_msgs::TFMessage> FTFTree::GetTFMessageMsg(const FROSTime& InTime, const uint32 InSeq)
+{
+	const TArray<int32>& Indices = SelectAndGather(0.f, nullptr, false);
+
+	// Create TFMessage
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr =
+		MakeShareable(new tf2_msgs::TFMessage());
+	AddTransforms(Indices, InTime, InSeq, TFMsgPtr);
+	return TFMsgPtr;
+}
+
+// Get tf message with only the frames which moved more than the given thresholds since their last publish
+TSharedPtr<tf2_msgs::TFMessage> FTFTree::GetDeltaTFMessageMsg(const FROSTime& InTime, const uint32 InSeq,
+	const FTFDeltaSettings& InDeltaSettings)
+{
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr;
+	AddTransforms(SelectAndGather(0.f, &InDeltaSettings, false), InTime, InSeq, TFMsgPtr);
+	return TFMsgPtr;
+}
+
+// Get tf message with only the nodes of the rate buckets due at the given world time
+TSharedPtr<tf2_msgs::TFMessage> FTFTree::GetMultiRateTFMessageMsg(const FROSTime& InTime, const uint32 InSeq,
+	const float InWorldTime, const FTFDeltaSettings* InDeltaSettings)
+{
+	TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr;
+	AddTransforms(SelectAndGather(InWorldTime, InDeltaSettings, true), InTime, InSeq, TFMsgPtr);
+	return TFMsgPtr;
+}
+
+// Copy the raw tf transforms of the nodes to publish into the snapshot
+bool FTFTree::GetSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq,
+	const float InWorldTime, const FTFDeltaSettings* InDeltaSettings, const bool bInMultiRate)
+{
+	const TArray<int32>& Indices = SelectAndGather(InWorldTime, InDeltaSettings, bInMultiRate);
+	SCOPE_CYCLE_COUNTER(STAT_TFCopySnapshot);
+	INC_DWORD_STAT_BY(STAT_TFPublishedNodes, Indices.Num());
+
+	OutSnapshot.Reset();
+	OutSnapshot.CaptureTime = FPlatformTime::Seconds();
+	OutSnapshot.Time = InTime;
+	OutSnapshot.Seq = InSeq;
+	OutSnapshot.bPartial = InDeltaSettings != nullptr || bInMultiRate;
+	OutSnapshot.Schema = FrameSchema;
+	OutSnapshot.Indices.Append(Indices);
+	if (ChunkSettings.IsEnabled())
+	{
+		// Layout order keeps the subtrees contiguous (the due rate buckets are appended one after the other)
+		OutSnapshot.Indices.Sort();
+		SplitIntoChunks(OutSnapshot.Indices, OutSnapshot.ChunkEnds);
+	}
+	OutSnapshot.Transforms.SetNumUninitialized(Indices.Num(), false);
+	for (int32 Pos = 0; Pos < Indices.Num(); ++Pos)
+	{
+		OutSnapshot.Transforms[Pos] = Transforms[OutSnapshot.Indices[Pos]];
+	}
+	return OutSnapshot.Num() > 0;
+}
+
+// Add a channel publishing the frames of the subtree and / or matching the pattern
+int32 FTFTree::AddChannel(const FString& InTopic, const FString& InSubtreeRootFrameId, const FString& InFramePattern,
+	const float InPublishRate)
+{
+	const int32 ChannelIdx = Channels.AddDefaulted();
+	FTFChannel& Channel = Channels[ChannelIdx];
+	Channel.Topic = InTopic;
+	Channel.SubtreeRootFrameId = InSubtreeRootFrameId;
+	Channel.FramePattern = InFramePattern;
+	Channel.PublishRate = FMath::Max(InPublishRate, 0.f);
+	Channel.NextPublishTime = 0.f;
+	bLayoutDirty = true;
+	return ChannelIdx;
+}
+
+// Copy the tf transforms of the dynamic members of the channel into the snapshot if the channel is due
+bool FTFTree::GetChannelSnapshot(const int32 InChannelIdx, FTFSnapshot& OutSnapshot, const FROSTime& InTime,
+	const uint32 InSeq, const float InWorldTime)
+{
+	UpdateLayout();
+	UpdateStaticSelection();
+
+	FTFChannel& Channel = Channels[InChannelIdx];
+	if (Channel.PublishRate > 0.f)
+	{
+		if (InWorldTime < Channel.NextPublishTime)
+		{
+			return false; // Channel not due
+		}
+		// Schedule next publish, if the channel fell behind restart from the current time
+		Channel.NextPublishTime += 1.f / Channel.PublishRate;
+		if (Channel.NextPublishTime < InWorldTime)
+		{
+			Channel.NextPublishTime = InWorldTime + 1.f / Channel.PublishRate;
+		}
+	}
+
+	GatherTransforms(Channel.DynamicIndices);
+	SCOPE_CYCLE_COUNTER(STAT_TFCopySnapshot);
+	INC_DWORD_STAT_BY(STAT_TFPublishedNodes, Channel.DynamicIndices.Num());
+
+	OutSnapshot.Reset();
+	OutSnapshot.CaptureTime = FPlatformTime::Seconds();
+	OutSnapshot.Time = InTime;
+	OutSnapshot.Seq = InSeq;
+	OutSnapshot.bPartial = false;
+	OutSnapshot.Schema = FrameSchema;
+	OutSnapshot.Indices.Append(Channel.DynamicIndices);
+	if (ChunkSettings.IsEnabled())
+	{
+		// The members are in layout order
+		SplitIntoChunks(OutSnapshot.Indices, OutSnapshot.ChunkEnds);
+	}
+	OutSnapshot.Transforms.SetNumUninitialized(OutSnapshot.Indices.Num(), false);
+	for (int32 Pos = 0; Pos < OutSnapshot.Indices.Num(); ++Pos)
+	{
+		OutSnapshot.Transforms[Pos] = Transforms[OutSnapshot.Indices[Pos]];
+	}
+	return OutSnapshot.Num() > 0;
+}
+
+// Check the static nodes for motion and promote the moved ones back to dynamic
+bool FTFTree::UpdateStaticNodes(const float InWorldTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFUpdateStatic);
+	UpdateLayout();
+	UpdateStaticSelection();
+
+	const bool bCheckMotion = StaticIndices.Num() > 0 && InWorldTime >= NextStaticCheckTime;
+	if (!bCheckMotion && !bStaticNodesChanged)
+	{
+		return false;
+	}
+	NextStaticCheckTime = InWorldTime + StaticSettings.CheckInterval;
+	GatherTransforms(StaticIndices);
+
+	// Nodes which just became static have no sampled transform to compare with yet, check them next time
+	if (!bStaticNodesChanged)
+	{
+		for (const int32 Idx : StaticIndices)
+		{
+			if (!Transforms[Idx].Equals(StaticTransforms[Idx], StaticSettings.Tolerance))
+			{
+				UE_LOG(LogTF, Log, TEXT("%s::%d Static frame %s moved, publishing it as dynamic.."),
+					TEXT(__FUNCTION__), __LINE__, *LayoutNodes[Idx]->GetFrameId());
+				StaticFlags[Idx] = false;
+				UnchangedCounts[Idx] = 0;
+				StaticTransforms[Idx] = Transforms[Idx];
+				bStaticSelectionDirty = true;
+				bStaticNodesChanged = true;
+			}
+		}
+		if (!bStaticNodesChanged)
+		{
+			return false;
+		}
+		UpdateStaticSelection();
+	}
+
+	// Sample the transforms of the static nodes to publish
+	for (const int32 Idx : StaticIndices)
+	{
+		StaticTransforms[Idx] = Transforms[Idx];
+	}
+	bStaticNodesChanged = false;
+	return true;
+}
+
+// Copy the tf transforms of every dynamic node into the snapshot
+bool FTFTree::GetDynamicSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq)
+{
+	UpdateLayout();
+	UpdateStaticSelection();
+	GatherTransforms(DynamicIndices);
+	SCOPE_CYCLE_COUNTER(STAT_TFCopySnapshot);
+
+	OutSnapshot.Reset();
+	OutSnapshot.CaptureTime = FPlatformTime::Seconds();
+	OutSnapshot.Time = InTime;
+	OutSnapshot.Seq = InSeq;
+	OutSnapshot.bPartial = false;
+	OutSnapshot.Schema = FrameSchema;
+	OutSnapshot.Indices.Append(DynamicIndices);
+	OutSnapshot.Transforms.SetNumUninitialized(DynamicIndices.Num(), false);
+	for (int32 Pos = 0; Pos < DynamicIndices.Num(); ++Pos)
+	{
+		OutSnapshot.Transforms[Pos] = Transforms[DynamicIndices[Pos]];
+	}
+	return OutSnapshot.Num() > 0;
+}
+
+// Copy the tf transforms of the static nodes into the snapshot
+bool FTFTree::GetStaticSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFCopySnapshot);
+	INC_DWORD_STAT_BY(STAT_TFPublishedNodes, StaticIndices.Num());
+
+	OutSnapshot.Reset();
+	OutSnapshot.CaptureTime = FPlatformTime::Seconds();
+	OutSnapshot.Time = InTime;
+	OutSnapshot.Seq = InSeq;
+	OutSnapshot.bPartial = false;
+	OutSnapshot.Schema = FrameSchema;
+	OutSnapshot.Indices.Append(StaticIndices);
+	OutSnapshot.Transforms.SetNumUninitialized(StaticIndices.Num(), false);
+	for (int32 Pos = 0; Pos < StaticIndices.Num(); ++Pos)
+	{
+		OutSnapshot.Transforms[Pos] = StaticTransforms[StaticIndices[Pos]];
+	}
+	return OutSnapshot.Num() > 0;
+}
+
+// Select the nodes to publish and gather their transforms
+const TArray<int32>& FTFTree::SelectAndGather(const float InWorldTime, const FTFDeltaSettings* InDeltaSettings, const bool bInMultiRate)
+{
+	UpdateLayout();
+	UpdateStaticSelection();
+
+	const TArray<int32>* SelectedIndices = &DynamicIndices;
+	if (bInMultiRate)
+	{
+		// Collect the nodes of the due buckets
+		DueIndices.Reset();
+		for (auto& BucketItr : RateBuckets)
+		{
+			if (BucketItr.PublishRate > 0.f)
+			{
+				if (InWorldTime < BucketItr.NextPublishTime)
+				{
+					continue; // Bucket not due
+				}
+				// Schedule next publish, if the bucket fell behind restart from the current time
+				BucketItr.NextPublishTime += 1.f / BucketItr.PublishRate;
+				if (BucketItr.NextPublishTime < InWorldTime)
+				{
+					BucketItr.NextPublishTime = InWorldTime + 1.f / BucketItr.PublishRate;
+				}
+			}
+			DueIndices.Append(BucketItr.DynamicIndices);
+		}
+		GatherTransforms(DueIndices);
+		SelectedIndices = &DueIndices;
+	}
+	else if (StaticIndices.Num() > 0)
+	{
+		GatherTransforms(DynamicIndices);
+	}
+	else
+	{
+		GatherAllTransforms();
+	}
+
+	DetectInvariantNodes(*SelectedIndices);
+
+	if (InDeltaSettings)
+	{
+		SelectChanged(*SelectedIndices, *InDeltaSettings);
+		SelectedIndices = &ChangedIndices;
+	}
+	return *SelectedIndices;
+}
+
+// Create a new node, attach it to the object and to the parent node, and add it to the index
+FTFNode* FTFTree::CreateNode(const FString& InChildFrameId, UObject* InAttachedObject, FTFNode* InParentNode,
+	float InPublishRate, bool bInStatic)
+{
+	// Frame ids are unique in a tf tree
+	if (FrameIdToNode.Contains(InChildFrameId))
+	{
+		UE_LOG(LogTF, Warning, TEXT("%s::%d Frame id %s is already in the tree, %s will be ignored.."),
+			TEXT(__FUNCTION__), __LINE__, *InChildFrameId, *InAttachedObject->GetName());
+		return nullptr;
+	}
+
+	// Create new node in the arena
+	FTFNode* NewTFNode = NodeArena->Allocate();
+	NewTFNode->Init(InChildFrameId, InAttachedObject, InPublishRate, bInStatic);
+	InParentNode->AddChild(NewTFNode);
+
+	// Bind its lifetime to the object
+	if (NodeStorage == ETFNodeStorage::Component)
+	{
+		UTFNode* Anchor = NewObject<UTFNode>(InAttachedObject);
+		Anchor->RegisterComponent();
+		Anchor->Init(this, NewTFNode);
+	}
+	else
+	{
+		TrackActorNode(NewTFNode);
+	}
+
+	// Add to array and index
+	NewTFNode->SetTreeIndex(TFNodes.Emplace(NewTFNode));
+	FrameIdToNode.Emplace(InChildFrameId, NewTFNode);
+	MarkTopologyChanged();
+
+	// Nodes added earlier can now be moved to their parent
+	AttachPendingChildren(NewTFNode);
+	return NewTFNode;
+}
+
+// Create the build data of an object from its tag key value pairs
+FTFNodeBuildData FTFTree::MakeBuildData(UObject* InObject, const FName InObjectName, const TMap<FString, FString>& InTagData,
+	const FString& InRootFrameId)
+{
+	FTFNodeBuildData NodeData;
+	NodeData.Object = InObject;
+	NodeData.bRootChild = false;
+
+	// Set namespace from tag, the frame ids of a namespaced object are prefixed (ns/frame_id)
+	NodeData.Namespace = GetNamespace(InTagData);
+	const FString Prefix = NodeData.Namespace.IsEmpty() ? FString() : NodeData.Namespace + TEXT("/");
+
+	// Set child frame id from tag, default to the object name
+	const FString* ChildFrameId = InTagData.Find(TEXT("ChildFrameId"));
+	NodeData.ChildFrameId = Prefix + (ChildFrameId ? *ChildFrameId : InObjectName.ToString());
+
+	// Set parent frame id from tag, missing parent frame id defaults to the root,
+	// a leading slash marks a global frame id (e.g. /map) which is not prefixed
+	const FString* ParentFrameId = InTagData.Find(TEXT("ParentFrameId"));
+	if (ParentFrameId == nullptr)
+	{
+		NodeData.ParentFrameId = InRootFrameId;
+	}
+	else if (ParentFrameId->StartsWith(TEXT("/")))
+	{
+		NodeData.ParentFrameId = ParentFrameId->RightChop(1);
+	}
+	else
+	{
+		NodeData.ParentFrameId = Prefix + *ParentFrameId;
+	}
+
+	// Set publish rate (Hz) from tag, missing publish rate defaults to every publish
+	const FString* PublishRate = InTagData.Find(TEXT("PublishRate"));
+	NodeData.PublishRate = PublishRate ? FMath::Max(FCString::Atof(**PublishRate), 0.f) : 0.f;
+
+	// Set static flag from tag (e.g. Static,true), missing flag defaults to dynamic
+	const FString* Static = InTagData.Find(TEXT("Static"));
+	NodeData.bStatic = Static && FCString::ToBool(**Static);
+
+	return NodeData;
+}
+
+// Create the node of the build data (waits under the root if its parent is not in the tree)
+bool FTFTree::AddBuildData(const FTFNodeBuildData& InNodeData)
+{
+	UObject* Object = InNodeData.Object.Get();
+	if (Object == nullptr)
+	{
+		return false; // Destroyed while the build was running, its children wait for the frame
+	}
+	if (InNodeData.bRootChild)
+	{
+		return AddRootChildNode(InNodeData.ChildFrameId, Object, InNodeData.PublishRate, InNodeData.bStatic);
+	}
+	return AddNode(InNodeData.ChildFrameId, Object, InNodeData.ParentFrameId, true,
+		InNodeData.PublishRate, InNodeData.bStatic);
+}
+
+// Copy the raw tags of the TF tagged actors and scene components of the world
+uint64 FTFTree::GatherTaggedObjects(UWorld* InWorld, TArray<FTFTaggedObject>& OutTaggedObjects, const bool bInHash) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFTagScan);
+
+	// Objects are hashed with their path in their level, the topology also depends on the root and the namespace
+	uint32 Crc = FCrc::StrCrc32(*Root->GetFrameId());
+	Crc = FCrc::StrCrc32(bUseNamespaceFilter ? *NamespaceFilter : TEXT("*"), Crc);
+	FString TagString;
+	auto AddTaggedObject = [&](UObject* InObject, const TArray<FName>& InTags)
+	{
+		FTFTaggedObject& TaggedObject = OutTaggedObjects[OutTaggedObjects.AddDefaulted()];
+		TaggedObject.Object = InObject;
+		TaggedObject.Name = InObject->GetFName();
+		TaggedObject.Tags = InTags;
+		if (bInHash)
+		{
+			Crc = FCrc::StrCrc32(*InObject->GetPathName(InObject->GetTypedOuter<UWorld>()), Crc);
+			for (const auto& TagItr : InTags)
+			{
+				TagItr.ToString(TagString);
+				Crc = FCrc::StrCrc32(*TagString, Crc);
+			}
+		}
+	};
+
+	for (TActorIterator<AActor> ActorItr(InWorld); ActorItr; ++ActorItr)
+	{
+		if (FTags::GetTagTypeIndex(*ActorItr, TEXT("TF")) != INDEX_NONE)
+		{
+			AddTaggedObject(*ActorItr, ActorItr->Tags);
+		}
+		TInlineComponentArray<USceneComponent*> Components(*ActorItr);
+		for (USceneComponent* ComponentItr : Components)
+		{
+			if (FTags::GetTagTypeIndex(ComponentItr, TEXT("TF")) != INDEX_NONE)
+			{
+				AddTaggedObject(ComponentItr, ComponentItr->ComponentTags);
+			}
+		}
+	}
+	return bInHash ? (static_cast<uint64>(OutTaggedObjects.Num()) << 32) | Crc : 0;
+}
+
+// Parse the tags of the objects and resolve their creation order
+void FTFTree::ResolveTaggedObjects(const TArray<FTFTaggedObject>& InTaggedObjects, const FString& InRootFrameId,
+	const bool bInUseNamespaceFilter, const FString& InNamespaceFilter, TArray<FTFNodeBuildData>& OutBuildOrder)
+{
+	// Group the objects of the tree namespace by their parent frame id
+	TMap<FString, TArray<FTFNodeBuildData>> ParentFrameIdToChildren;
+	for (const auto& TaggedItr : InTaggedObjects)
+	{
+		const TMap<FString, FString> TagData = FTags::GetKeyValuePairs(TaggedItr.Tags, TEXT("TF"));
+		if (!IsInNamespace(TagData, bInUseNamespaceFilter, InNamespaceFilter))
+		{
+			continue; // Published by the tree of its namespace
+		}
+		FTFNodeBuildData NodeData = MakeBuildData(nullptr, TaggedItr.Name, TagData, InRootFrameId);
+		NodeData.Object = TaggedItr.Object;
+		ParentFrameIdToChildren.FindOrAdd(NodeData.ParentFrameId).Emplace(MoveTemp(NodeData));
+	}
+
+	ResolveBuildOrder(InRootFrameId, ParentFrameIdToChildren, OutBuildOrder);
+}
+
+// Resolve the creation order of the asynchronous build if not loaded from the cache (worker thread)
+void FTFTree::ResolveAsyncBuild(FTFAsyncBuild& OutAsyncBuild)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFBuildResolve);
+
+	if (OutAsyncBuild.TaggedObjects.Num() > 0)
+	{
+		ResolveTaggedObjects(OutAsyncBuild.TaggedObjects, OutAsyncBuild.RootFrameId,
+			OutAsyncBuild.bUseNamespaceFilter, OutAsyncBuild.NamespaceFilter, OutAsyncBuild.BuildOrder);
+		OutAsyncBuild.TaggedObjects.Empty();
+	}
+
+	// Nodes waiting for these frames are left out of the layout until they are created
+	OutAsyncBuild.QueuedFrameIds.Reserve(OutAsyncBuild.BuildOrder.Num());
+	for (const auto& NodeDataItr : OutAsyncBuild.BuildOrder)
+	{
+		OutAsyncBuild.QueuedFrameIds.Emplace(NodeDataItr.ChildFrameId);
+	}
+}
+
+// Register the node as waiting for the parent frame id
+void FTFTree::AddPendingChild(FTFNode* InNode, const FString& InParentFrameId)
+{
+	PendingChildren.FindOrAdd(InParentFrameId).Emplace(InNode);
+	InNode->SetPendingParentFrameId(InParentFrameId);
+}
+
+// Remove the node from the nodes waiting for a parent
+void FTFTree::RemovePendingChild(FTFNode* InNode)
+{
+	if (InNode->GetPendingParentFrameId().IsEmpty())
+	{
+		return;
+	}
+	if (TArray<FTFNode*>* Pending = PendingChildren.Find(InNode->GetPendingParentFrameId()))
+	{
+		Pending->RemoveSingleSwap(InNode, false);
+		if (Pending->Num() == 0)
+		{
+			PendingChildren.Remove(InNode->GetPendingParentFrameId());
+		}
+	}
+	InNode->SetPendingParentFrameId(FString());
+}
+
+// Move the nodes waiting for the frame id of the new node below it
+void FTFTree::AttachPendingChildren(FTFNode* InParentNode)
+{
+	if (PendingChildren.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<FTFNode*> Pending;
+	if (!PendingChildren.RemoveAndCopyValue(InParentNode->GetFrameId(), Pending))
+	{
+		return;
+	}
+
+	for (const auto& NodeItr : Pending)
+	{
+		NodeItr->SetPendingParentFrameId(FString());
+
+		// The new parent must not be part of the subtree of the waiting node (cycle)
+		bool bCycle = false;
+		for (const FTFNode* AncestorItr = InParentNode; AncestorItr != nullptr; AncestorItr = AncestorItr->GetParent())
+		{
+			if (AncestorItr == NodeItr)
+			{
+				bCycle = true;
+				break;
+			}
+		}
+		if (bCycle)
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d Attaching %s to %s would create a cycle, it stays a root child.."),
+				TEXT(__FUNCTION__), __LINE__, *NodeItr->GetFrameId(), *InParentNode->GetFrameId());
+			continue;
+		}
+		NodeItr->AttachTo(InParentNode);
+	}
+	MarkTopologyChanged();
+}
+
+// Group the tagged objects by their parent frame id (nodes without parent frame id are grouped under the root)
+void FTFTree::GroupByParentFrameId(const TMap<UObject*, TMap<FString, FString>>& InObjectsToTagData,
+	TMap<FString, TArray<FTFNodeBuildData>>& OutParentFrameIdToChildren) const
+{
+	for (const auto& MapItr : InObjectsToTagData)
+	{
+		if (!IsInNamespace(MapItr.Value))
+		{
+			continue; // Published by the tree of its namespace
+		}
+		FTFNodeBuildData NodeData = MakeBuildData(MapItr.Key, MapItr.Key->GetFName(), MapItr.Value, Root->GetFrameId());
+		OutParentFrameIdToChildren.FindOrAdd(NodeData.ParentFrameId).Emplace(MoveTemp(NodeData));
+	}
+}
+
+// Resolve the creation order of the grouped objects, parents before their children
+void FTFTree::ResolveBuildOrder(const FString& InRootFrameId, TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+	TArray<FTFNodeBuildData>& OutBuildOrder)
+{
+	// Every node reachable from the root in a single breadth first pass
+	AppendChildrenBreadthFirst(InRootFrameId, ParentFrameIdToChildren, OutBuildOrder);
+
+	// The remaining orphan nodes and cycles as new root trees
+	AppendOrphanNodes(ParentFrameIdToChildren, OutBuildOrder);
+}
+
+// Append the waiting children of the given frame, and recursively theirs, in breadth first order
+void FTFTree::AppendChildrenBreadthFirst(const FString& InFrameId, TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+	TArray<FTFNodeBuildData>& OutBuildOrder)
+{
+	TArray<FString> FrameQueue;
+	FrameQueue.Emplace(InFrameId);
+
+	for (int32 QueueIdx = 0; QueueIdx < FrameQueue.Num(); ++QueueIdx)
+	{
+		TArray<FTFNodeBuildData> Children;
+		if (!ParentFrameIdToChildren.RemoveAndCopyValue(FrameQueue[QueueIdx], Children))
+		{
+			continue; // Leaf
+		}
+
+		for (auto& ChildItr : Children)
+		{
+			// Duplicate frame ids are ignored when created, their children will be attached to the existing node
+			FrameQueue.Emplace(ChildItr.ChildFrameId);
+			OutBuildOrder.Emplace(MoveTemp(ChildItr));
+		}
+	}
+}
+
+// Append the orphan nodes (and the nodes forming cycles) as new root trees, their subtrees are kept
+void FTFTree::AppendOrphanNodes(TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+	TArray<FTFNodeBuildData>& OutBuildOrder)
+{
+	if (ParentFrameIdToChildren.Num() == 0)
+	{
+		return;
+	}
+
+	// Frame ids of all objects still waiting for a parent
+	TSet<FString> WaitingFrameIds;
+	for (const auto& GroupItr : ParentFrameIdToChildren)
+	{
+		for (const auto& ChildItr : GroupItr.Value)
+		{
+			WaitingFrameIds.Emplace(ChildItr.ChildFrameId);
+		}
+	}
+
+	// Groups whose parent frame id is not waiting itself have a missing parent (orphans)
+	TArray<FString> MissingParentFrameIds;
+	for (const auto& GroupItr : ParentFrameIdToChildren)
+	{
+		if (!WaitingFrameIds.Contains(GroupItr.Key))
+		{
+			MissingParentFrameIds.Emplace(GroupItr.Key);
+		}
+	}
+
+	for (const auto& MissingParentFrameId : MissingParentFrameIds)
+	{
+		TArray<FTFNodeBuildData> Orphans;
+		ParentFrameIdToChildren.RemoveAndCopyValue(MissingParentFrameId, Orphans);
+		for (auto& OrphanItr : Orphans)
+		{
+			UE_LOG(LogTF, Warning, TEXT("%s::%d Parent frame id %s of %s not found, adding it as a root child.."),
+				TEXT(__FUNCTION__), __LINE__, *MissingParentFrameId, *OrphanItr.ChildFrameId);
+			// The orphan waits under the root, it is moved to its parent if the parent is added later
+			const FString OrphanFrameId = OrphanItr.ChildFrameId;
+			OutBuildOrder.Emplace(MoveTemp(OrphanItr));
+			AppendChildrenBreadthFirst(OrphanFrameId, ParentFrameIdToChildren, OutBuildOrder);
+		}
+	}
+
+	// Every group left has its parent waiting as well, the nodes are part of cycles,
+	// break each cycle by adding one of its nodes as a root child
+	while (ParentFrameIdToChildren.Num() > 0)
+	{
+		auto GroupItr = ParentFrameIdToChildren.CreateIterator();
+		const FString ParentFrameId = GroupItr.Key();
+		FTFNodeBuildData CycleNode = GroupItr.Value().Pop();
+		if (GroupItr.Value().Num() == 0)
+		{
+			GroupItr.RemoveCurrent();
+		}
+
+		UE_LOG(LogTF, Warning, TEXT("%s::%d Cycle detected between %s and its parent %s, adding it as a root child.."),
+			TEXT(__FUNCTION__), __LINE__, *CycleNode.ChildFrameId, *ParentFrameId);
+		const FString CycleFrameId = CycleNode.ChildFrameId;
+		CycleNode.bRootChild = true;
+		OutBuildOrder.Emplace(MoveTemp(CycleNode));
+		AppendChildrenBreadthFirst(CycleFrameId, ParentFrameIdToChildren, OutBuildOrder);
+	}
+}
+
+// Rebuild the flattened layout and the rate buckets if the topology changed
+void FTFTree::UpdateLayout()
+{
+	// Remove the nodes of the components destroyed since the last frame (arena storage)
+	if (NodeListener && SweepFrame != GFrameCounter)
+	{
+		SweepFrame = GFrameCounter;
+		RemoveGoneNodes();
+	}
+
+	if (!bLayoutDirty || Root == nullptr)
+	{
+		return;
+	}
+	bLayoutDirty = false;
+	SCOPE_CYCLE_COUNTER(STAT_TFUpdateLayout);
+
+	// Keep the previous layout to carry over the last published transforms and the static classification
+	const TArray<FTFNode*> PrevLayoutNodes = MoveTemp(LayoutNodes);
+	const TArray<FTransform> PrevLastPublishedTransforms = MoveTemp(LastPublishedTransforms);
+	const TBitArray<> PrevPublishedFlags = MoveTemp(PublishedFlags);
+	const TBitArray<> PrevStaticFlags = MoveTemp(StaticFlags);
+	const TArray<FTransform> PrevStaticTransforms = MoveTemp(StaticTransforms);
+	const TArray<int32> PrevUnchangedCounts = MoveTemp(UnchangedCounts);
+
+	const int32 NumNodes = TFNodes.Num();
+	LayoutNodes.Reset(NumNodes);
+	ParentIndices.Reset(NumNodes);
+	Sources.Reset(NumNodes);
+	SubtreeIds.Reset(NumNodes);
+	LastPublishedTransforms.Reset(NumNodes);
+	PublishedFlags.Init(false, NumNodes);
+	StaticFlags.Empty(NumNodes);
+	StaticTransforms.Reset(NumNodes);
+	UnchangedCounts.Reset(NumNodes);
+	AllIndices.Reset(NumNodes);
+
+	// Clear the bucket indices, keep the buckets schedule
+	for (auto& BucketItr : RateBuckets)
+	{
+		BucketItr.Indices.Reset();
+	}
+
+	// Depth first traversal, the index of the parent is always set before its children are visited
+	TArray<FTFNode*> Stack;
+	Stack.Push(Root);
+	while (Stack.Num() > 0)
+	{
+		FTFNode* CurrNode = Stack.Pop(false);
+
+		// Nodes waiting for a parent of the running build are added once their ancestors are created
+		if (IsWaitingForBuild(CurrNode))
+		{
+			CurrNode->SetLayoutIndex(INDEX_NONE);
+			continue;
+		}
+
+		// A blank root has no transform to publish
+		if (CurrNode != Root || !CurrNode->IsBlank())
+		{
+			const int32 Idx = LayoutNodes.Emplace(CurrNode);
+			const FTFNode* ParentNode = CurrNode->GetParent();
+			ParentIndices.Emplace(ParentNode && !ParentNode->IsBlank() ? ParentNode->GetLayoutIndex() : INDEX_NONE);
+			Sources.Emplace(CurrNode->GetTransformSource());
+			SubtreeIds.Emplace(CurrNode == Root || ParentNode == Root ? Idx : SubtreeIds[ParentIndices[Idx]]);
+			AllIndices.Emplace(Idx);
+
+			// Carry over the last published transform
+			const int32 PrevIdx = CurrNode->GetLayoutIndex();
+			const bool bInPrevLayout = PrevLayoutNodes.IsValidIndex(PrevIdx) && PrevLayoutNodes[PrevIdx] == CurrNode;
+			if (bInPrevLayout && PrevPublishedFlags[PrevIdx])
+			{
+				LastPublishedTransforms.Emplace(PrevLastPublishedTransforms[PrevIdx]);
+				PublishedFlags[Idx] = true;
+			}
+			else
+			{
+				LastPublishedTransforms.Emplace(FTransform::Identity);
+			}
+
+			// Carry over the static classification, new nodes are classified from their tag and mobility
+			if (bInPrevLayout)
+			{
+				StaticFlags.Add(PrevStaticFlags[PrevIdx]);
+				StaticTransforms.Emplace(PrevStaticTransforms[PrevIdx]);
+				UnchangedCounts.Emplace(PrevUnchangedCounts[PrevIdx]);
+			}
+			else
+			{
+				const bool bStatic = IsInitiallyStatic(Idx);
+				StaticFlags.Add(bStatic);
+				StaticTransforms.Emplace(FTransform::Identity);
+				UnchangedCounts.Emplace(0);
+				bStaticNodesChanged |= bStatic;
+			}
+			CurrNode->SetLayoutIndex(Idx);
+
+			// Add to the bucket of its publish rate (new buckets are due right away)
+			FTFRateBucket* Bucket = RateBuckets.FindByPredicate([CurrNode](const FTFRateBucket& InBucket)
+			{
+				return InBucket.PublishRate == CurrNode->GetPublishRate();
+			});
+			if (Bucket == nullptr)
+			{
+				Bucket = &RateBuckets[RateBuckets.AddDefaulted()];
+				Bucket->PublishRate = CurrNode->GetPublishRate();
+				Bucket->NextPublishTime = 0.f;
+			}
+			Bucket->Indices.Emplace(Idx);
+		}
+
+		// Push children in reverse to keep their order in the layout
+		const TArray<FTFNode*>& Children = CurrNode->GetChildren();
+		for (int32 ChildIdx = Children.Num() - 1; ChildIdx >= 0; --ChildIdx)
+		{
+			Stack.Push(Children[ChildIdx]);
+		}
+	}
+
+	// Remove the buckets which lost all their nodes
+	RateBuckets.RemoveAll([](const FTFRateBucket& InBucket) { return InBucket.Indices.Num() == 0; });
+
+	const int32 NumLayoutNodes = LayoutNodes.Num();
+
+	// New frame ids schema with the interned ids, snapshots of the previous layout keep theirs
+	TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe> NewFrameSchema = MakeShareable(new FTFFrameSchema());
+	NewFrameSchema->FrameIds.Reserve(NumLayoutNodes);
+	NewFrameSchema->ParentFrameIds.Reserve(NumLayoutNodes);
+	NewFrameSchema->Utf8FrameIds.Reserve(NumLayoutNodes);
+	NewFrameSchema->Utf8ParentFrameIds.Reserve(NumLayoutNodes);
+	TMap<FString, FTFInternedId> InternedIdsMap;
+	for (const auto& NodeItr : LayoutNodes)
+	{
+		NewFrameSchema->AddFrame(NodeItr->GetFrameId(),
+			NodeItr->GetParent() ? NodeItr->GetParent()->GetFrameId() : TEXT("None"), InternedIdsMap);
+	}
+	FrameSchema = NewFrameSchema;
+
+	// Prebuilt headers and transform messages with their frame ids, only the stamps and transforms change on publish
+	HeaderPool.SetNum(NumLayoutNodes);
+	StampedMsgPool.SetNum(NumLayoutNodes);
+	for (int32 Idx = 0; Idx < NumLayoutNodes; ++Idx)
+	{
+		HeaderPool[Idx].SetFrameId(FrameSchema->ParentFrameIds[Idx]);
+		StampedMsgPool[Idx].SetChildFrameId(FrameSchema->FrameIds[Idx]);
+	}
+
+	WorldTransforms.SetNum(NumLayoutNodes);
+	WorldTransformStamps.Init(GatherStamp, NumLayoutNodes);
+	Transforms.SetNum(NumLayoutNodes);
+	ResolveChannels();
+	bStaticSelectionDirty = true;
+	SET_DWORD_STAT(STAT_TFNodes, NumLayoutNodes);
+}
+
+// Rebuild the dynamic and static index lists if the static nodes changed
+void FTFTree::UpdateStaticSelection()
+{
+	if (!bStaticSelectionDirty)
+	{
+		return;
+	}
+	bStaticSelectionDirty = false;
+
+	DynamicIndices.Reset();
+	StaticIndices.Reset();
+	for (const int32 Idx : AllIndices)
+	{
+		if (StaticFlags[Idx])
+		{
+			StaticIndices.Emplace(Idx);
+		}
+		else
+		{
+			DynamicIndices.Emplace(Idx);
+		}
+	}
+
+	for (auto& BucketItr : RateBuckets)
+	{
+		BucketItr.DynamicIndices.Reset();
+		for (const int32 Idx : BucketItr.Indices)
+		{
+			if (!StaticFlags[Idx])
+			{
+				BucketItr.DynamicIndices.Emplace(Idx);
+			}
+		}
+	}
+
+	for (auto& ChannelItr : Channels)
+	{
+		ChannelItr.DynamicIndices.Reset();
+		for (const int32 Idx : ChannelItr.Indices)
+		{
+			if (!StaticFlags[Idx])
+			{
+				ChannelItr.DynamicIndices.Emplace(Idx);
+			}
+		}
+	}
+}
+
+// Resolve the members of the channels in the current layout
+void FTFTree::ResolveChannels()
+{
+	if (Channels.Num() == 0)
+	{
+		return;
+	}
+
+	// Depth of every node, the subtree of a node is the range of the following deeper nodes (depth first layout)
+	const int32 NumLayoutNodes = LayoutNodes.Num();
+	TArray<int32> Depths;
+	Depths.SetNumUninitialized(NumLayoutNodes);
+	for (int32 Idx = 0; Idx < NumLayoutNodes; ++Idx)
+	{
+		Depths[Idx] = ParentIndices[Idx] == INDEX_NONE ? 0 : Depths[ParentIndices[Idx]] + 1;
+	}
+
+	for (auto& ChannelItr : Channels)
+	{
+		ChannelItr.Indices.Reset();
+
+		// [Start, End) layout range of the subtree
+		int32 Start = 0;
+		int32 End = NumLayoutNodes;
+		if (!ChannelItr.SubtreeRootFrameId.IsEmpty())
+		{
+			const FTFNode* SubtreeRoot = FindNode(ChannelItr.SubtreeRootFrameId);
+			if (SubtreeRoot == nullptr)
+			{
+				if (!IsBuilding())
+				{
+					UE_LOG(LogTF, Warning, TEXT("%s::%d Subtree root frame %s of the channel %s is not in the tree (yet).."),
+						TEXT(__FUNCTION__), __LINE__, *ChannelItr.SubtreeRootFrameId, *ChannelItr.Topic);
+				}
+				continue;
+			}
+			// A blank root is not in the layout, its subtree is the whole layout
+			if (SubtreeRoot != Root || !Root->IsBlank())
+			{
+				Start = SubtreeRoot->GetLayoutIndex();
+				if (Start == INDEX_NONE)
+				{
+					continue; // Waiting for its parent
+				}
+				End = Start + 1;
+				while (End < NumLayoutNodes && Depths[End] > Depths[Start])
+				{
+					++End;
+				}
+			}
+		}
+
+		for (int32 Idx = Start; Idx < End; ++Idx)
+		{
+			if (ChannelItr.FramePattern.IsEmpty() || FrameSchema->FrameIds[Idx].MatchesWildcard(ChannelItr.FramePattern))
+			{
+				ChannelItr.Indices.Emplace(Idx);
+			}
+		}
+	}
+}
+
+// Check if the node should start as static (Static tag, or static mobility of itself and its parent)
+bool FTFTree::IsInitiallyStatic(const int32 InIndex) const
+{
+	if (!StaticSettings.bEnabled)
+	{
+		return false;
+	}
+	if (LayoutNodes[InIndex]->IsMarkedStatic())
+	{
+		return true;
+	}
+
+	// A static component keeps its tf transform only if its parent frame does not move either
+	const USceneComponent* Source = Sources[InIndex];
+	if (Source == nullptr || Source->Mobility != EComponentMobility::Static)
+	{
+		return false;
+	}
+	// A parent without source (actor without root component) is left to the invariance detection
+	const int32 ParentIdx = ParentIndices[InIndex];
+	if (ParentIdx == INDEX_NONE)
+	{
+		return true;
+	}
+	const USceneComponent* ParentSource = Sources[ParentIdx];
+	return ParentSource != nullptr && ParentSource->Mobility == EComponentMobility::Static;
+}
+
+// Count the unchanged publishes of the given dynamic nodes, and classify the invariant ones as static
+void FTFTree::DetectInvariantNodes(const TArray<int32>& InIndices)
+{
+	if (!StaticSettings.bEnabled || StaticSettings.InvarianceSamples <= 0)
+	{
+		return;
+	}
+
+	for (const int32 Idx : InIndices)
+	{
+		if (Transforms[Idx].Equals(StaticTransforms[Idx], StaticSettings.Tolerance))
+		{
+			if (++UnchangedCounts[Idx] >= StaticSettings.InvarianceSamples)
+			{
+				StaticFlags[Idx] = true;
+				bStaticSelectionDirty = true;
+				bStaticNodesChanged = true;
+			}
+		}
+		else
+		{
+			UnchangedCounts[Idx] = 0;
+			StaticTransforms[Idx] = Transforms[Idx];
+		}
+	}
+}
+
+// Split the nodes (in layout order) into chunks within the limits, keeping the subtrees together if they fit
+void FTFTree::SplitIntoChunks(const TArray<int32>& InSortedIndices, TArray<int32>& OutChunkEnds) const
+{
+	// Approximate encoded size (bytes) of a transform without its frame ids (json and BSON are similar)
+	static const int32 TransformSizeEstimate = 300;
+
+	const int32 MaxTransforms = ChunkSettings.MaxTransforms > 0 ? ChunkSettings.MaxTransforms : MAX_int32;
+	const int32 MaxBytes = ChunkSettings.MaxBytes > 0 ? ChunkSettings.MaxBytes : MAX_int32;
+	auto EstimateSize = [this](const int32 InIdx)
+	{
+		return TransformSizeEstimate + FrameSchema->Utf8FrameIds[InIdx].Length + FrameSchema->Utf8ParentFrameIds[InIdx].Length;
+	};
+
+	OutChunkEnds.Reset();
+	int32 ChunkStart = 0;
+	int64 ChunkBytes = 0;
+	int32 Pos = 0;
+	while (Pos < InSortedIndices.Num())
+	{
+		// Extent and size of the selected nodes of the current subtree
+		const int32 SubtreeId = SubtreeIds[InSortedIndices[Pos]];
+		int32 SubtreeEnd = Pos;
+		int64 SubtreeBytes = 0;
+		while (SubtreeEnd < InSortedIndices.Num() && SubtreeIds[InSortedIndices[SubtreeEnd]] == SubtreeId)
+		{
+			SubtreeBytes += EstimateSize(InSortedIndices[SubtreeEnd]);
+			++SubtreeEnd;
+		}
+
+		// Start a new chunk if the subtree does not fit in the current one
+		if (Pos > ChunkStart && (SubtreeEnd - ChunkStart > MaxTransforms || ChunkBytes + SubtreeBytes > MaxBytes))
+		{
+			OutChunkEnds.Emplace(Pos);
+			ChunkStart = Pos;
+			ChunkBytes = 0;
+		}
+
+		// Subtrees larger than a chunk are split
+		for (; Pos < SubtreeEnd; ++Pos)
+		{
+			const int32 Bytes = EstimateSize(InSortedIndices[Pos]);
+			if (Pos > ChunkStart && (Pos - ChunkStart >= MaxTransforms || ChunkBytes + Bytes > MaxBytes))
+			{
+				OutChunkEnds.Emplace(Pos);
+				ChunkStart = Pos;
+				ChunkBytes = 0;
+			}
+			ChunkBytes += Bytes;
+		}
+	}
+	if (InSortedIndices.Num() > 0)
+	{
+		OutChunkEnds.Emplace(InSortedIndices.Num());
+	}
+}
+
+// Record the current tf transforms of all nodes into their time buffers
+void FTFTree::RecordTransforms(const float InWorldTime)
+{
+	if (BufferCapacity == 0)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFRecordTransforms);
+
+	UpdateLayout();
+	GatherAllTransforms();
+	// Every node owns its buffer, the chunks can write them independently
+	ForEachChunk(LayoutNodes.Num(), [this, InWorldTime](int32 Start, int32 End)
+	{
+		for (int32 Idx = Start; Idx < End; ++Idx)
+		{
+			FTFBuffer& Buffer = LayoutNodes[Idx]->GetTransformBuffer();
+			Buffer.SetCapacity(BufferCapacity);
+			Buffer.Add(InWorldTime, Transforms[Idx]);
+		}
+	});
+}
+
+// Get the transform of the source frame relative to the target frame at the given world time
+bool FTFTree::LookupTransform(const FString& InTargetFrameId, const FString& InSourceFrameId, const float InWorldTime,
+	FTransform& OutTransform)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFLookupTransform);
+	const FTFLookupPath* Path = FindLookupPath(InTargetFrameId, InSourceFrameId);
+	if (Path == nullptr)
+	{
+		return false;
+	}
+
+	// Both frames relative to their common ancestor
+	FTransform SourceTransform;
+	FTransform TargetTransform;
+	if (!ComposeChain(Path->SourceChain, InWorldTime, SourceTransform) ||
+		!ComposeChain(Path->TargetChain, InWorldTime, TargetTransform))
+	{
+		return false;
+	}
+	OutTransform = SourceTransform.GetRelativeTransform(TargetTransform);
+	return true;
+}
+
+// Read the world transforms of all nodes, then compute their tf transforms in one linear pass
+void FTFTree::GatherAllTransforms()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFGather);
+	++GatherStamp;
+	ForEachChunk(LayoutNodes.Num(), [this](int32 Start, int32 End)
+	{
+		for (int32 Idx = Start; Idx < End; ++Idx)
+		{
+			WorldTransformStamps[Idx] = GatherStamp;
+			WorldTransforms[Idx] = Sources[Idx] ? Sources[Idx]->GetComponentTransform() : FTransform::Identity;
+		}
+	});
+	ForEachChunk(LayoutNodes.Num(), [this](int32 Start, int32 End)
+	{
+		for (int32 Idx = Start; Idx < End; ++Idx)
+		{
+			const int32 ParentIdx = ParentIndices[Idx];
+			Transforms[Idx] = ParentIdx == INDEX_NONE ? WorldTransforms[Idx] :
+				WorldTransforms[Idx].GetRelativeTransform(WorldTransforms[ParentIdx]);
+		}
+	});
+}
+
+// Read the world transforms of the given nodes and their parents (once each), then compute their tf transforms
+void FTFTree::GatherTransforms(const TArray<int32>& InIndices)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFGather);
+	++GatherStamp;
+	// The indices are unique, their world transforms can be read by the chunks independently
+	ForEachChunk(InIndices.Num(), [this, &InIndices](int32 Start, int32 End)
+	{
+		for (int32 Pos = Start; Pos < End; ++Pos)
+		{
+			ReadWorldTransform(InIndices[Pos]);
+		}
+	});
+	// Parents are shared between the nodes, read the missing ones serially
+	for (const int32 Idx : InIndices)
+	{
+		if (ParentIndices[Idx] != INDEX_NONE)
+		{
+			ReadWorldTransform(ParentIndices[Idx]);
+		}
+	}
+	ForEachChunk(InIndices.Num(), [this, &InIndices](int32 Start, int32 End)
+	{
+		for (int32 Pos = Start; Pos < End; ++Pos)
+		{
+			const int32 Idx = InIndices[Pos];
+			const int32 ParentIdx = ParentIndices[Idx];
+			Transforms[Idx] = ParentIdx == INDEX_NONE ? WorldTransforms[Idx] :
+				WorldTransforms[Idx].GetRelativeTransform(WorldTransforms[ParentIdx]);
+		}
+	});
+}
+
+// Run the body over the chunks of the given number of items, in parallel if enabled and there are enough items
+void FTFTree::ForEachChunk(const int32 InNum, TFunctionRef<void(int32, int32)> Body) const
+{
+	if (!ParallelSettings.bEnabled || InNum < ParallelSettings.MinNodes || InNum <= ParallelSettings.ChunkSize)
+	{
+		Body(0, InNum);
+		return;
+	}
+
+	const int32 ChunkSize = FMath::Max(ParallelSettings.ChunkSize, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(InNum, ChunkSize);
+	ParallelFor(NumChunks, [&Body, InNum, ChunkSize](int32 ChunkIdx)
+	{
+		const int32 Start = ChunkIdx * ChunkSize;
+		Body(Start, FMath::Min(Start + ChunkSize, InNum));
+	});
+}
+
+// Add the gathered transforms of the given nodes to the message, in the order of the indices
+void FTFTree::AddTransforms(const TArray<int32>& InIndices, const FROSTime& InTime, const uint32 InSeq,
+	TSharedPtr<tf2_msgs::TFMessage>& OutTFMsgPtr)
+{
+	if (InIndices.Num() == 0)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_TFBuildMessages);
+	INC_DWORD_STAT_BY(STAT_TFPublishedNodes, InIndices.Num());
+
+	// Update the stamps and transforms of the pooled messages of the nodes (in parallel if enabled), the frame ids
+	// are already set, the messages are then added in the order of the indices, keeping the message deterministic
+	ForEachChunk(InIndices.Num(), [this, &InIndices, &InTime, InSeq](int32 Start, int32 End)
+	{
+		for (int32 Pos = Start; Pos < End; ++Pos)
+		{
+			const int32 Idx = InIndices[Pos];
+			std_msgs::Header& Header = HeaderPool[Idx];
+			Header.SetSeq(InSeq);
+			Header.SetStamp(InTime);
+
+			// Transform to ROS coordinate system
+			const FTransform ROSTransf = FConversions::UToROS(Transforms[Idx]);
+
+			geometry_msgs::TransformStamped& StampedMsg = StampedMsgPool[Idx];
+			StampedMsg.SetHeader(Header);
+			StampedMsg.SetTransform(geometry_msgs::Transform(
+				geometry_msgs::Vector3(ROSTransf.GetLocation()),
+				geometry_msgs::Quaternion(ROSTransf.GetRotation())));
+		}
+	});
+
+	if (!OutTFMsgPtr.IsValid())
+	{
+		OutTFMsgPtr = MakeShareable(new tf2_msgs::TFMessage());
+	}
+	for (const int32 Idx : InIndices)
+	{
+		OutTFMsgPtr->AddTransform(StampedMsgPool[Idx]);
+	}
+}
+
+// Select the nodes which moved more than the thresholds since their last publish, and remember their transforms
+void FTFTree::SelectChanged(const TArray<int32>& InIndices, const FTFDeltaSettings& InDeltaSettings)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TFSelectChanged);
+	const float TranslationEpsilonSquared = FMath::Square(InDeltaSettings.TranslationEpsilon);
+
+	// Flag the changed nodes (in parallel if enabled), nodes which were never published are always added
+	ChangedFlags.SetNumUninitialized(InIndices.Num(), false);
+	ForEachChunk(InIndices.Num(), [&](int32 Start, int32 End)
+	{
+		for (int32 Pos = Start; Pos < End; ++Pos)
+		{
+			const int32 Idx = InIndices[Pos];
+			const FTransform& CurrTransform = Transforms[Idx];
+			const FTransform& LastTransform = LastPublishedTransforms[Idx];
+
+			const bool bChanged = InDeltaSettings.bKeyframe || !PublishedFlags[Idx] ||
+				FVector::DistSquared(CurrTransform.GetLocation(), LastTransform.GetLocation()) > TranslationEpsilonSquared ||
+				CurrTransform.GetRotation().AngularDistance(LastTransform.GetRotation()) > InDeltaSettings.RotationEpsilon;
+			ChangedFlags[Pos] = bChanged ? 1 : 0;
+		}
+	});
+
+	// Keep the changed nodes in order, and remember their published transforms
+	ChangedIndices.Reset();
+	for (int32 Pos = 0; Pos < InIndices.Num(); ++Pos)
+	{
+		if (ChangedFlags[Pos])
+		{
+			const int32 Idx = InIndices[Pos];
+			ChangedIndices.Emplace(Idx);
+			LastPublishedTransforms[Idx] = Transforms[Idx];
+			PublishedFlags[Idx] = true;
+		}
+	}
+}
+
+// Get the cached path between the frames, it is created on the first lookup
+const FTFLookupPath* FTFTree::FindLookupPath(const FString& InTargetFrameId, const FString& InSourceFrameId)
+{
+	if (const TMap<FString, FTFLookupPath>* SourceToPath = LookupPaths.Find(InTargetFrameId))
+	{
+		if (const FTFLookupPath* Path = SourceToPath->Find(InSourceFrameId))
+		{
+			return Path;
+		}
+	}
+
+	FTFNode* TargetNode = FindNode(InTargetFrameId);
+	FTFNode* SourceNode = FindNode(InSourceFrameId);
+	if (TargetNode == nullptr || SourceNode == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Walk up from the source, the first ancestor of the target on its way is the lowest common ancestor
+	TArray<FTFNode*> SourceAncestors;
+	for (FTFNode* NodeItr = SourceNode; NodeItr != nullptr; NodeItr = NodeItr->GetParent())
+	{
+		SourceAncestors.Emplace(NodeItr);
+	}
+
+	FTFLookupPath NewPath;
+	FTFNode* CommonAncestor = TargetNode;
+	int32 SourceDepth = SourceAncestors.Find(CommonAncestor);
+	while (SourceDepth == INDEX_NONE && CommonAncestor != nullptr)
+	{
+		NewPath.TargetChain.Emplace(CommonAncestor);
+		CommonAncestor = CommonAncestor->GetParent();
+		SourceDepth = SourceAncestors.Find(CommonAncestor);
+	}
+	if (CommonAncestor == nullptr)
+	{
+		return nullptr; // Not in the same tree
+	}
+	NewPath.SourceChain.Append(SourceAncestors.GetData(), SourceDepth);
+
+	return &LookupPaths.FindOrAdd(InTargetFrameId).Emplace(InSourceFrameId, MoveTemp(NewPath));
+}
+
+// Compose the buffered tf transforms of the chain, children first
+bool FTFTree::ComposeChain(const TArray<FTFNode*>& InChain, const float InWorldTime, FTransform& OutTransform) const
+{
+	OutTransform = FTransform::Identity;
+	for (const FTFNode* NodeItr : InChain)
+	{
+		FTransform NodeTransform;
+		if (!NodeItr->GetTransformBuffer().Lookup(InWorldTime, NodeTransform))
+		{
+			return false;
+		}
+		OutTransform = OutTransform * NodeTransform;
+	}
+	return true;
+}
+
+// Track the node with the nodes of its actor (arena storage)
+void FTFTree::TrackActorNode(FTFNode* InNode)
+{
+	AActor* Actor = InNode->GetAttachedActor();
+	if (Actor == nullptr)
+	{
+		return; // Component without owner, only detected as gone
+	}
+	TArray<FTFNode*>* Nodes = ActorNodes.Find(InNode->GetAttachedActorKey());
+	if (Nodes == nullptr)
+	{
+		// First node of the actor, its end play (destroyed or level unloaded) removes the nodes
+		Nodes = &ActorNodes.Emplace(InNode->GetAttachedActorKey());
+		Actor->OnEndPlay.AddDynamic(NodeListener, &UTFNodeListener::OnActorEndPlay);
+	}
+	Nodes->Emplace(InNode);
+}
+
+// Stop tracking the node with the nodes of its actor (arena storage)
+void FTFTree::UntrackActorNode(FTFNode* InNode)
+{
+	TArray<FTFNode*>* Nodes = ActorNodes.Find(InNode->GetAttachedActorKey());
+	if (Nodes && Nodes->RemoveSingleSwap(InNode, false) > 0 && Nodes->Num() == 0)
+	{
+		if (AActor* Actor = InNode->GetAttachedActor())
+		{
+			Actor->OnEndPlay.RemoveDynamic(NodeListener, &UTFNodeListener::OnActorEndPlay);
+		}
+		ActorNodes.Remove(InNode->GetAttachedActorKey());
+	}
+}
+
+// Flag the layout for rebuilding and drop the cached lookup paths
+void FTFTree::MarkTopologyChanged()
+{
+	if (bDeferTopologyChanges)
+	{
+		bTopologyChangeDeferred = true;
+		return;
+	}
+	bLayoutDirty = true;
+	++TopologyVersion;
+	LookupPaths.Empty();
+}
+
+// Empty tree
+void FTFTree::Empty()
+{
+	// The build task reads the tree settings
+	if (AsyncBuild.IsValid())
+	{
+		AsyncBuild->Task.Wait();
+		AsyncBuild.Reset();
+	}
+
+	// Release the anchors first, they would remove their nodes from the tree while being destroyed
+	TArray<UTFNode*> AnchorsToDestroy;
+	for (auto TFNodeItr : TFNodes)
+	{
+		if (UTFNode* Anchor = TFNodeItr->GetAnchor())
+		{
+			Anchor->ReleaseOwnerTree();
+			AnchorsToDestroy.Emplace(Anchor);
+		}
+	}
+	for (auto AnchorItr : AnchorsToDestroy)
+	{
+		// Destroy anchor component
+		AnchorItr->DestroyComponent();
+	}
+
+	// Stop listening to the tracked actors
+	if (NodeListener)
+	{
+		for (const auto& ActorNodesItr : ActorNodes)
+		{
+			if (AActor* Actor = Cast<AActor>(ActorNodesItr.Key.ResolveObjectPtr()))
+			{
+				Actor->OnEndPlay.RemoveDynamic(NodeListener, &UTFNodeListener::OnActorEndPlay);
+			}
+		}
+		NodeListener->ReleaseOwnerTree();
+		NodeListener->RemoveFromRoot();
+		NodeListener = nullptr;
+	}
+	if (PreGarbageCollectHandle.IsValid())
+	{
+		FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+		PreGarbageCollectHandle.Reset();
+	}
+	ActorNodes.Empty();
+
+	// Free the nodes (with the blank root)
+	NodeArena->Empty();
+	Root = nullptr;
+	TFNodes.Empty();
+	PendingChildren.Empty();
+	FrameIdToNode.Empty();
+	RateBuckets.Empty();
+	LayoutNodes.Empty();
+	ParentIndices.Empty();
+	Sources.Empty();
+	SubtreeIds.Empty();
+	WorldTransforms.Empty();
+	WorldTransformStamps.Empty();
+	Transforms.Empty();
+	LastPublishedTransforms.Empty();
+	PublishedFlags.Empty();
+	AllIndices.Empty();
+	DynamicIndices.Empty();
+	StaticIndices.Empty();
+	StaticFlags.Empty();
+	StaticTransforms.Empty();
+	UnchangedCounts.Empty();
+	DueIndices.Empty();
+	ChangedIndices.Empty();
+	ChangedFlags.Empty();
+	HeaderPool.Empty();
+	StampedMsgPool.Empty();
+	FrameSchema.Reset();
+	LookupPaths.Empty();
+	bLayoutDirty = true;
+	bStaticSelectionDirty = true;
+	bStaticNodesChanged = false;
+}
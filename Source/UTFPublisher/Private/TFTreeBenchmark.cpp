@@ -0,0 +1,265 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#include "UTFPublisher.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "TFTree.h"
+#include "TFBson.h"
+#include "TFAllocationCounter.h"
+#include "TFBenchmarkUtils.h"
+
+#if !UE_BUILD_SHIPPING
+/**
+* Times the phases of the tree (build, layout, publish, node messages, snapshot, serialization) on synthetic
+* tag annotated worlds, and writes the results as json to Saved/Benchmarks for comparing them across commits
+*
+*  - chain: every frame is the child of the previous one
+*  - fan: every frame is a child of the root
+*  - forest: trees of ten frames whose parent frames do not exist (orphans)
+*
+* Usage: TF.BenchmarkTree [Label=Name] [chain] [fan] [forest] [NumFrames ...] (default all shapes, 100 1000 10000 100000)
+*/
+namespace TFTreeBenchmark
+{
+	// Number of runs averaged per repeatable phase
+	static const int32 NumIterations = 10;
+
+	// Frame id of the root
+	static const TCHAR* RootFrameId = TEXT("map");
+
+	// Number of frames in a tree of the forest
+	static const int32 ForestTreeSize = 10;
+
+	// Topology of the synthetic world
+	enum class EShape : uint8
+	{
+		Chain,
+		Fan,
+		Forest
+	};
+
+	// Result of a phase
+	struct FPhaseResult
+	{
+		FString Shape;
+		int32 NumFrames;
+		FString Phase;
+		double Ms;
+		uint32 Allocations;
+		int32 Bytes;
+	};
+
+	// Get the name of the shape
+	static const TCHAR* GetShapeName(const EShape InShape)
+	{
+		switch (InShape)
+		{
+		case EShape::Chain: return TEXT("chain");
+		case EShape::Fan: return TEXT("fan");
+		default: return TEXT("forest");
+		}
+	}
+
+	// Get the parent frame id of the frame in the shape
+	static FString GetParentFrameId(const EShape InShape, const int32 InIdx)
+	{
+		switch (InShape)
+		{
+		case EShape::Chain:
+			return InIdx == 0 ? FString(RootFrameId) : FString::Printf(TEXT("frame_%d"), InIdx - 1);
+		case EShape::Fan:
+			return RootFrameId;
+		default:
+			return InIdx % ForestTreeSize == 0 ? FString::Printf(TEXT("missing_%d"), InIdx / ForestTreeSize)
+				: FString::Printf(TEXT("frame_%d"), InIdx - InIdx % ForestTreeSize);
+		}
+	}
+
+	// Run the phase the given number of times, the body returns the number of serialized bytes (0 if none),
+	// returns the number of allocations of all runs
+	static uint32 Measure(const EShape InShape, const int32 InNumFrames, const TCHAR* InPhase, const int32 InIterations,
+		TFunctionRef<int32()> Body, TArray<FPhaseResult>& OutResults)
+	{
+		uint32 NumAllocations = 0;
+		int32 Bytes = 0;
+		const double Start = FPlatformTime::Seconds();
+		{
+			FTFAllocationCounter::FScope AllocationScope(NumAllocations);
+			for (int32 Iter = 0; Iter < InIterations; ++Iter)
+			{
+				Bytes = Body();
+			}
+		}
+
+		FPhaseResult& Result = OutResults[OutResults.AddDefaulted()];
+		Result.Shape = GetShapeName(InShape);
+		Result.NumFrames = InNumFrames;
+		Result.Phase = InPhase;
+		Result.Ms = (FPlatformTime::Seconds() - Start) * 1000.0 / InIterations;
+		Result.Allocations = NumAllocations / InIterations;
+		Result.Bytes = Bytes;
+
+		UE_LOG(LogTF, Display, TEXT("%s::%d %s %d frames %s: %.3f ms, %u allocations, %d bytes"),
+			TEXT(__FUNCTION__), __LINE__, *Result.Shape, InNumFrames, InPhase, Result.Ms, Result.Allocations, Bytes);
+		return NumAllocations;
+	}
+
+	// Time the phases of the tree in a new world with the given shape
+	static void RunShape(const EShape InShape, const int32 InNumFrames, TArray<FPhaseResult>& OutResults)
+	{
+		UWorld* World = FTFBenchmarkUtils::CreateWorld();
+		FTFBenchmarkUtils::SpawnTaggedActors(World, InNumFrames, [InShape](const int32 InIdx)
+		{
+			return GetParentFrameId(InShape, InIdx);
+		});
+
+		{
+			FTFTree TFTree;
+			TFTree.Init(RootFrameId);
+
+			const FROSTime Time = FROSTime::Now();
+			Measure(InShape, InNumFrames, TEXT("Build"), 1, [&]()
+			{
+				TFTree.Build(World);
+				return 0;
+			}, OutResults);
+
+			// The first publish flattens the tree into the layout
+			Measure(InShape, InNumFrames, TEXT("FirstPublish"), 1, [&]()
+			{
+				TFTree.GetTFMessageMsg(Time);
+				return 0;
+			}, OutResults);
+
+			Measure(InShape, InNumFrames, TEXT("Publish"), NumIterations, [&]()
+			{
+				TFTree.GetTFMessageMsg(Time);
+				return 0;
+			}, OutResults);
+
+			FTFSnapshot Snapshot;
+			Measure(InShape, InNumFrames, TEXT("Snapshot"), NumIterations, [&]()
+			{
+				TFTree.GetSnapshot(Snapshot, Time, 0, 0.f, nullptr, false);
+				return 0;
+			}, OutResults);
+
+			// Messages built by the worker from the transforms and the frame ids of the layout
+			Measure(InShape, InNumFrames, TEXT("NodeMessages"), NumIterations, [&]()
+			{
+				Snapshot.GetTFMessageMsg();
+				return 0;
+			}, OutResults);
+
+			TSharedPtr<tf2_msgs::TFMessage> TFMsg = TFTree.GetTFMessageMsg(Time);
+			Measure(InShape, InNumFrames, TEXT("JsonSerialize"), NumIterations, [&]()
+			{
+				return FTFBenchmarkUtils::EncodeJson(TFMsg);
+			}, OutResults);
+
+			TArray<uint8> BsonBuffer;
+			Measure(InShape, InNumFrames, TEXT("BsonSerialize"), NumIterations, [&]()
+			{
+				BsonBuffer.Reset();
+				FTFBson::WriteTFPublishOp(BsonBuffer, TEXT("/tf"), Snapshot);
+				return BsonBuffer.Num();
+			}, OutResults);
+
+			// Steady state of the pipelined BSON publish: the snapshot capture (game thread) and the encoding
+			// into the reused buffer (worker) must not allocate once warmed up, the websocket send is not included
+			const FString Topic = TEXT("/tf");
+			auto SteadyStatePublish = [&]()
+			{
+				TFTree.GetSnapshot(Snapshot, Time, 0, 0.f, nullptr, false);
+				BsonBuffer.Reset();
+				FTFBson::WriteTFPublishOp(BsonBuffer, Topic, Snapshot);
+				return BsonBuffer.Num();
+			};
+			SteadyStatePublish();
+			const uint32 SteadyStateAllocations = Measure(InShape, InNumFrames, TEXT("SteadyStatePublish"), NumIterations,
+				SteadyStatePublish, OutResults);
+			if (SteadyStateAllocations > 0)
+			{
+				UE_LOG(LogTF, Error, TEXT("%s::%d FAILED: the steady state snapshot and BSON publish of %s %d frames made %u heap allocations in %d runs (expected 0).."),
+					TEXT(__FUNCTION__), __LINE__, GetShapeName(InShape), InNumFrames, SteadyStateAllocations, NumIterations);
+			}
+		}
+
+		FTFBenchmarkUtils::DestroyWorld(World);
+	}
+
+	// Write the results as json, returns the file path
+	static FString WriteResults(const FString& InLabel, const TArray<FPhaseResult>& InResults)
+	{
+		TArray<TSharedPtr<FJsonObject>> ResultObjects;
+		for (const auto& ResultItr : InResults)
+		{
+			TSharedPtr<FJsonObject> ResultObject = MakeShareable(new FJsonObject());
+			ResultObject->SetStringField(TEXT("shape"), ResultItr.Shape);
+			ResultObject->SetNumberField(TEXT("frames"), ResultItr.NumFrames);
+			ResultObject->SetStringField(TEXT("phase"), ResultItr.Phase);
+			ResultObject->SetNumberField(TEXT("ms"), ResultItr.Ms);
+			ResultObject->SetNumberField(TEXT("allocations"), ResultItr.Allocations);
+			ResultObject->SetNumberField(TEXT("bytes"), ResultItr.Bytes);
+			ResultObjects.Emplace(ResultObject);
+		}
+
+		TSharedRef<FJsonObject> RootObject = MakeShareable(new FJsonObject());
+		RootObject->SetStringField(TEXT("label"), InLabel);
+		RootObject->SetNumberField(TEXT("iterations"), NumIterations);
+		return FTFBenchmarkUtils::WriteResults(TEXT("TFTree_") + InLabel, RootObject, ResultObjects);
+	}
+
+	// Run the benchmark for the given shapes and tree sizes
+	static void Run(const TArray<FString>& Args)
+	{
+		FString Label = TEXT("local");
+		TArray<EShape> Shapes;
+		for (const auto& ArgItr : Args)
+		{
+			if (ArgItr.StartsWith(TEXT("Label=")))
+			{
+				Label = ArgItr.RightChop(6);
+			}
+			else if (ArgItr == TEXT("chain"))
+			{
+				Shapes.Emplace(EShape::Chain);
+			}
+			else if (ArgItr == TEXT("fan"))
+			{
+				Shapes.Emplace(EShape::Fan);
+			}
+			else if (ArgItr == TEXT("forest"))
+			{
+				Shapes.Emplace(EShape::Forest);
+			}
+		}
+		if (Shapes.Num() == 0)
+		{
+			Shapes = { EShape::Chain, EShape::Fan, EShape::Forest };
+		}
+		const TArray<int32> Sizes = FTFBenchmarkUtils::ParseSizes(Args, { 100, 1000, 10000, 100000 });
+
+		// The allocations of the phases are only counted inside the benchmark
+		FTFAllocationCounter::Install();
+
+		TArray<FPhaseResult> Results;
+		for (const EShape Shape : Shapes)
+		{
+			for (const int32 NumFrames : Sizes)
+			{
+				RunShape(Shape, NumFrames, Results);
+			}
+		}
+
+		UE_LOG(LogTF, Display, TEXT("%s::%d Results written to %s"),
+			TEXT(__FUNCTION__), __LINE__, *WriteResults(Label, Results));
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("TF.BenchmarkTree"),
+		TEXT("Time the tree phases on synthetic worlds. Usage: TF.BenchmarkTree [Label=Name] [chain] [fan] [forest] [NumFrames ...]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Run));
+}
+#endif // !UE_BUILD_SHIPPING
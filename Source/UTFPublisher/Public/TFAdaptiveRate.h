@@ -0,0 +1,141 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+
+/**
+* FTFSendStats - Send statistics of the publish worker since they were last consumed
+*/
+struct FTFSendStats
+{
+	// Default constructor
+	FTFSendStats() : LatencySum(0.0), NumSent(0), NumStale(0), MaxQueueDepth(0) {}
+
+	// Sum of the capture to send latencies (s) of the sent snapshots
+	double LatencySum;
+
+	// Number of sent snapshots
+	int32 NumSent;
+
+	// Number of snapshots dropped as stale
+	int32 NumStale;
+
+	// Maximal number of snapshots submitted between two takes of the worker (the older ones were coalesced)
+	int32 MaxQueueDepth;
+
+	// Add the statistics
+	void Append(const FTFSendStats& InOther)
+	{
+		LatencySum += InOther.LatencySum;
+		NumSent += InOther.NumSent;
+		NumStale += InOther.NumStale;
+		MaxQueueDepth = FMath::Max(MaxQueueDepth, InOther.MaxQueueDepth);
+	}
+};
+
+/**
+* FTFAdaptiveSettings - Thresholds of the adaptive publish rate
+*/
+struct FTFAdaptiveSettings
+{
+	// Publish rate (Hz) without backpressure
+	float MaxRate;
+
+	// Lowest publish rate (Hz)
+	float MinRate;
+
+	// Mean send latency (s) above which the publishing is throttled
+	float LatencyThreshold;
+
+	// Queue depth above which the publishing is throttled
+	int32 QueueDepthThreshold;
+
+	// Switch to delta publishing before lowering the rate
+	bool bAllowDeltaMode;
+
+	// Delta time (s) between the decisions
+	float EvaluationInterval;
+};
+
+/**
+* FTFAdaptiveCounters - Decisions taken by the adaptive publish rate
+*/
+struct FTFAdaptiveCounters
+{
+	// Default constructor
+	FTFAdaptiveCounters() : RateDecreases(0), RateIncreases(0), DeltaModeEnables(0), DeltaModeDisables(0) {}
+
+	// Number of times the rate was lowered
+	uint32 RateDecreases;
+
+	// Number of times the rate was raised
+	uint32 RateIncreases;
+
+	// Number of times the delta publishing was forced on
+	uint32 DeltaModeEnables;
+
+	// Number of times the forced delta publishing was turned off
+	uint32 DeltaModeDisables;
+};
+
+/**
+* FTFAdaptiveRate - Throttles the publishing on backpressure (game thread)
+*
+*  - on every evaluation the send statistics of the interval are compared with the thresholds
+*  - overloaded: delta publishing is forced on first (if allowed), then the rate is halved down to the minimum
+*  - relaxed for several intervals: the rate is raised back to the maximum, then the forced delta publishing is turned off
+*/
+class UTFPUBLISHER_API FTFAdaptiveRate
+{
+public:
+	// Constructor
+	FTFAdaptiveRate();
+
+	// Set the thresholds and restart at the maximal rate
+	void Init(const FTFAdaptiveSettings& InSettings);
+
+	// Add the send statistics of the last publishes
+	void AddSendStats(const FTFSendStats& InSendStats) { IntervalStats.Append(InSendStats); }
+
+	// Take the decisions if the evaluation interval elapsed
+	void Update(const float InWorldTime);
+
+	// Check if a publish is due at the current rate (schedules the next publish)
+	bool ShouldPublish(const float InWorldTime);
+
+	// Check if the delta publishing is forced on
+	bool IsDeltaModeForced() const { return bDeltaModeForced; }
+
+	// Get the current publish rate (Hz)
+	float GetRate() const { return CurrentRate; }
+
+	// Get the decision counters
+	const FTFAdaptiveCounters& GetCounters() const { return Counters; }
+
+private:
+	// Thresholds
+	FTFAdaptiveSettings Settings;
+
+	// Send statistics of the current interval
+	FTFSendStats IntervalStats;
+
+	// Decision counters
+	FTFAdaptiveCounters Counters;
+
+	// Current publish rate (Hz)
+	float CurrentRate;
+
+	// Delta publishing forced on
+	bool bDeltaModeForced;
+
+	// Number of consecutive relaxed intervals
+	int32 RelaxedIntervals;
+
+	// World time (s) of the next evaluation
+	float NextEvaluationTime;
+
+	// World time (s) of the next publish
+	float NextPublishTime;
+};
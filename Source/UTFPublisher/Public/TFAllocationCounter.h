@@ -0,0 +1,49 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+
+/**
+* FTFAllocationCounter - Counts the heap allocations made by the current thread inside a scope
+*
+*  - Install wraps GMalloc with a forwarding proxy (never removed, it only adds a TLS lookup per call),
+*    swapping the allocator at runtime is only safe in a controlled run, it is only installed by the benchmark commands,
+*    every allocation of the process pays the lookup for the rest of the run
+*  - the proxy is not compiled into shipping builds (Install does nothing)
+*  - the scopes count nothing until it is installed
+*/
+class UTFPUBLISHER_API FTFAllocationCounter
+{
+public:
+	// Wrap GMalloc with the counting proxy (once, game thread, benchmark commands only)
+	static void Install();
+
+	// Check if the counting proxy is installed
+	static bool IsInstalled() { return bInstalled; }
+
+	// Count the allocations (and growing reallocations) of the current thread until the scope ends
+	class UTFPUBLISHER_API FScope
+	{
+	public:
+		// Constructor, the count is added to the given number
+		explicit FScope(uint32& OutNumAllocations);
+
+		// Destructor
+		~FScope();
+
+	private:
+		// Counter of the enclosing scope of the thread (if any)
+		uint32* PrevCounter;
+	};
+
+private:
+	// The counting proxy wraps GMalloc
+	static bool bInstalled;
+
+	// Thread local slot pointing to the counter of the active scope
+	static uint32 TlsSlot;
+
+	friend class FTFCountingMalloc;
+};
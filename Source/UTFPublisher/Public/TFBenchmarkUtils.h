@@ -0,0 +1,42 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "Dom/JsonObject.h"
+#include "tf2_msgs/TFMessage.h"
+
+#if !UE_BUILD_SHIPPING
+// Forward declarations
+class UWorld;
+
+/**
+* FTFBenchmarkUtils - Shared helpers of the benchmark console commands
+* (synthetic worlds and data, reference encodings, argument parsing, json results in Saved/Benchmarks)
+*/
+struct UTFPUBLISHER_API FTFBenchmarkUtils
+{
+	// Random transform of a synthetic frame (any rotation, up to 10 m from its parent)
+	static FTransform RandomTransform(FRandomStream& Random);
+
+	// Encode the message as a rosbridge json publish operation (as the default publish path), returns the UTF-8 size
+	static int32 EncodeJson(const TSharedPtr<tf2_msgs::TFMessage>& InTFMsg, const FString& InTopic = TEXT("/tf"));
+
+	// Create a new game world with its world context
+	static UWorld* CreateWorld();
+
+	// Destroy the world and its world context, and collect its objects
+	static void DestroyWorld(UWorld* InWorld);
+
+	// Spawn an actor with a TF tag and a random transform for every frame (frame_<idx>, child of the given parent frame id)
+	static void SpawnTaggedActors(UWorld* InWorld, const int32 InNumFrames, TFunctionRef<FString(const int32 InIdx)> InGetParentFrameId);
+
+	// Get the numeric arguments (tree sizes), the defaults if there are none
+	static TArray<int32> ParseSizes(const TArray<FString>& Args, const TArray<int32>& InDefaultSizes);
+
+	// Write the results with the date into Saved/Benchmarks/<name>_<date>.json, returns the file path
+	static FString WriteResults(const FString& InName, const TSharedRef<FJsonObject>& InRootObject,
+		const TArray<TSharedPtr<FJsonObject>>& InResults);
+};
+#endif // !UE_BUILD_SHIPPING
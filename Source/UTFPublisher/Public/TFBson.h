@@ -0,0 +1,104 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "Dom/JsonObject.h"
+#include "TFSnapshot.h"
+
+/**
+* FTFBsonWriter - Minimal streaming BSON (http://bsonspec.org) writer into a byte buffer
+*/
+class UTFPUBLISHER_API FTFBsonWriter
+{
+public:
+	// Constructor, the documents are appended to the buffer
+	explicit FTFBsonWriter(TArray<uint8>& InBuffer) : Buffer(InBuffer) {}
+
+	// Begin the root document
+	void BeginDocument();
+
+	// Begin an embedded document
+	void BeginDocument(const ANSICHAR* InKey);
+
+	// Begin an embedded document as the element of an array
+	void BeginDocument(const int32 InArrayIndex);
+
+	// Begin an array (a document with the indices as keys)
+	void BeginArray(const ANSICHAR* InKey);
+
+	// End the current document or array
+	void EndDocument();
+
+	// Write a double element
+	void WriteDouble(const ANSICHAR* InKey, const double InValue);
+
+	// Write an int32 element
+	void WriteInt32(const ANSICHAR* InKey, const int32 InValue);
+
+	// Write an int64 element
+	void WriteInt64(const ANSICHAR* InKey, const int64 InValue);
+
+	// Write a boolean element
+	void WriteBool(const ANSICHAR* InKey, const bool bInValue);
+
+	// Write an UTF-8 string element
+	void WriteString(const ANSICHAR* InKey, const FString& InValue);
+
+	// Write an UTF-8 string element from already encoded characters (length without the null terminator)
+	void WriteString(const ANSICHAR* InKey, const ANSICHAR* InUtf8Value, const int32 InLength);
+
+	// Write a generic binary element
+	void WriteBinary(const ANSICHAR* InKey, const uint8* InData, const int32 InNum);
+
+private:
+	// Write the element type and its key
+	void WriteElementHeader(const uint8 InType, const ANSICHAR* InKey);
+
+	// Write the element type and an array index as key
+	void WriteElementHeader(const uint8 InType, const int32 InArrayIndex);
+
+	// Write raw bytes
+	FORCEINLINE void WriteBytes(const void* InData, const int32 InNum)
+	{
+		const int32 Offset = Buffer.AddUninitialized(InNum);
+		FMemory::Memcpy(Buffer.GetData() + Offset, InData, InNum);
+	}
+
+	// Output buffer
+	TArray<uint8>& Buffer;
+
+	// Offsets of the size fields of the open documents
+	TArray<int32, TInlineAllocator<8>> OpenDocuments;
+};
+
+/**
+* FTFBson - rosbridge operations encoded as BSON (for rosbridge_server running in bson_only_mode)
+*/
+struct UTFPUBLISHER_API FTFBson
+{
+	// Write an advertise operation (latched topics resend their last message to new subscribers)
+	static void WriteAdvertiseOp(TArray<uint8>& OutBuffer, const FString& InTopic, const FString& InType, const bool bInLatch = false);
+
+	// Write an unadvertise operation
+	static void WriteUnadvertiseOp(TArray<uint8>& OutBuffer, const FString& InTopic);
+
+	// Write a publish operation of a tf2_msgs/TFMessage directly from the snapshot (converted to ROS coordinates),
+	// the frame ids are copied from the interned ids of the schema (no allocations once the buffer has grown)
+	static void WriteTFPublishOp(TArray<uint8>& OutBuffer, const FString& InTopic, const FTFSnapshot& InSnapshot)
+	{
+		WriteTFPublishOp(OutBuffer, InTopic, InSnapshot, 0, InSnapshot.Num());
+	}
+
+	// Write a publish operation of the transforms in the [Start, End) positions of the snapshot
+	static void WriteTFPublishOp(TArray<uint8>& OutBuffer, const FString& InTopic, const FTFSnapshot& InSnapshot,
+		const int32 InStart, const int32 InEnd);
+
+	// Write a publish operation of a std_msgs/UInt8MultiArray with the bytes as binary data (compact tf packets)
+	static void WriteBytesPublishOp(TArray<uint8>& OutBuffer, const FString& InTopic, const uint8* InData, const int32 InNum);
+
+	// Reference decoder, read a BSON document into a json object (as rosbridge_server decodes it),
+	// binary data is read as an array of byte values, returns nullptr if the document is malformed
+	static TSharedPtr<FJsonObject> ReadDocument(const uint8* InData, const int32 InNum);
+};
@@ -0,0 +1,87 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "HAL/ThreadSafeBool.h"
+#include "TFSnapshot.h"
+#include "TFCompact.h"
+
+// Forward declarations
+class IWebSocket;
+
+/**
+* FTFBsonClient - Publishes tf snapshots as BSON to a rosbridge_server running in bson_only_mode
+*
+*  - uses its own websocket connection, the messages are encoded straight from the snapshots
+*    (no intermediate ROS message or json objects) into a reused buffer
+*  - optionally publishes compact tf packets (std_msgs/UInt8MultiArray) instead of tf2_msgs/TFMessage
+*/
+class UTFPUBLISHER_API FTFBsonClient
+{
+public:
+	// Constructor
+	FTFBsonClient(const FString& InServerIP, const int32 InServerPORT);
+
+	// Destructor
+	~FTFBsonClient();
+
+	// Add a tf2_msgs/TFMessage topic to advertise once connected (call before connecting)
+	void AddTopic(const FString& InTopic, const bool bInLatch = false);
+
+	// Publish compact tf packets with the given precision instead of tf messages (call before connecting)
+	void SetCompactEncoding(const FTFCompactSettings& InSettings);
+
+	// Connect to the server, the topics are advertised once connected
+	void Connect();
+
+	// Unadvertise the topics and close the connection
+	void Disconnect();
+
+	// Check if the topics are advertised and ready for publishing
+	bool IsReady() const { return bAdvertised; }
+
+	// Encode and send the snapshot to the topic (one message per chunk), returns the number of bytes sent (0 if not connected)
+	int32 Publish(const FString& InTopic, const FTFSnapshot& InSnapshot);
+
+	// Encode and send a chunk of the snapshot to the topic, returns the number of bytes sent (0 if not connected)
+	int32 PublishChunk(const FString& InTopic, const FTFSnapshot& InSnapshot, const int32 InChunkIdx);
+
+private:
+	// Encode the chunk as a compact packet and write its publish operation into the buffer
+	void WriteCompactPublishOp(const FString& InTopic, const FTFSnapshot& InSnapshot, const int32 InStart, const int32 InEnd);
+
+	// Send the buffer as a binary frame
+	void SendBuffer();
+
+	// Websocket connection
+	TSharedPtr<IWebSocket> WebSocket;
+
+	// Server url
+	FString ServerURL;
+
+	// Topics to advertise, with their latch flag
+	TArray<TPair<FString, bool>> Topics;
+
+	// Reused encoding buffer
+	TArray<uint8> Buffer;
+
+	// Publish compact tf packets
+	bool bUseCompactEncoding;
+
+	// Precision of the compact tf packets
+	FTFCompactSettings CompactSettings;
+
+	// Compact encoder of every topic (created on the first publish)
+	TMap<FString, FTFCompactEncoder> CompactEncoders;
+
+	// Reused compact packet buffer
+	TArray<uint8> PacketBuffer;
+
+	// Flag set on (re)connection, the next compact packets are keyframes
+	FThreadSafeBool bResetCompactEncoders;
+
+	// Flag set once the topics are advertised
+	FThreadSafeBool bAdvertised;
+};
@@ -0,0 +1,61 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+
+/**
+* FTFStampedTransform - Tf transform of a frame at a given time
+*/
+struct FTFStampedTransform
+{
+	// World time (s) of the sample
+	float Time;
+
+	// Tf transform (relative to the parent, Unreal coordinates)
+	FTransform Transform;
+};
+
+/**
+* FTFBuffer - Ring buffer of the last timestamped tf transforms of a frame
+*
+*  - samples are added in increasing time order, the oldest one is overwritten when the buffer is full
+*  - lookups between two samples are interpolated, after the newest sample the newest one is used (no extrapolation)
+*/
+struct UTFPUBLISHER_API FTFBuffer
+{
+	// Default constructor
+	FTFBuffer() : Capacity(0), Head(0) {}
+
+	// Set the maximal number of samples (the samples are dropped if the capacity changes)
+	void SetCapacity(const int32 InCapacity);
+
+	// Add a sample (samples older than the newest one are ignored, a sample at the same time replaces it)
+	void Add(const float InTime, const FTransform& InTransform);
+
+	// Remove all samples (keeps the allocation)
+	void Reset();
+
+	// Get the transform at the given time (negative = newest, 0 is a valid world time), returns false if the time is before the oldest sample
+	bool Lookup(const float InTime, FTransform& OutTransform) const;
+
+	// Number of samples
+	int32 Num() const { return Samples.Num(); }
+
+private:
+	// Get the sample by its age order (0 = oldest)
+	FORCEINLINE const FTFStampedTransform& At(const int32 InPos) const
+	{
+		return Samples[(Head + InPos) % Samples.Num()];
+	}
+
+	// Samples (in insertion order starting at the head once the buffer is full)
+	TArray<FTFStampedTransform> Samples;
+
+	// Maximal number of samples
+	int32 Capacity;
+
+	// Slot of the oldest sample
+	int32 Head;
+};
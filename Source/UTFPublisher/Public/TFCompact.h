@@ -0,0 +1,134 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "tf2_msgs/TFMessage.h"
+#include "TFSnapshot.h"
+
+/**
+* FTFCompactSettings - Precision of the compact tf stream
+*/
+struct UTFPUBLISHER_API FTFCompactSettings
+{
+	// Default constructor (0.1 mm, 14 bit rotation components, 1 s between keyframes)
+	FTFCompactSettings() : TranslationStep(0.0001f), RotationBits(14), KeyframeInterval(1.f) {}
+
+	// Quantization step (m, ROS coordinates) of the translations
+	float TranslationStep;
+
+	// Number of bits of the three smallest quaternion components (6 - 20)
+	int32 RotationBits;
+
+	// Delta time (s, stamp time) between keyframes (0 = every packet is a keyframe)
+	float KeyframeInterval;
+};
+
+/**
+* FTFCompact - Compact tf stream packets (little endian):
+*
+*  - header: uint8 flags (1 = has schema, 2 = keyframe), uint8 rotation bits, uint16 schema id,
+*    uint32 seq, uint32 stamp secs, uint32 stamp nsecs, float translation step (m)
+*  - schema (first chunk of a keyframe only): varuint number of frames, then for every layout index
+*    the varuint length prefixed UTF-8 child frame id and parent frame id
+*  - varuint number of transforms, then for every transform:
+*    varuint (zigzag(index - previous index - 1) << 1 | absolute flag),
+*    three zigzag varint quantized translations (absolute, or delta from the last sent value of the index),
+*    smallest-three quaternion (2 bit index of the largest component + three components of rotation bits)
+*/
+struct UTFPUBLISHER_API FTFCompact
+{
+	// Packet flags
+	static const uint8 HasSchemaFlag = 0x01;
+	static const uint8 KeyframeFlag = 0x02;
+
+	// Size of the packet header
+	static const int32 HeaderSize = 20;
+
+	// Limits of the rotation bits
+	static const int32 MinRotationBits = 6;
+	static const int32 MaxRotationBits = 20;
+};
+
+/**
+* FTFCompactEncoder - Writes the snapshots of a topic as compact packets,
+* keeps the quantized translations of the last packets for the delta encoding (one encoder per topic)
+*/
+class UTFPUBLISHER_API FTFCompactEncoder
+{
+public:
+	// Constructor
+	explicit FTFCompactEncoder(const FTFCompactSettings& InSettings = FTFCompactSettings());
+
+	// Forget the previous packets (the next packet is a keyframe)
+	void Reset();
+
+	// Write the snapshot as a packet
+	void WritePacket(TArray<uint8>& OutBuffer, const FTFSnapshot& InSnapshot)
+	{
+		WritePacket(OutBuffer, InSnapshot, 0, InSnapshot.Num());
+	}
+
+	// Write the transforms in the [Start, End) positions of the snapshot as a packet,
+	// the chunks of the same snapshot (seq) are all keyframes or all deltas, only the first one carries the schema
+	void WritePacket(TArray<uint8>& OutBuffer, const FTFSnapshot& InSnapshot, const int32 InStart, const int32 InEnd);
+
+private:
+	// Settings
+	FTFCompactSettings Settings;
+
+	// Schema of the last packet (kept alive, the pointer identifies the layout)
+	TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> Schema;
+
+	// Id of the schema written in the packets
+	uint16 SchemaId;
+
+	// Seq of the last packet
+	uint32 LastSeq;
+
+	// The packets of the last seq are keyframes
+	bool bKeyframe;
+
+	// Stamp time (s) of the last keyframe
+	double LastKeyframeTime;
+
+	// Quantized translations last sent for every layout index (x, y, z)
+	TArray<int64> References;
+
+	// Layout indices with a sent translation
+	TBitArray<> HasReference;
+};
+
+/**
+* FTFCompactDecoder - Reference decoder, expands the compact packets of a topic back to tf messages
+* (as a ROS side relay would), the deltas are applied on the state of the previous packets
+*/
+class UTFPUBLISHER_API FTFCompactDecoder
+{
+public:
+	// Constructor
+	FTFCompactDecoder() : SchemaId(0), bHasSchema(false) {}
+
+	// Decode the packet, returns nullptr if the packet is malformed or its schema is not known yet (waits for a keyframe)
+	TSharedPtr<tf2_msgs::TFMessage> Decode(const uint8* InData, const int32 InNum);
+
+private:
+	// Id of the current schema
+	uint16 SchemaId;
+
+	// A keyframe with the schema was received
+	bool bHasSchema;
+
+	// Frame id of every layout index
+	TArray<FString> FrameIds;
+
+	// Parent frame id of every layout index
+	TArray<FString> ParentFrameIds;
+
+	// Quantized translations of every layout index (x, y, z)
+	TArray<int64> References;
+
+	// Layout indices with a received translation
+	TBitArray<> HasReference;
+};
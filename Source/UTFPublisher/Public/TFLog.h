@@ -0,0 +1,80 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+
+/**
+* FTFLogChunkInfo - Index entry of a chunk of samples
+*/
+struct FTFLogChunkInfo
+{
+	// File offset of the chunk record
+	int64 Offset;
+
+	// Size of the chunk record (bytes)
+	int64 Size;
+
+	// Time (s) of the first sample
+	double FirstTime;
+
+	// Time (s) of the last sample
+	double LastTime;
+
+	// Schema of the samples
+	int32 SchemaIdx;
+
+	// Serialize the entry
+	friend FArchive& operator<<(FArchive& Ar, FTFLogChunkInfo& Info)
+	{
+		return Ar << Info.Offset << Info.Size << Info.FirstTime << Info.LastTime << Info.SchemaIdx;
+	}
+};
+
+/**
+* FTFLog - Binary tf log format (.tflog), written by FTFLogWriter and read by FTFLogReader
+*
+*  file:    header, schema and chunk records, index record, footer
+*  header:  uint32 file magic, uint32 version
+*  record:  uint32 record magic, int32 payload size, payload
+*  schema:  int32 num frames, (FString frame id, FString parent frame id) per frame
+*  chunk:   int32 schema idx, int32 num samples, int32 data size, double time per sample,
+*           int32 data offset per sample, data (the samples)
+*  sample:  int32 num transforms, (int32 frame idx, FVector translation, FQuat rotation) per transform
+*  index:   TArray<int64> schema record offsets, TArray<FTFLogChunkInfo> chunks
+*  footer:  int64 index record offset, uint32 file magic
+*
+*  - the transforms are tf transforms in Unreal coordinates (relative to the parent, or world if the parent is blank)
+*  - a schema is written once and again only when the topology changes, the chunks refer to their schema
+*  - the index is written on close, logs without one (interrupted writes) are indexed by scanning the records
+*/
+struct FTFLog
+{
+	// File magic ('TFLG')
+	static const uint32 FileMagic = 0x474C4654;
+
+	// Schema record magic ('TFSC')
+	static const uint32 SchemaMagic = 0x43534654;
+
+	// Chunk record magic ('TFCK')
+	static const uint32 ChunkMagic = 0x4B434654;
+
+	// Index record magic ('TFIX')
+	static const uint32 IndexMagic = 0x58494654;
+
+	// Format version
+	static const uint32 Version = 1;
+
+	// Size of the file header (bytes)
+	static const int32 HeaderSize = 8;
+
+	// Size of a record header (bytes)
+	static const int32 RecordHeaderSize = 8;
+
+	// Size of the chunk record fields before the sample times (bytes)
+	static const int32 ChunkFieldsSize = 12;
+
+	// Size of the footer (bytes)
+	static const int32 FooterSize = 12;
+};
@@ -0,0 +1,88 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "TFLog.h"
+#include "TFSnapshot.h"
+
+// Forward declarations
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+* FTFLogReader - Random access to the samples of a binary tf log (FTFLog)
+*
+*  - the file is memory mapped (where supported, otherwise the chunks are read on demand)
+*  - samples are found by binary searching the chunk index, then the sample times of the chunk
+*/
+class UTFPUBLISHER_API FTFLogReader
+{
+public:
+	// Constructor
+	FTFLogReader();
+
+	// Destructor
+	~FTFLogReader();
+
+	// Open the log and read its index (the records are scanned if the log has no index), returns false on failure
+	bool Open(const FString& InFilePath);
+
+	// Close the log
+	void Close();
+
+	// Check if a log with samples is open
+	bool IsOpen() const { return Chunks.Num() > 0; }
+
+	// Time (s) of the first sample
+	double GetStartTime() const { return Chunks.Num() > 0 ? Chunks[0].FirstTime : 0.0; }
+
+	// Time (s) of the last sample
+	double GetEndTime() const { return Chunks.Num() > 0 ? Chunks.Last().LastTime : 0.0; }
+
+	// Read the last sample at or before the given time (the first sample for earlier times) into the snapshot,
+	// returns false if there is no sample or it is corrupt (e.g. frame indices outside of its schema)
+	bool ReadSample(const double InTime, FTFSnapshot& OutSnapshot, double& OutSampleTime, int32& OutSchemaIdx);
+
+	// Get the frame index of the parent of every frame of the schema (INDEX_NONE if the parent is not in the schema)
+	const TArray<int32>& GetParentIndices(const int32 InSchemaIdx) const { return ParentIndices[InSchemaIdx]; }
+
+private:
+	// Read the index record from the footer offset, returns false if there is none
+	bool ReadIndex();
+
+	// Index the log by scanning its records (interrupted writes)
+	bool ScanRecords();
+
+	// Read the schema record at the offset
+	bool ReadSchema(const int64 InOffset);
+
+	// Get the bytes of the file range (mapped, or read into the read buffer, valid until the next call)
+	const uint8* GetRange(const int64 InOffset, const int64 InSize);
+
+	// Log file (if not mapped)
+	IFileHandle* FileHandle;
+
+	// Mapped log file
+	IMappedFileHandle* MappedHandle;
+
+	// Mapped region of the whole file
+	IMappedFileRegion* MappedRegion;
+
+	// Size of the file
+	int64 FileSize;
+
+	// Buffer of the last read range (if not mapped)
+	TArray<uint8> ReadBuffer;
+
+	// Frame ids of the schemas
+	TArray<TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe>> Schemas;
+
+	// Parent frame indices of the schemas
+	TArray<TArray<int32>> ParentIndices;
+
+	// Chunk index
+	TArray<FTFLogChunkInfo> Chunks;
+};
@@ -0,0 +1,124 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "TFLog.h"
+#include "TFSnapshot.h"
+
+// Forward declaration
+class IFileHandle;
+
+/**
+* FTFLogWriter - Appends tf snapshots to a binary tf log (FTFLog) from a background thread
+*
+*  - the game thread only copies the transforms of the snapshot into the queue
+*  - the writer groups the samples into chunks, writes a schema record whenever the topology changes,
+*    and writes the index when it is shut down
+*/
+class UTFPUBLISHER_API FTFLogWriter : public FRunnable
+{
+public:
+	// Constructor
+	FTFLogWriter(const FString& InFilePath, const int32 InSamplesPerChunk);
+
+	// Destructor
+	virtual ~FTFLogWriter();
+
+	// Open the file and start the writer thread, returns false if the file could not be opened
+	bool Start();
+
+	// Stop the writer thread, write the queued samples and the index, and close the file
+	void Shutdown();
+
+	// Queue a copy of the snapshot transforms as the sample at the given time (s) (game thread)
+	void Submit(const double InTime, const FTFSnapshot& InSnapshot);
+
+	/* Begin FRunnable interface */
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	/* End FRunnable interface */
+
+private:
+	// Queued sample
+	struct FSample
+	{
+		double Time;
+		TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> Schema;
+		TArray<int32> Indices;
+		TArray<FTransform> Transforms;
+	};
+
+	// Take the queued samples and add them to the chunks
+	void WriteQueuedSamples();
+
+	// Add the sample to the current chunk (a new schema flushes the chunk first)
+	void AddSample(const FSample& InSample);
+
+	// Write the current chunk record
+	void FlushChunk();
+
+	// Write the schema record
+	void WriteSchema(const FTFFrameSchema& InSchema);
+
+	// Write the index record and the footer
+	void WriteIndex();
+
+	// Write a record from the record buffer (magic and size are prepended)
+	void WriteRecord(const uint32 InMagic);
+
+	// Path of the log file
+	FString FilePath;
+
+	// Number of samples in a chunk
+	int32 SamplesPerChunk;
+
+	// Log file
+	IFileHandle* FileHandle;
+
+	// Samples queued by the game thread
+	TArray<FSample> QueuedSamples;
+
+	// Samples taken by the writer
+	TArray<FSample> TakenSamples;
+
+	// Guards the queue
+	FCriticalSection QueueCriticalSection;
+
+	/* Writer state */
+	// Schema of the current chunk
+	TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> ChunkSchema;
+
+	// Index of the schema of the current chunk
+	int32 ChunkSchemaIdx;
+
+	// Sample times of the current chunk
+	TArray<double> ChunkTimes;
+
+	// Sample data offsets of the current chunk
+	TArray<int32> ChunkOffsets;
+
+	// Sample data of the current chunk
+	TArray<uint8> ChunkData;
+
+	// Payload of the record being written
+	TArray<uint8> RecordBuffer;
+
+	// File offsets of the schema records
+	TArray<int64> SchemaOffsets;
+
+	// Index of the written chunks
+	TArray<FTFLogChunkInfo> Chunks;
+
+	// Wakes the writer on a submit
+	FEvent* WakeEvent;
+
+	// Stop flag
+	FThreadSafeBool bStopping;
+
+	// Writer thread
+	FRunnableThread* Thread;
+};
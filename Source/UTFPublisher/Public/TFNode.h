@@ -5,14 +5,31 @@
 
 #include "UTFPublisher.h" // CoreMinimal, TFLog
 #include "Components/ActorComponent.h"
-#include "geometry_msgs/TransformStamped.h"
+#include "Engine/EngineTypes.h"
+#include "UObject/ObjectKey.h"
+#include "TFBuffer.h"
 #include "TFNode.generated.h"
 
 // Forward declaration to avoid circular dependency
 struct FTFTree;
 
 /**
-* UTFNode - TF Node, inherits from UActorComponent to have life duration synced
+* Storage of the tf nodes
+*/
+UENUM()
+enum class ETFNodeStorage : uint8
+{
+	// Every node is anchored by a UTFNode component on its object (removed with the component)
+	Component	UMETA(DisplayName = "Component"),
+	// Nodes are only kept in the arena of the tree (removed when their actor ends play, or their object is gone)
+	Arena		UMETA(DisplayName = "Arena"),
+};
+
+// Forward declaration of the lifetime anchor
+class UTFNode;
+
+/**
+* FTFNode - TF Node, plain struct stored in the node arena of the owner tree
 *
 *  - pointer to parent node
 *  - array of children nodes
@@ -20,37 +37,26 @@ struct FTFTree;
 *    - frame name
 *    - pointer to parent entity (AActor or USceneComponent) with access to FTransform, nullptr if blank node
 */
-UCLASS()
-class UTFPUBLISHER_API UTFNode : public UActorComponent
+struct UTFPUBLISHER_API FTFNode
 {
-	GENERATED_BODY()
-
-public:	
-	// Sets default values for this component's properties
-	UTFNode();
-
-	// Destructor
-	virtual ~UTFNode();
-
-protected:
-	// Called when the game starts
-	virtual void BeginPlay() override;
+public:
+	// Default constructor
+	FTFNode();
 
-	// Called when the destroy process begins
-	virtual void BeginDestroy() override;
-
-public:	
 	// Init node with attached parent as base class UObject
-	void Init(const FString& InFrameId, FTFTree* InOwnerTree, UObject* InAttachedObject = nullptr);
-
-	// Bind transform function pointers
-	void BindTransformFunction();
+	void Init(const FString& InFrameId, UObject* InAttachedObject = nullptr, float InPublishRate = 0.f, bool bInStatic = false);
 
 	// Get frame id
-	FString GetFrameId() const { return FrameId; }
+	const FString& GetFrameId() const { return FrameId; }
+
+	// Get publish rate (Hz) (0 = on every publish)
+	float GetPublishRate() const { return PublishRate; }
+
+	// Check if the frame is marked as static (Static tag)
+	bool IsMarkedStatic() const { return bStatic; }
 
 	// Get children
-	const TArray<UTFNode*>& GetChildren() const { return Children; }
+	const TArray<FTFNode*>& GetChildren() const { return Children; }
 
 	// Check if node is blank
 	bool IsBlank() const { return ActorBaseObject == nullptr && SceneComponentBaseObject == nullptr; }
@@ -58,52 +64,178 @@ public:
 	// Check if node is root
 	bool IsRoot() const { return Parent == nullptr; }
 
-	// Get transform stamped msg
-	geometry_msgs::TransformStamped GetTransformStampedMsg(const FROSTime& InTime, const uint32 InSeq = 0) const;
+	// Get parent
+	FTFNode* GetParent() const { return Parent; }
 
-	// Add child
-	void AddChild(UTFNode* InChildNode);
+	// Get the object the node is attached to (nullptr if blank, or if the object is gone)
+	UObject* GetAttachedObject() const { return AttachedObject.Get(); }
 
-	// Clear node from tree, remove linking to parent, and link children to parent
-	void Clear();
+	// Check if the node was attached to an object which is gone (destroyed or pending kill)
+	bool IsAttachedObjectGone() const { return !IsBlank() && !AttachedObject.IsValid(); }
 
-private:
-	// Get tf transform
-	FORCEINLINE FTransform GetTransform() const;
+	// Get the actor of the attached object (the actor itself, or the owner of the component, nullptr if gone)
+	AActor* GetAttachedActor() const;
+
+	// Get the key of the actor of the attached object (stays comparable after the actor is gone)
+	const FObjectKey& GetAttachedActorKey() const { return AttachedActorKey; }
+
+	// Get the scene component providing the world transform (root component for actors, nullptr if blank node)
+	USceneComponent* GetTransformSource() const;
+
+	// Get the lifetime anchor component (component storage)
+	UTFNode* GetAnchor() const { return Anchor; }
+
+	// Set the lifetime anchor component (component storage)
+	void SetAnchor(UTFNode* InAnchor) { Anchor = InAnchor; }
+
+	// Get slot in the node arena of the owner tree
+	int32 GetArenaIndex() const { return ArenaIndex; }
+
+	// Set slot in the node arena of the owner tree
+	void SetArenaIndex(int32 InArenaIndex) { ArenaIndex = InArenaIndex; }
+
+	// Get slot in the nodes array of the owner tree
+	int32 GetTreeIndex() const { return TreeIndex; }
+
+	// Set slot in the nodes array of the owner tree
+	void SetTreeIndex(int32 InTreeIndex) { TreeIndex = InTreeIndex; }
+
+	// Get the frame id of the parent the node waits for (empty if the node is attached to its parent)
+	const FString& GetPendingParentFrameId() const { return PendingParentFrameId; }
 
-	// Get the transform (default identity)
-	FORCEINLINE FTransform GetTransform_AsIdentity() const;
+	// Set the frame id of the parent the node waits for
+	void SetPendingParentFrameId(const FString& InFrameId) { PendingParentFrameId = InFrameId; }
 
-	// Get the relative transform from actor (node has non blank parent)
-	FORCEINLINE FTransform GetRelativeTransform_FromActor() const;
+	// Get index in the flattened layout of the owner tree
+	int32 GetLayoutIndex() const { return LayoutIndex; }
 
-	// Get the relative transform from scene component (node has non blank parent)
-	FORCEINLINE FTransform GetRelativeTransform_FromSceneComponent() const;
+	// Set index in the flattened layout of the owner tree
+	void SetLayoutIndex(int32 InLayoutIndex) { LayoutIndex = InLayoutIndex; }
 
-	// Get the world transform of actor (node has blank or no parent)
-	FORCEINLINE FTransform GetWorldTransform_FromActor() const;
+	// Get the buffer of the last recorded tf transforms
+	FTFBuffer& GetTransformBuffer() { return TransformBuffer; }
 
-	// Get the world transform of scene component (node has blank or no parent)
-	FORCEINLINE FTransform GetWorldTransform_FromSceneComponent() const;
+	// Get the buffer of the last recorded tf transforms
+	const FTFBuffer& GetTransformBuffer() const { return TransformBuffer; }
 
-	// Get relative transform function pointer variable type
-	typedef FTransform(UTFNode::*GetTransformFuncPtrType)() const;
-	// Function pointer to the get the relative transform function
-	GetTransformFuncPtrType GetTransformFunctionPtr;
-	
+	// Add child (O(1), the recorded transforms of the child are dropped, they were relative to its previous parent)
+	void AddChild(FTFNode* InChildNode);
+
+	// Remove child (O(1), swaps the last child into its place)
+	void RemoveChild(FTFNode* InChildNode);
+
+	// Move the node (with its subtree) from its parent to the new parent
+	void AttachTo(FTFNode* InNewParent);
+
+	// Clear node from tree, remove linking to parent, and link children to parent
+	void Clear();
+
+private:
 	// Parent
-	UTFNode* Parent;
+	FTFNode* Parent;
 
 	// Array of children nodes
-	TArray<UTFNode*> Children;
+	TArray<FTFNode*> Children;
 
-	// Name of the frame id (tf equivalent of child_frame_id) 
+	// Name of the frame id (tf equivalent of child_frame_id)
 	FString FrameId;
 
-	// Base object type to get the FTransform (of AACtor or USceneComponent)
+	// Publish rate (Hz) of the frame (0 = on every publish)
+	float PublishRate;
+
+	// Frame marked as static (its tf transform is not expected to change)
+	bool bStatic;
+
+	// Base object type to get the FTransform (of AACtor or USceneComponent), valid while the node is in the tree
 	AActor* ActorBaseObject;
 	USceneComponent* SceneComponentBaseObject;
 
-	// Pointer to the owner tree (to remove itself from tree in case of destruction)
+	// Attached object (detects objects which are gone)
+	TWeakObjectPtr<UObject> AttachedObject;
+
+	// Actor of the attached object (arena storage, the nodes are removed with their actor)
+	FObjectKey AttachedActorKey;
+
+	// Lifetime anchor component (component storage, nullptr otherwise)
+	UTFNode* Anchor;
+
+	// Slot in the node arena of the owner tree
+	int32 ArenaIndex;
+
+	// Index in the flattened layout of the owner tree
+	int32 LayoutIndex;
+
+	// Slot in the nodes array of the owner tree
+	int32 TreeIndex;
+
+	// Index in the children array of the parent
+	int32 ChildIndex;
+
+	// Frame id of the parent the node waits for (the node is attached to the root until the parent is added)
+	FString PendingParentFrameId;
+
+	// Last recorded tf transforms (relative to the current parent)
+	FTFBuffer TransformBuffer;
+};
+
+/**
+* UTFNode - Lifetime anchor of a tf node (component storage), inherits from UActorComponent to have life duration synced:
+* attached to the object of the node, it removes the node from the tree when it is destroyed
+*/
+UCLASS()
+class UTFPUBLISHER_API UTFNode : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UTFNode();
+
+protected:
+	// Called when the destroy process begins
+	virtual void BeginDestroy() override;
+
+	// Called when the component (or its owner) is destroyed
+	virtual void OnComponentDestroyed(bool bDestroyingHierarchy) override;
+
+public:
+	// Anchor the node of the tree
+	void Init(FTFTree* InOwnerTree, FTFNode* InNode);
+
+	// Stop removing the node from the owner tree on destruction (the node is removed by the tree)
+	void ReleaseOwnerTree();
+
+private:
+	// Remove the node from the owner tree
+	void RemoveFromOwnerTree();
+
+	// Pointer to the owner tree (to remove the node from tree in case of destruction)
+	FTFTree* OwnerTree;
+
+	// Anchored node
+	FTFNode* Node;
+};
+
+/**
+* UTFNodeListener - Removes the nodes of the actors which end play from the tree (arena storage)
+*/
+UCLASS()
+class UTFPUBLISHER_API UTFNodeListener : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Listen for the given tree
+	void Init(FTFTree* InOwnerTree) { OwnerTree = InOwnerTree; }
+
+	// Stop forwarding to the owner tree (the tree is emptied)
+	void ReleaseOwnerTree() { OwnerTree = nullptr; }
+
+	// Called when a tracked actor is destroyed or its level is unloaded
+	UFUNCTION()
+	void OnActorEndPlay(AActor* InActor, EEndPlayReason::Type InEndPlayReason);
+
+private:
+	// Pointer to the owner tree
 	FTFTree* OwnerTree;
 };
@@ -0,0 +1,68 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "TFNode.h"
+
+/**
+* FTFNodeArena - Pooled storage of the tf nodes of a tree
+*
+*  - the nodes are constructed in place in pages of PageSize contiguous slots, a page is never moved or freed
+*    before the arena is emptied (the node pointers stay valid)
+*  - freed slots are reused (last freed first), the live slots are flagged
+*/
+class UTFPUBLISHER_API FTFNodeArena
+{
+public:
+	// Number of nodes in a page
+	static const int32 PageSize = 1024;
+
+	// Default constructor
+	FTFNodeArena();
+
+	// Destructor
+	~FTFNodeArena();
+
+	// Construct a node in a free slot
+	FTFNode* Allocate();
+
+	// Destruct the node and free its slot
+	void Free(FTFNode* InNode);
+
+	// Destruct the live nodes and free the pages
+	void Empty();
+
+	// Number of live nodes
+	int32 Num() const { return NumLive; }
+
+	// Allocated memory (bytes) of the pages and the bookkeeping
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// Non copyable (the nodes point to each other)
+	FTFNodeArena(const FTFNodeArena&) = delete;
+	FTFNodeArena& operator=(const FTFNodeArena&) = delete;
+
+	// Get the node of the slot
+	FORCEINLINE FTFNode* GetSlot(const int32 InSlot) const
+	{
+		return Pages[InSlot / PageSize] + InSlot % PageSize;
+	}
+
+	// Pages of nodes
+	TArray<FTFNode*> Pages;
+
+	// Slots freed for reuse
+	TArray<int32> FreeSlots;
+
+	// Flags marking the live slots
+	TBitArray<> LiveFlags;
+
+	// Number of slots used so far (the next new slot)
+	int32 NumSlots;
+
+	// Number of live nodes
+	int32 NumLive;
+};
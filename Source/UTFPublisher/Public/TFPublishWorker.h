@@ -0,0 +1,238 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "ROSBridgeHandler.h"
+#include "TFSnapshot.h"
+#include "TFAdaptiveRate.h"
+
+// Forward declarations
+class FTFBsonClient;
+
+/**
+* FTFWorkerChannel - Snapshot slots of a channel topic
+*/
+struct FTFWorkerChannel
+{
+	// Topic of the channel
+	FString Topic;
+
+	// Snapshot written by the game thread
+	FTFSnapshot PendingSnapshot;
+
+	// Snapshot read by the worker
+	FTFSnapshot ReadSnapshot;
+
+	// Flag marking a pending snapshot
+	bool bHasPendingSnapshot;
+};
+
+/**
+* FTFPublishWorker - Publishes tf snapshots from a worker thread
+*
+*  - the game thread only copies the raw transforms into the write snapshot and submits it
+*  - the worker converts the latest submitted snapshot to a tf message, publishes it,
+*    and drives the rosbridge handler (or encodes and sends it with the BSON client)
+*  - three snapshots are swapped (write / pending / read), a newer submit replaces a pending one (latest wins),
+*    the frames of a replaced partial (delta or multi-rate) snapshot are merged into the newer one,
+*    snapshots older than the maximal age are dropped instead of sent
+*  - the chunks of a snapshot spread over the ticks are queued in submit order (none is replaced)
+*  - the rarely changing static snapshot is copied into its own slot and published on the static topic
+*  - the snapshots of the channels are copied into the slots of their channel and published on their topics
+*  - in fixed rate mode the latest snapshot is sampled and published at a steady rate instead of on submit,
+*    interpolated between the two latest snapshots and stamped with the sample time
+*/
+class UTFPUBLISHER_API FTFPublishWorker : public FRunnable
+{
+public:
+	// Constructor
+	FTFPublishWorker(TSharedPtr<FROSBridgeHandler> InROSBridgeHandler, const FString& InTopic, const FString& InStaticTopic);
+
+	// Constructor publishing with the BSON client
+	FTFPublishWorker(TSharedPtr<FTFBsonClient> InBsonClient, const FString& InTopic, const FString& InStaticTopic);
+
+	// Destructor
+	virtual ~FTFPublishWorker();
+
+	// Add a channel topic, returns its index (call before starting)
+	int32 AddChannel(const FString& InTopic);
+
+	// Publish the latest snapshot at the given rate (Hz) instead of on submit, if interpolating the transforms
+	// are blended between the two latest snapshots at the delay (s) behind the publish time (call before starting)
+	void SetFixedRate(const float InRate, const bool bInInterpolate, const float InInterpolationDelay);
+
+	// Drop the snapshots older than the given age (s) when taken for publishing (0 = never)
+	void SetMaxSnapshotAge(const float InMaxSnapshotAge) { MaxSnapshotAge = FMath::Max(InMaxSnapshotAge, 0.f); }
+
+	// Move the send statistics gathered since the last call into the given ones (game thread)
+	void ConsumeSendStats(FTFSendStats& OutSendStats);
+
+	// Get the achieved rate (Hz) and the jitter (ms, mean absolute deviation of the publish intervals) of the last second
+	void GetFixedRateStats(float& OutRate, float& OutJitterMs) const;
+
+	// Start the worker thread
+	void Start();
+
+	// Stop the worker thread and wait for it to finish
+	void Shutdown();
+
+	// Get the snapshot to be written by the game thread
+	FTFSnapshot& GetWriteSnapshot() { return *WriteSnapshot; }
+
+	// Submit the written snapshot for publishing (game thread)
+	void SubmitWriteSnapshot();
+
+	// Queue a copy of the [Start, End) chunk of the snapshot for publishing, in submit order (game thread)
+	void SubmitChunk(const FTFSnapshot& InSnapshot, const int32 InStart, const int32 InEnd);
+
+	// Submit a copy of the static snapshot for publishing on the static topic (game thread)
+	void SubmitStaticSnapshot(const FTFSnapshot& InStaticSnapshot);
+
+	// Submit a copy of the channel snapshot for publishing on the channel topic (game thread)
+	void SubmitChannelSnapshot(const int32 InChannelIdx, const FTFSnapshot& InSnapshot);
+
+	/* Begin FRunnable interface */
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	/* End FRunnable interface */
+
+private:
+	// Take the pending snapshot for reading, returns false if there is none
+	bool TakePendingSnapshot();
+
+	// Take the oldest queued chunk for reading, returns false if there is none
+	bool TakeChunk();
+
+	// Take the pending static snapshot for reading, returns false if there is none
+	bool TakeStaticSnapshot();
+
+	// Take the pending snapshot of the channel for reading, returns false if there is none
+	bool TakeChannelSnapshot(const int32 InChannelIdx);
+
+	// Check if the snapshot is older than the maximal age, counts it as stale
+	bool IsStale(const FTFSnapshot& InSnapshot);
+
+	// Add the latency of the sent snapshot to the send statistics
+	void AddSent(const FTFSnapshot& InSnapshot);
+
+	// Fixed rate worker loop
+	void RunFixedRate();
+
+	// Sleep until the given platform time (s), the last millisecond is spent yielding for accuracy
+	void WaitUntil(const double InTime) const;
+
+	// Sample the read snapshot at the given platform time (s) into the sampled snapshot
+	void SampleReadSnapshot(const double InTime);
+
+	// Publish the pending channel snapshots, and process the connection
+	void PublishSecondary();
+
+	// Publish the snapshot to the topic (one message per chunk)
+	void Publish(const FString& InTopic, const FTFSnapshot& InSnapshot);
+
+	// ROSBridge handler, owned by the worker while running
+	TSharedPtr<FROSBridgeHandler> ROSBridgeHandler;
+
+	// BSON client, owned by the worker while running
+	TSharedPtr<FTFBsonClient> BsonClient;
+
+	// Topic to publish to
+	FString Topic;
+
+	// Topic to publish the static snapshots to
+	FString StaticTopic;
+
+	// Snapshots buffers
+	FTFSnapshot Snapshots[3];
+
+	// Snapshot written by the game thread
+	FTFSnapshot* WriteSnapshot;
+
+	// Latest submitted snapshot waiting for the worker
+	FTFSnapshot* PendingSnapshot;
+
+	// Snapshot read by the worker
+	FTFSnapshot* ReadSnapshot;
+
+	// Flag marking a pending snapshot
+	bool bHasPendingSnapshot;
+
+	// Frames carried by the snapshot a replaced one is merged into
+	TBitArray<> MergeScratch;
+
+	// Ring of the queued chunks (the slots keep their allocations)
+	TArray<FTFSnapshot> ChunkQueue;
+
+	// Position of the oldest queued chunk
+	int32 ChunkQueueHead;
+
+	// Number of queued chunks
+	int32 ChunkQueueNum;
+
+	// Chunk read by the worker
+	FTFSnapshot ReadChunk;
+
+	// Static snapshot written by the game thread
+	FTFSnapshot PendingStaticSnapshot;
+
+	// Static snapshot read by the worker
+	FTFSnapshot ReadStaticSnapshot;
+
+	// Flag marking a pending static snapshot
+	bool bHasPendingStaticSnapshot;
+
+	// Number of snapshots submitted since the last take
+	int32 NumPendingSubmits;
+
+	// Maximal age (s) of the published snapshots (0 = no limit)
+	float MaxSnapshotAge;
+
+	// Send statistics since they were last consumed
+	FTFSendStats SendStats;
+
+	// Fixed publish rate (Hz, 0 = publish on submit)
+	float FixedRate;
+
+	// Blend the transforms between the two latest snapshots (fixed rate)
+	bool bInterpolate;
+
+	// Delay (s) of the sample time behind the publish time (fixed rate interpolation)
+	float InterpolationDelay;
+
+	// Snapshot read before the current one (fixed rate interpolation)
+	FTFSnapshot PrevSnapshot;
+
+	// Snapshot sampled from the read snapshots (fixed rate)
+	FTFSnapshot SampledSnapshot;
+
+	// Header sequence of the sampled snapshots
+	uint32 SampledSeq;
+
+	// Achieved rate (Hz) of the last second (fixed rate)
+	float AchievedRate;
+
+	// Jitter (ms) of the last second (fixed rate)
+	float JitterMs;
+
+	// Guards the fixed rate and send stats
+	mutable FCriticalSection StatsCriticalSection;
+
+	// Snapshot slots of the channels
+	TArray<FTFWorkerChannel> Channels;
+
+	// Guards the snapshot swaps
+	FCriticalSection SwapCriticalSection;
+
+	// Wakes the worker on a submit
+	FEvent* WakeEvent;
+
+	// Stop flag
+	FThreadSafeBool bStopping;
+
+	// Worker thread
+	FRunnableThread* Thread;
+};
@@ -9,8 +9,55 @@
 #include "ROSBridgePublisher.h"
 #include "TFNode.h"
 #include "TFTree.h"
+#include "TFPublishWorker.h"
+#include "TFSharedMemory.h"
 #include "TFPublisher.generated.h"
 
+// Forward declarations
+class FTFBsonClient;
+
+/**
+* Wire encoding of the tf messages
+*/
+UENUM()
+enum class ETFEncoding : uint8
+{
+	// rosbridge json text messages
+	JSON	UMETA(DisplayName = "JSON"),
+	// Binary BSON messages (rosbridge_server has to run in bson_only_mode)
+	BSON	UMETA(DisplayName = "BSON"),
+	// Quantized delta-encoded packets (std_msgs/UInt8MultiArray on /tf_compact, BSON transport),
+	// expanded back to tf messages by a ROS side relay
+	Compact	UMETA(DisplayName = "Compact"),
+};
+
+/**
+* Output channel publishing a subset of the frames on its own topic
+*/
+USTRUCT()
+struct FTFChannelSettings
+{
+	GENERATED_BODY()
+
+	// Default constructor
+	FTFChannelSettings() : PublishRate(0.f) {}
+
+	// Topic of the channel (e.g. /pr2/tf)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString Topic;
+
+	// Frame id of the subtree root, the root and its descendants are published (empty = every frame)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString SubtreeRootFrameId;
+
+	// Wildcard pattern (e.g. pr2_*) the published frame ids have to match (empty = every frame)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString FramePattern;
+
+	// Publish rate (Hz) of the channel (0 = on every publish)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.0"))
+	float PublishRate;
+};
 
 UCLASS()
 class UTFPUBLISHER_API ATFPublisher : public AActor
@@ -34,8 +81,20 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	// Add the object to the tree using its TF tag key value pairs (it waits under the root if its parent is missing)
 	void AddObject(UObject* InObject);
 
+	// Get the transform of the source frame relative to the target frame at the given world time (negative = newest),
+	// interpolated from the recorded transforms, returns false if a frame is unknown or the time is no longer recorded
+	bool LookupTransform(const FString& InTargetFrameId, const FString& InSourceFrameId, const float InWorldTime,
+		FTransform& OutTransform);
+
+	// Check if the frame is published by this publisher (subscribers skip it to avoid feedback loops)
+	bool PublishesFrame(const FString& InFrameId) const { return TFTree.FindNode(InFrameId) != nullptr; }
+
+	// Get the number of topology changes of the published tree (frames added later are published as well)
+	uint32 GetTopologyVersion() const { return TFTree.GetTopologyVersion(); }
+
 	// ROSBridge server IP
 	UPROPERTY(EditAnywhere, Category = TF)
 	FString ServerIP;
@@ -44,6 +103,22 @@ public:
 	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 0, ClampMax = 65535))
 	int32 ServerPORT;
 
+	// Wire encoding of the tf messages
+	UPROPERTY(EditAnywhere, Category = TF)
+	ETFEncoding Encoding;
+
+	// Quantization step (mm) of the translations (compact encoding)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.001"))
+	float CompactTranslationPrecision;
+
+	// Number of bits of the three smallest quaternion components (compact encoding)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 6, ClampMax = 20))
+	int32 CompactRotationBits;
+
+	// Delta time (s) between keyframes with absolute values and the frame ids (compact encoding, 0 = every publish)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.0"))
+	float CompactKeyframeInterval;
+
 	// TF root frame name (map, world etc.)
 	UPROPERTY(EditAnywhere, Category = TF)
 	FString TFRootFrameName;
@@ -53,6 +128,11 @@ public:
 	UPROPERTY(EditAnywhere, Category = TF)
 	bool bUseBlankRootNode;
 
+	// How the tf nodes are bound to the lifetime of their objects: an anchor component per node,
+	// or plain nodes removed when their actor ends play (no UObject per node, less garbage collection work)
+	UPROPERTY(EditAnywhere, Category = TF)
+	ETFNodeStorage NodeStorage;
+
 	// Choose between variable (various publish rates for the frames)
 	// or constant publish rates (all frames updated at the same time)
 	UPROPERTY(EditAnywhere, Category = TF)
@@ -62,28 +142,306 @@ public:
 	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseConstantPublishRate", ClampMin = "0.0"))
 	float ConstantPublishRate;
 
+	// Publish only the frames which moved more than the given thresholds since their last publish
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseDeltaPublishing;
+
+	// Minimal translation (cm) for a frame to be republished in delta mode
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseDeltaPublishing", ClampMin = "0.0"))
+	float DeltaTranslationEpsilon;
+
+	// Minimal rotation (degrees) for a frame to be republished in delta mode
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseDeltaPublishing", ClampMin = "0.0"))
+	float DeltaRotationEpsilon;
+
+	// Delta time (s) between full publishes of all frames in delta mode (keyframes for late joining listeners)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseDeltaPublishing", ClampMin = "0.0"))
+	float KeyframeInterval;
+
+	// Publish every frame on /tf (disable if the frames are only needed on the channels)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bPublishAllFrames;
+
+	// Channels publishing subsets of the frames on their own topics (their members are resolved on layout changes)
+	UPROPERTY(EditAnywhere, Category = TF)
+	TArray<FTFChannelSettings> Channels;
+
+	// Only publish the frames of this namespace (Namespace tag, frame ids are prefixed with ns/), empty = every frame
+	// (or only the frames without namespace when sharding)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString Namespace;
+
+	// Publish every namespace from its own shard publisher (own tree, connection, sequence and worker thread),
+	// this publisher keeps the frames without namespace
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bShardByNamespace;
+
+	// Publish the namespaced frames on the topics of their namespace (/ns/tf) instead of /tf
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseNamespaceTopics;
+
+	// Add the TF tagged actors (and their TF tagged components) spawned at runtime to the tree
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bTrackSpawnedActors;
+
+	// Parse the tags on a worker thread and create the nodes over the next frames instead of at BeginPlay,
+	// publishing starts with the partially built tree (a frame is published once its ancestors are created)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseAsyncBuild;
+
+	// Game thread time (ms) per frame for creating the nodes of the asynchronous build
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAsyncBuild", ClampMin = "0.1"))
+	float AsyncBuildFrameBudget;
+
+	// Cache the resolved tf topology of the level on disk (Saved/TFCache), the next runs bind the nodes to the objects
+	// directly while the tags of the level are unchanged
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseTopologyCache;
+
+	// Classify the frames as static (Static tag, static mobility, or unchanged over the invariance samples),
+	// static frames are published on /tf_static instead of /tf
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseStaticDetection;
+
+	// Number of consecutive unchanged publishes after which a frame becomes static (0 = only tags and mobility)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseStaticDetection", ClampMin = 0))
+	int32 StaticInvarianceSamples;
+
+	// Delta time (s) between checks of the static frames for motion (moved frames are published as dynamic again)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseStaticDetection", ClampMin = "0.0"))
+	float StaticCheckInterval;
+
+	// Delta time (s) between republishing the static frames for late joining listeners (0 = only on changes)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseStaticDetection", ClampMin = "0.0"))
+	float StaticRepublishInterval;
+
+	// Record the transforms of every frame on every publish for the in-engine lookups (LookupTransform)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseTransformBuffer;
+
+	// Number of recorded publishes kept for every frame
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseTransformBuffer", ClampMin = 1))
+	int32 TransformBufferSize;
+
+	// Maximal number of frames in a tf message, larger publishes are split along the subtrees (0 = unlimited)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 0))
+	int32 MaxTransformsPerMessage;
+
+	// Maximal estimated size (bytes) of a tf message, larger publishes are split along the subtrees (0 = unlimited)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 0))
+	int32 MaxMessageBytes;
+
+	// Publish the chunks of a split publish one per tick instead of all at once
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bSpreadChunksOverTicks;
+
+	// Gather the transforms and create the messages in parallel chunks
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseParallelGather;
+
+	// Minimal number of published frames for going parallel (smaller sets are gathered serially)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseParallelGather", ClampMin = 1))
+	int32 ParallelGatherMinNodes;
+
+	// Number of frames processed by one parallel task
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseParallelGather", ClampMin = 1))
+	int32 ParallelGatherChunkSize;
+
+	// Only copy the transforms on the game thread, create and publish the messages from a worker thread
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUsePipelinedPublishing;
+
+	// Publish the transforms from a dedicated thread at a fixed rate, decoupled from the tick
+	// (the tick, after physics, only copies the transforms of every dynamic frame)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseFixedRatePublishing;
+
+	// Rate (Hz) of the fixed rate publishing
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseFixedRatePublishing", ClampMin = "1.0"))
+	float FixedPublishRate;
+
+	// Blend the transforms between the two latest copies instead of repeating the latest one
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseFixedRatePublishing"))
+	bool bInterpolateFixedRate;
+
+	// Delay (s) of the published transforms behind the publish time when interpolating (at least one frame time)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseFixedRatePublishing", ClampMin = "0.0"))
+	float FixedRateInterpolationDelay;
+
+	// Get the achieved rate (Hz) and the jitter (ms) of the last second of the fixed rate publishing
+	// (returns false if fixed rate publishing is not running)
+	bool GetFixedRateStats(float& OutRate, float& OutJitterMs) const;
+
+	// Throttle the publishing on backpressure (slow send, coalesced or stale snapshots),
+	// forces delta publishing first, then lowers the rate (publishes from the worker thread)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseAdaptiveRate;
+
+	// Publish rate (Hz) without backpressure
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate", ClampMin = "0.1"))
+	float AdaptiveMaxRate;
+
+	// Lowest publish rate (Hz) under backpressure
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate", ClampMin = "0.1"))
+	float AdaptiveMinRate;
+
+	// Mean capture to send latency (ms) above which the publishing is throttled
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate", ClampMin = "0.0"))
+	float AdaptiveLatencyThreshold;
+
+	// Number of snapshots submitted between two sends above which the publishing is throttled
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate", ClampMin = "1"))
+	int32 AdaptiveQueueDepthThreshold;
+
+	// Force delta publishing before lowering the rate
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate"))
+	bool bAdaptiveDeltaMode;
+
+	// Snapshots older than this (ms) are dropped by the worker instead of sent (0 = never), partial (delta or multi-rate)
+	// snapshots are always sent since their frames count as published
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseAdaptiveRate", ClampMin = "0.0"))
+	float MaxSnapshotAge;
+
+	// Also write the snapshots of the frames (and of the static frames) into a named shared memory ring
+	// for the consumers on the same host (see FTFSharedMemoryReader)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bUseSharedMemory;
+
+	// Name of the shared memory region (shards append their namespace)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseSharedMemory"))
+	FString SharedMemoryName;
+
+	// Number of snapshots kept in the ring (a slow reader skips to the newest one)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseSharedMemory", ClampMin = 2))
+	int32 SharedMemorySlots;
+
+	// Maximal number of frames in a shared memory snapshot (the rest is dropped)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseSharedMemory", ClampMin = 1))
+	int32 SharedMemoryMaxFrames;
+
+	// Only write to the shared memory, no rosbridge connection (no channels, published from the game thread)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bUseSharedMemory"))
+	bool bSharedMemoryOnly;
+
+	// Get the decisions taken by the adaptive publish rate
+	const FTFAdaptiveCounters& GetAdaptiveCounters() const { return AdaptiveRate.GetCounters(); }
+
 private:
 	// Publish tf tree
 	void PublishTF();
 
+	// Publish tf tree as a snapshot (pipelined publishing, BSON encoding)
+	void PublishTFSnapshot(const FROSTime& InTime, const float InWorldTime, const FTFDeltaSettings* InDeltaSettings);
+
+	// Publish a chunk of the snapshot as a separate message
+	void PublishTFSnapshotChunk(const int32 InChunkIdx);
+
+	// Write the frames to the shared memory, a partial (delta or multi-rate) snapshot is replaced by a full copy
+	void WriteSharedMemory(const FTFSnapshot& InSnapshot, const FROSTime& InTime);
+
+	// Publish the static frames on /tf_static
+	void PublishStaticTF(const FROSTime& InTime, const float InWorldTime);
+
+	// Publish the snapshots of the due channels on their topics
+	void PublishChannels(const FROSTime& InTime, const float InWorldTime);
+
+	// Publish the json message with the rosbridge handler (the capture time (s) is used for the latency stats)
+	void PublishJsonMsg(const FString& InTopic, TSharedPtr<FROSBridgeMsg> InMsg, const double InCaptureTime);
+
+	// Let the rosbridge handler process its queues (game thread)
+	void ProcessROSBridge();
+
 	// Build tree
 	void BuildTFTree();
 
+	// Add the TF tagged spawned actor and its TF tagged components to the tree
+	void OnActorSpawned(AActor* InActor);
+
+	// Spawn the shard publishers of the namespaces of the tagged objects which have none yet
+	void SpawnShards(const TMap<UObject*, TMap<FString, FString>>& InObjectsToTagData);
+
+	// Spawn a shard publisher for the namespace (copy of the settings of this publisher)
+	void SpawnShard(const FString& InNamespace);
+
+	// Shard publishers of the namespaces
+	UPROPERTY(Transient)
+	TArray<ATFPublisher*> Shards;
+
+	// Namespaces with a shard publisher
+	TSet<FString> ShardNamespaces;
+
 	// ROSBridge handler for ROS connection
 	TSharedPtr<FROSBridgeHandler> ROSBridgeHandler;
 
 	// ROSPublisher for publishing TF
 	TSharedPtr<FROSBridgePublisher> TFPublisher;
 
+	// ROSPublisher for publishing the static TF
+	TSharedPtr<FROSBridgePublisher> TFStaticPublisher;
+
+	// ROSPublishers of the channels
+	TArray<TSharedPtr<FROSBridgePublisher>> ChannelPublishers;
+
+	// BSON client for publishing TF (BSON encoding)
+	TSharedPtr<FTFBsonClient> BsonClient;
+
+	// Writer of the snapshots into the shared memory ring
+	TSharedPtr<FTFSharedMemoryWriter> SharedMemoryWriter;
+
+	// Topic of the dynamic frames (depends on the encoding)
+	FString TFTopic;
+
+	// Topic of the static frames (depends on the encoding)
+	FString TFStaticTopic;
+
+	// Worker creating and publishing the messages (pipelined publishing)
+	TSharedPtr<FTFPublishWorker> PublishWorker;
+
+	// Throttles the publishing on backpressure
+	FTFAdaptiveRate AdaptiveRate;
+
 	// Publisher timer handle (in case of custom publish rate)
 	FTimerHandle TFPubTimer;
 
-	// TF root node
-	UTFNode* TFRootNode;
+	// Actor spawned handler handle
+	FDelegateHandle ActorSpawnedHandle;
 
 	// TF world tree
 	FTFTree TFTree;
 
 	// TF header message sequence
 	uint32 Seq;
+
+	// Snapshot written on the game thread (BSON encoding or chunks published from the game thread)
+	FTFSnapshot Snapshot;
+
+	// Next chunk of the snapshot to publish (INDEX_NONE if all chunks were published)
+	int32 NextChunkIdx;
+
+	// Snapshot of the static frames
+	FTFSnapshot StaticSnapshot;
+
+	// Full snapshot written to the shared memory when the published one is partial
+	FTFSnapshot SharedMemorySnapshot;
+
+	// Snapshot of the published channel
+	FTFSnapshot ChannelSnapshot;
+
+	// Time (s) of the last static frames publish
+	float LastStaticPublishTime;
+
+	// Static frames waiting to be published (changed, or not connected yet)
+	bool bStaticPublishPending;
+
+	// Static frames waiting to be written to the shared memory (changed, or new layout)
+	bool bStaticSharedMemoryPending;
+
+	// Topology version of the static frames in the shared memory
+	uint32 StaticSharedMemoryVersion;
+
+	// Time (s) of the last keyframe publish in delta mode
+	float LastKeyframeTime;
+
+	// Publish the frames at the rates from their PublishRate tags
+	bool bUseMultiRatePublishing;
 };
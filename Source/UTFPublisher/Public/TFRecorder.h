@@ -0,0 +1,71 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, LogTF
+#include "GameFramework/Actor.h"
+#include "TFNode.h"
+#include "TFTree.h"
+#include "TFLogWriter.h"
+#include "TFRecorder.generated.h"
+
+/**
+* ATFRecorder - Records the tf transforms of the TF tagged objects into a binary tf log (see FTFLog),
+* the samples are written by a background thread, the log can be replayed with UTFReplayComponent
+*/
+UCLASS()
+class UTFPUBLISHER_API ATFRecorder : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	ATFRecorder();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	// Called when destroyed or game stopped
+	virtual void EndPlay(const EEndPlayReason::Type Reason) override;
+
+public:
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	// Log file name in Saved/TFLogs (empty = date and time)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString FileName;
+
+	// TF root frame name (map, world etc.)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString TFRootFrameName;
+
+	// Delta time (s) between records (0 = on Tick)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.0"))
+	float RecordRate;
+
+	// Number of samples in a chunk of the log (the unit of the random access reads)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 1))
+	int32 SamplesPerChunk;
+
+private:
+	// Copy the transforms of every frame and queue them for writing
+	void Record();
+
+	// Writer of the log
+	TSharedPtr<FTFLogWriter> LogWriter;
+
+	// Record timer handle (in case of custom record rate)
+	FTimerHandle RecordTimer;
+
+	// TF world tree
+	FTFTree TFTree;
+
+	// Snapshot of the recorded transforms
+	FTFSnapshot Snapshot;
+
+	// Sample sequence
+	uint32 Seq;
+};
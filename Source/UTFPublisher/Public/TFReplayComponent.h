@@ -0,0 +1,120 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, LogTF
+#include "Components/ActorComponent.h"
+#include "ROSBridgeHandler.h"
+#include "ROSBridgePublisher.h"
+#include "TFLogReader.h"
+#include "TFReplayComponent.generated.h"
+
+/**
+* UTFReplayComponent - Replays a binary tf log (see ATFRecorder),
+* the frames drive the TF tagged objects with the same frame ids, and / or are republished on /tf
+*/
+UCLASS(ClassGroup = (TF), meta = (BlueprintSpawnableComponent))
+class UTFPUBLISHER_API UTFReplayComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UTFReplayComponent();
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when destroyed or game stopped
+	virtual void EndPlay(const EEndPlayReason::Type Reason) override;
+
+public:
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Jump to the log time (s) and apply the sample recorded at or before it
+	void Seek(const double InTime);
+
+	// Time (s) of the first sample of the log
+	double GetStartTime() const { return LogReader.GetStartTime(); }
+
+	// Time (s) of the last sample of the log
+	double GetEndTime() const { return LogReader.GetEndTime(); }
+
+	// Log file name in Saved/TFLogs (or absolute path)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString FileName;
+
+	// Move the TF tagged objects to their recorded transforms (the objects have to be movable)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bDriveActors;
+
+	// Republish the recorded transforms on /tf (stamped with the current time)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bRepublishTF;
+
+	// ROSBridge server IP
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bRepublishTF"))
+	FString ServerIP;
+
+	// ROSBridge server PORT
+	UPROPERTY(EditAnywhere, Category = TF, meta = (editcondition = "bRepublishTF", ClampMin = 0, ClampMax = 65535))
+	int32 ServerPORT;
+
+	// Replay speed (1 = recorded speed)
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.0"))
+	float PlaybackRate;
+
+	// Log time (s) offset from the first sample to start from
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = "0.0"))
+	float StartOffset;
+
+	// Restart from the beginning at the end of the log
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bLoop;
+
+private:
+	// Move the objects of the frames of the current sample to their world transforms
+	void DriveActors(const int32 InSchemaIdx);
+
+	// Find the TF tagged objects of the frames of the schema
+	void UpdateSchemaObjects(const int32 InSchemaIdx);
+
+	// Reader of the log
+	FTFLogReader LogReader;
+
+	// Current sample
+	FTFSnapshot Snapshot;
+
+	// Sample being read (swapped with the current sample once read and validated)
+	FTFSnapshot ReadSnapshot;
+
+	// Current log time (s)
+	double ReplayTime;
+
+	// Time (s) of the applied sample
+	double AppliedSampleTime;
+
+	// Frame id of the TF tagged objects (weak, the objects can be destroyed or streamed out)
+	TMap<FString, TWeakObjectPtr<UObject>> FrameIdToObject;
+
+	// Schema of the objects
+	int32 ObjectsSchemaIdx;
+
+	// Object of every frame of the schema (invalid if not in the world)
+	TArray<TWeakObjectPtr<UObject>> SchemaObjects;
+
+	// World transforms of the frames of the current sample
+	TArray<FTransform> WorldTransforms;
+
+	// Flags marking the frames with a world transform in the current sample
+	TBitArray<> WorldTransformFlags;
+
+	// ROSBridge handler for republishing
+	TSharedPtr<FROSBridgeHandler> ROSBridgeHandler;
+
+	// ROSPublisher for republishing TF
+	TSharedPtr<FROSBridgePublisher> TFPublisher;
+};
@@ -0,0 +1,267 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "HAL/PlatformMemory.h"
+#include "TFSnapshot.h"
+
+/**
+* Layout of the tf shared memory region (same host transport), little endian, fixed size:
+*
+*  header:  FTFShmHeader
+*  schema:  SchemaCapacity bytes, int32 num frames, int32 interned size, num frames x FTFShmFrame,
+*           interned null terminated UTF-8 frame ids
+*  static:  FTFShmSlot (StaticFlag), SlotCapacity x FTFShmTransform
+*  slots:   NumSlots x (FTFShmSlot, SlotCapacity x FTFShmTransform)
+*
+*  - single producer ring: the writer fills the slot WriteCount % NumSlots and then increments WriteCount,
+*    the newest snapshot is in the slot (WriteCount - 1) % NumSlots, every slot holds every dynamic frame
+*    (full snapshots, also with delta or multi-rate publishing), so a reader can skip to the newest one
+*  - the static frames (static detection) are not in the ring, they are latched in the static area, which is
+*    only rewritten when they change or are republished (a never written static area has a zero sequence)
+*  - the slots, the static area and the schema are guarded by sequence locks: the sequence is odd while written, a reader copies
+*    the data between two reads of an even, unchanged sequence, otherwise it retries (the writer never waits)
+*  - the transforms are in ROS coordinates (m, right handed), relative to the parent frame of the schema
+*  - a slot references the schema it was written with, the schema is rewritten when the tree layout changes
+*/
+struct FTFShmHeader
+{
+	// File magic ('TFSM')
+	uint32 Magic;
+
+	// Format version
+	uint32 Version;
+
+	// Number of slots in the ring
+	uint32 NumSlots;
+
+	// Maximal number of transforms in a slot
+	uint32 SlotCapacity;
+
+	// Size (bytes) of the schema area
+	uint32 SchemaCapacity;
+
+	// Sequence lock of the schema
+	volatile uint32 SchemaLock;
+
+	// Id of the schema in the schema area (0 = none)
+	volatile uint32 SchemaId;
+
+	// Padding
+	uint32 Reserved;
+
+	// Number of written slots
+	volatile int64 WriteCount;
+};
+
+/**
+* Frame ids of a layout node (offsets into the interned ids of the schema area)
+*/
+struct FTFShmFrame
+{
+	int32 FrameIdOffset;
+	int32 FrameIdLength;
+	int32 ParentFrameIdOffset;
+	int32 ParentFrameIdLength;
+};
+
+/**
+* Header of a slot
+*/
+struct FTFShmSlot
+{
+	// Sequence lock of the slot
+	volatile uint32 Lock;
+
+	// Id of the schema the slot was written with
+	uint32 SchemaId;
+
+	// Header sequence
+	uint32 Seq;
+
+	// Number of transforms
+	int32 NumTransforms;
+
+	// Stamp of the transforms
+	uint32 Secs;
+	uint32 NSecs;
+
+	// Slot flags
+	uint32 Flags;
+
+	// Padding
+	uint32 Reserved;
+
+	// Platform time (s) of the write (same host clock, hand-off latency)
+	double WriteTime;
+};
+
+/**
+* Transform of a layout node (ROS coordinates)
+*/
+struct FTFShmTransform
+{
+	// Layout index of the node in the schema
+	int32 FrameIdx;
+
+	// Translation x, y, z (m)
+	float Translation[3];
+
+	// Rotation x, y, z, w
+	float Rotation[4];
+};
+
+/**
+* FTFSharedMemoryWriter - Writes the snapshots into the ring of a named shared memory region (single producer)
+*/
+class UTFPUBLISHER_API FTFSharedMemoryWriter
+{
+public:
+	// File magic ('TFSM')
+	static const uint32 FileMagic = 0x4D534654;
+
+	// Format version
+	static const uint32 Version = 2;
+
+	// Flag of the static area
+	static const uint32 StaticFlag = 1;
+
+	// Default constructor
+	FTFSharedMemoryWriter();
+
+	// Destructor
+	~FTFSharedMemoryWriter();
+
+	// Create the named region with the given number of slots of the given capacity, returns false on failure
+	bool Open(const FString& InName, const int32 InNumSlots, const int32 InSlotCapacity);
+
+	// Unmap (and remove) the region
+	void Close();
+
+	// Check if the region is mapped
+	bool IsOpen() const { return Region != nullptr; }
+
+	// Write the snapshot into the next slot (the schema is rewritten if it changed),
+	// transforms beyond the slot capacity are dropped
+	void Write(const FTFSnapshot& InSnapshot);
+
+	// Rewrite the static area with the static frames (the schema is rewritten if it changed)
+	void WriteStatic(const FTFSnapshot& InSnapshot);
+
+	// Size (bytes) of a region with the given number of slots and capacity
+	static SIZE_T GetRegionSize(const int32 InNumSlots, const int32 InSlotCapacity);
+
+	// Size (bytes) of the schema area for the given slot capacity
+	static uint32 GetSchemaCapacity(const int32 InSlotCapacity);
+
+	// Size (bytes) of a slot with the given capacity
+	static SIZE_T GetSlotSize(const int32 InSlotCapacity);
+
+private:
+	// Rewrite the schema area if the layout of the snapshot changed, returns false if nothing can be written
+	bool UpdateSchema(const FTFSnapshot& InSnapshot);
+
+	// Write the frame ids of the schema into the schema area (the frames beyond its capacity are dropped)
+	void WriteSchema(const FTFFrameSchema& InSchema);
+
+	// Write the snapshot into the slot under its sequence lock, returns the number of written transforms
+	int32 WriteSlot(uint8* InSlotData, const FTFSnapshot& InSnapshot, const uint32 InFlags);
+
+	// Mapped region
+	FPlatformMemory::FSharedMemoryRegion* Region;
+
+	// Header of the region
+	FTFShmHeader* Header;
+
+	// Schema area
+	uint8* SchemaArea;
+
+	// Static area
+	uint8* StaticArea;
+
+	// First slot
+	uint8* Slots;
+
+	// Size (bytes) of a slot
+	SIZE_T SlotSize;
+
+	// Schema in the schema area
+	TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> WrittenSchema;
+
+	// Number of frames of the schema in the schema area
+	int32 NumSchemaFrames;
+
+	// Flag for warning once about the snapshots truncated to the slot capacity
+	bool bSlotTruncationWarned;
+
+	// Flag for warning once about the schemas truncated to the schema area
+	bool bSchemaTruncationWarned;
+};
+
+/**
+* FTFSharedMemoryReader - Reference reader of the tf shared memory region (any process on the same host)
+*/
+class UTFPUBLISHER_API FTFSharedMemoryReader
+{
+public:
+	// Default constructor
+	FTFSharedMemoryReader();
+
+	// Destructor
+	~FTFSharedMemoryReader();
+
+	// Map an existing region, returns false if it does not exist or is not a tf region
+	bool Open(const FString& InName);
+
+	// Unmap the region
+	void Close();
+
+	// Copy the newest slot into the snapshot (Unreal coordinates), returns false if there is no new consistent slot
+	bool ReadLatest(FTFSnapshot& OutSnapshot, uint32& OutFlags, double& OutWriteTime);
+
+	// Copy the static frames into the snapshot (Unreal coordinates), returns false if they were never written,
+	// are being written or reference an older schema
+	bool ReadStatic(FTFSnapshot& OutSnapshot, double& OutWriteTime);
+
+	// Number of slots written so far
+	int64 GetWriteCount() const;
+
+private:
+	// Copy the schema area if it changed, returns false if it is being written or empty
+	bool ReadSchema(const uint32 InSchemaId);
+
+	// Copy the slot into the snapshot and its header, returns false if it is being written or was overwritten while copied
+	bool CopySlot(const uint8* InSlotData, FTFSnapshot& OutSnapshot, FTFShmSlot& OutSlot) const;
+
+	// Bind the frame ids of the copied slot to the snapshot, returns false if the slot does not match the schema
+	bool BindSchema(const FTFShmSlot& InSlot, FTFSnapshot& OutSnapshot);
+
+	// Mapped region
+	FPlatformMemory::FSharedMemoryRegion* Region;
+
+	// Header of the region
+	const FTFShmHeader* Header;
+
+	// Schema area
+	const uint8* SchemaArea;
+
+	// Static area
+	const uint8* StaticArea;
+
+	// First slot
+	const uint8* Slots;
+
+	// Size (bytes) of a slot
+	SIZE_T SlotSize;
+
+	// Copied schema
+	TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> Schema;
+
+	// Id of the copied schema
+	uint32 SchemaId;
+
+	// Write count of the last read slot
+	int64 LastReadCount;
+};
@@ -0,0 +1,117 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "tf2_msgs/TFMessage.h"
+
+/**
+* FTFInternedId - UTF-8 frame id stored in the interned ids of a schema
+*/
+struct FTFInternedId
+{
+	// Offset of the first character
+	int32 Offset;
+
+	// Number of bytes (without the null terminator)
+	int32 Length;
+};
+
+/**
+* FTFFrameSchema - Frame ids of the nodes of a tree layout,
+* immutable and shared by every snapshot taken with the same layout
+*/
+struct UTFPUBLISHER_API FTFFrameSchema
+{
+	// Frame id of every layout node (tf child_frame_id)
+	TArray<FString> FrameIds;
+
+	// Frame id of the parent of every layout node (tf header frame_id)
+	TArray<FString> ParentFrameIds;
+
+	// Null terminated UTF-8 frame ids, every distinct id is stored once (encoders write them without conversions)
+	TArray<ANSICHAR> InternedIds;
+
+	// Interned frame id of every layout node
+	TArray<FTFInternedId> Utf8FrameIds;
+
+	// Interned parent frame id of every layout node
+	TArray<FTFInternedId> Utf8ParentFrameIds;
+
+	// Append the frame ids of a layout node (the ids already interned are looked up in the given map)
+	void AddFrame(const FString& InFrameId, const FString& InParentFrameId, TMap<FString, FTFInternedId>& InternedIdsMap);
+
+	// Get the UTF-8 characters of an interned id
+	const ANSICHAR* GetUtf8(const FTFInternedId& InId) const { return InternedIds.GetData() + InId.Offset; }
+
+private:
+	// Intern the frame id, returns the existing entry if it was already interned
+	FTFInternedId Intern(const FString& InFrameId, TMap<FString, FTFInternedId>& InternedIdsMap);
+};
+
+/**
+* FTFSnapshot - Raw tf transforms of the published nodes at a given time,
+* copied on the game thread, converted to ROS messages by a worker
+*/
+struct UTFPUBLISHER_API FTFSnapshot
+{
+	// Default constructor
+	FTFSnapshot() : CaptureTime(0.0), Seq(0), bPartial(false) {}
+
+	// Time of the snapshot
+	FROSTime Time;
+
+	// Platform time (s) when the transforms were copied (publish to send latency)
+	double CaptureTime;
+
+	// Header sequence
+	uint32 Seq;
+
+	// Only the changed or due frames were copied (delta or multi-rate), the copied frames count as published,
+	// so a replaced partial snapshot has to be merged into its successor instead of dropped
+	bool bPartial;
+
+	// Frame ids of the layout the snapshot was taken from
+	TSharedPtr<const FTFFrameSchema, ESPMode::ThreadSafe> Schema;
+
+	// Layout indices of the published nodes
+	TArray<int32> Indices;
+
+	// Tf transforms (Unreal coordinates) of the published nodes
+	TArray<FTransform> Transforms;
+
+	// End positions of the chunks published as separate messages (empty = a single chunk)
+	TArray<int32> ChunkEnds;
+
+	// Clear the transforms (keeps the allocations)
+	void Reset()
+	{
+		Indices.Reset();
+		Transforms.Reset();
+		ChunkEnds.Reset();
+	}
+
+	// Number of transforms in the snapshot
+	int32 Num() const { return Indices.Num(); }
+
+	// Number of chunks in the snapshot
+	int32 NumChunks() const { return ChunkEnds.Num() > 0 ? ChunkEnds.Num() : 1; }
+
+	// Get the [Start, End) positions of the chunk
+	void GetChunk(const int32 InChunkIdx, int32& OutStart, int32& OutEnd) const
+	{
+		OutStart = InChunkIdx > 0 ? ChunkEnds[InChunkIdx - 1] : 0;
+		OutEnd = ChunkEnds.Num() > 0 ? ChunkEnds[InChunkIdx] : Num();
+	}
+
+	// Append the frames of the older (replaced) snapshot this snapshot does not carry, every chunk of the older snapshot
+	// adds at most one chunk (the chunk limits hold), the layout indices are remapped by frame id if the layout changed
+	void MergeOlder(const FTFSnapshot& InOlder, TBitArray<>& CarriedScratch);
+
+	// Convert to a tf message
+	TSharedPtr<tf2_msgs::TFMessage> GetTFMessageMsg() const { return GetTFMessageMsg(0, Num()); }
+
+	// Convert the transforms in the [Start, End) positions to a tf message
+	TSharedPtr<tf2_msgs::TFMessage> GetTFMessageMsg(const int32 InStart, const int32 InEnd) const;
+};
@@ -0,0 +1,90 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "Stats/Stats.h"
+
+/**
+* TF pipeline stats, shown with `stat TF` and in the profiler of the session frontend
+*
+*  - cycle stats for every phase of the publish (game thread and publish worker)
+*  - per frame counters of the published nodes, messages and BSON bytes
+*  - cycle stats and counters of the subscriber (parse, apply, applied and skipped frames)
+*  - running totals of the dropped messages, coalesced and stale snapshots, the adaptive rate decisions, and a publish to send latency histogram
+*  - achieved rate and jitter of the fixed rate publishing
+*  - compiled out with the stats system (shipping builds)
+*/
+DECLARE_STATS_GROUP(TEXT("TF"), STATGROUP_TF, STATCAT_Advanced);
+
+/* Phases */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Publish"), STAT_TFPublish, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build"), STAT_TFBuild, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build - Tag Scan"), STAT_TFTagScan, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build - Resolve (async)"), STAT_TFBuildResolve, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build - Create Nodes (async)"), STAT_TFBuildNodes, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Remove Gone Nodes (arena)"), STAT_TFNodeSweep, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Layout"), STAT_TFUpdateLayout, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Gather Transforms"), STAT_TFGather, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Select Changed"), STAT_TFSelectChanged, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Static Nodes"), STAT_TFUpdateStatic, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build Messages"), STAT_TFBuildMessages, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Copy Snapshot"), STAT_TFCopySnapshot, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Record Transforms"), STAT_TFRecordTransforms, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Lookup Transform"), STAT_TFLookupTransform, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Serialize (BSON)"), STAT_TFSerializeBson, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Publish Msg (rosbridge json)"), STAT_TFPublishMsg, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ROSBridge Process"), STAT_TFProcess, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Subscribe - Parse (websocket thread)"), STAT_TFSubscribeParse, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Subscribe - Apply"), STAT_TFSubscribeApply, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Shared Memory - Write"), STAT_TFSharedMemoryWrite, STATGROUP_TF, UTFPUBLISHER_API);
+
+/* Per frame counters */
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Published Nodes"), STAT_TFPublishedNodes, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Published Messages"), STAT_TFPublishedMessages, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Serialized Bytes (BSON)"), STAT_TFSerializedBytes, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Subscribe - Applied Frames"), STAT_TFSubscribeApplied, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shared Memory - Written Bytes"), STAT_TFSharedMemoryBytes, STATGROUP_TF, UTFPUBLISHER_API);
+
+/* Running values */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Nodes"), STAT_TFNodes, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dropped Messages"), STAT_TFDroppedMessages, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Coalesced Snapshots"), STAT_TFCoalescedSnapshots, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Stale Snapshots"), STAT_TFStaleSnapshots, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Subscribe - Skipped Self Published"), STAT_TFSubscribeSkipped, STATGROUP_TF, UTFPUBLISHER_API);
+
+/* Adaptive publish rate decisions */
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Adaptive - Rate (Hz)"), STAT_TFAdaptiveRate, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Adaptive - Rate Decreases"), STAT_TFAdaptiveRateDecreases, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Adaptive - Rate Increases"), STAT_TFAdaptiveRateIncreases, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Adaptive - Delta Mode Enables"), STAT_TFAdaptiveDeltaEnables, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Adaptive - Delta Mode Disables"), STAT_TFAdaptiveDeltaDisables, STATGROUP_TF, UTFPUBLISHER_API);
+
+/* Fixed rate publishing (updated every second) */
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Fixed Rate - Achieved (Hz)"), STAT_TFFixedRate, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Fixed Rate - Jitter (ms)"), STAT_TFFixedRateJitter, STATGROUP_TF, UTFPUBLISHER_API);
+
+/* Publish to send latency */
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - Last (ms)"), STAT_TFLatencyLast, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - Under 1 ms"), STAT_TFLatencyUnder1ms, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - 1 to 5 ms"), STAT_TFLatency1To5ms, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - 5 to 20 ms"), STAT_TFLatency5To20ms, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - 20 to 100 ms"), STAT_TFLatency20To100ms, STATGROUP_TF, UTFPUBLISHER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Latency - Over 100 ms"), STAT_TFLatencyOver100ms, STATGROUP_TF, UTFPUBLISHER_API);
+
+#if STATS
+/**
+* FTFStats - Helpers for the stats which need more than a single stat macro
+*/
+struct UTFPUBLISHER_API FTFStats
+{
+	// Add the time (s) from taking the transforms to sending their message to the latency histogram
+	static void AddPublishLatency(const double InSeconds);
+};
+
+// Add the latency (s) of a sent message to the histogram (the argument is not evaluated without stats)
+#define TF_STAT_PUBLISH_LATENCY(Seconds) FTFStats::AddPublishLatency(Seconds)
+#else
+#define TF_STAT_PUBLISH_LATENCY(Seconds)
+#endif // STATS
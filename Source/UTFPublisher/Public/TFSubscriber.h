@@ -0,0 +1,174 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, LogTF
+#include "GameFramework/Actor.h"
+#include "ROSBridgeHandler.h"
+#include "ROSBridgeSubscriber.h"
+#include "ROSBridgeMsg.h"
+#include "TFTree.h"
+#include "TFSubscriber.generated.h"
+
+// Forward declaration
+class ATFSubscriber;
+
+/**
+* FTFReceivedMsg - Received tf message, converted to Unreal coordinates on the websocket thread
+*/
+class FTFReceivedMsg : public FROSBridgeMsg
+{
+public:
+	// Frame ids (without leading slash)
+	TArray<FString> FrameIds;
+
+	// Parent frame ids (without leading slash)
+	TArray<FString> ParentFrameIds;
+
+	// Tf transforms relative to the parents (Unreal coordinates)
+	TArray<FTransform> Transforms;
+};
+
+/**
+* FTFMessageSubscriber - Parses and converts the tf messages of a topic on the websocket thread,
+* and hands them over to the subscriber actor on the game thread (rosbridge process)
+*/
+class FTFMessageSubscriber : public FROSBridgeSubscriber
+{
+public:
+	// Constructor
+	FTFMessageSubscriber(const FString& InTopic, ATFSubscriber* InOwner);
+
+	// Parse the message and convert its transforms in one pass (websocket thread)
+	virtual TSharedPtr<FROSBridgeMsg> ParseMessage(TSharedPtr<FJsonObject> InJsonObject) const override;
+
+	// Hand the converted message over to the owner (game thread)
+	virtual void Callback(TSharedPtr<FROSBridgeMsg> InMsg) override;
+
+private:
+	// Subscriber actor
+	ATFSubscriber* Owner;
+};
+
+/**
+* FTFReceivedFrame - Newest received tf transform of a frame
+*/
+struct FTFReceivedFrame
+{
+	// Parent frame id
+	FString ParentFrameId;
+
+	// Tf transform relative to the parent (Unreal coordinates)
+	FTransform Transform;
+
+	// Published by a publisher of this world (ignored, it would feed back)
+	bool bSelfPublished;
+};
+
+/**
+* ATFSubscriber - Drives the TF tagged objects with the frames received on /tf (and /tf_static) from ROS,
+*
+*  - the objects are bound to their frame ids by an FTFTree built from their tags (arena storage)
+*  - the messages are parsed and converted on the websocket thread, the newest transform of every frame is kept
+*  - once per tick the updated frames (and their received descendants) are resolved into world transforms,
+*    parents first, and applied in one batched pass with teleport semantics
+*  - a chain of received frames ends at the root frame (world origin), or at a frame of the simulation (world transform
+*    of its object), frames published by a TFPublisher of the world are skipped to avoid feedback loops
+*/
+UCLASS()
+class UTFPUBLISHER_API ATFSubscriber : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	ATFSubscriber();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	// Called when destroyed or game stopped
+	virtual void EndPlay(const EEndPlayReason::Type Reason) override;
+
+public:
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	// Keep the newest transforms of the received frames (game thread)
+	void AddReceived(const FTFReceivedMsg& InMsg);
+
+	// ROSBridge server IP
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString ServerIP;
+
+	// ROSBridge server PORT
+	UPROPERTY(EditAnywhere, Category = TF, meta = (ClampMin = 0, ClampMax = 65535))
+	int32 ServerPORT;
+
+	// Topic of the tf messages
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString TFTopic;
+
+	// Subscribe to /tf_static as well
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bSubscribeStatic;
+
+	// TF root frame name (map, world etc.), placed at the world origin
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString TFRootFrameName;
+
+	// Only drive the objects of the namespace (Namespace tag), the received frame ids are prefixed with it (empty = no filter)
+	UPROPERTY(EditAnywhere, Category = TF)
+	FString Namespace;
+
+	// Skip the frames published by a TFPublisher of this world (avoids feedback loops)
+	UPROPERTY(EditAnywhere, Category = TF)
+	bool bSkipSelfPublished;
+
+private:
+	// Resolve the updated frames into world transforms and apply them to their objects
+	void ApplyReceived();
+
+	// Resolve the world transform of the received frame (memoized for the current pass), the frames of the chain
+	// which were updated are queued for applying, parents first; returns false if the chain does not reach
+	// the root or a frame of the simulation
+	bool ResolveWorldTransform(const FString& InFrameId);
+
+	// Check if a TFPublisher of this world publishes the frame
+	bool IsSelfPublished(const FString& InFrameId) const;
+
+	// Re-check the driven frames if the topology of a publisher of this world changed (async builds, spawned actors)
+	void UpdateSelfPublished();
+
+	// ROSBridge handler
+	TSharedPtr<FROSBridgeHandler> ROSBridgeHandler;
+
+	// Tree binding the frame ids to the tagged objects
+	FTFTree TFTree;
+
+	// Newest transform of every received frame
+	TMap<FString, FTFReceivedFrame> ReceivedFrames;
+
+	// Combined topology versions of the publishers of this world at the last check
+	uint32 PublishersVersion;
+
+	// Received children of every frame
+	TMap<FString, TArray<FString>> ReceivedChildren;
+
+	// Frames received since the last apply
+	TSet<FString> UpdatedFrameIds;
+
+	// World transforms resolved in the current pass
+	TMap<FString, FTransform> ResolvedWorldTransforms;
+
+	// Frames of the chain being resolved (child first)
+	TArray<const FString*> ResolveChain;
+
+	// Objects to apply in the current pass (parents first)
+	TArray<UObject*> ApplyObjects;
+
+	// World transforms to apply in the current pass
+	TArray<FTransform> ApplyTransforms;
+};
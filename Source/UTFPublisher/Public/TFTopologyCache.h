@@ -0,0 +1,43 @@
+// Copyright 2018, Institute for Artificial Intelligence - University of Bremen
+// Author: Andrei Haidu (http://haidu.eu)
+
+#pragma once
+
+#include "UTFPublisher.h" // CoreMinimal, TFLog
+#include "TFTree.h"
+
+/**
+* FTFTopologyCache - Resolved tf topology of a level, cached on disk (Saved/TFCache/<Map>[_<Namespace>].tftopo)
+*
+*  file:   uint32 file magic, uint32 version, uint64 tag hash, int32 num entries, entries in creation order
+*  entry:  FString level world name, FString object path (relative to the level world), uint8 binding (actor / component),
+*          FString namespace, FString child frame id, FString parent frame id, float publish rate, bool static, bool root child
+*
+*  - the tag hash covers the path and the tags of every tagged object, and the root and namespace of the tree
+*  - a cache with another hash or version, or with an object which is not found anymore, is ignored (full build)
+*/
+struct UTFPUBLISHER_API FTFTopologyCache
+{
+	// File magic ('TFTP')
+	static const uint32 FileMagic = 0x50544654;
+
+	// Format version
+	static const uint32 Version = 1;
+
+	// Bindings
+	static const uint8 ActorBinding = 0;
+	static const uint8 ComponentBinding = 1;
+
+	// Smallest serialized entry (five empty strings, binding, publish rate, two bools)
+	static const int64 MinEntrySize = 5 * sizeof(int32) + sizeof(uint8) + sizeof(float) + 2 * sizeof(uint32);
+
+	// Get the cache file path of the level (and namespace) of the world
+	static FString GetFilePath(UWorld* InWorld, const FString& InNamespace);
+
+	// Load the creation order if the cache matches the tag hash, the objects are found in the levels of the world,
+	// returns false if there is no matching cache
+	static bool Load(const FString& InFilePath, const uint64 InTagHash, UWorld* InWorld, TArray<FTFNodeBuildData>& OutBuildOrder);
+
+	// Save the creation order with the tag hash, returns false if an object is gone or the file could not be written
+	static bool Save(const FString& InFilePath, const uint64 InTagHash, const TArray<FTFNodeBuildData>& InBuildOrder);
+};
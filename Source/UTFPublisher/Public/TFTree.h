@@ -5,283 +5,665 @@
 
 #include "UTFPublisher.h" // CoreMinimal, TFLog
 #include "TFNode.h"
+#include "TFNodeArena.h"
+#include "TFSnapshot.h"
 #include "Tags.h"
+#include "Async/Future.h"
+#include "UObject/Class.h"
 #include "tf2_msgs/TFMessage.h"
 #include "TFTree.generated.h"
 
+/**
+* FTFNodeBuildData - Tag data of an object waiting to be added to the tree
+*/
+struct FTFNodeBuildData
+{
+	// Object the node will be attached to (weak, the asynchronous build creates the node frames later)
+	TWeakObjectPtr<UObject> Object;
+
+	// Namespace of the node (empty if not namespaced)
+	FString Namespace;
+
+	// Frame id of the node (prefixed with the namespace)
+	FString ChildFrameId;
+
+	// Frame id of the parent node (prefixed with the namespace, unless given as global with a leading slash)
+	FString ParentFrameId;
+
+	// Publish rate (Hz) of the node (0 = on every publish)
+	float PublishRate;
+
+	// Node marked as static
+	bool bStatic;
+
+	// Added as a root child regardless of its parent frame id (breaks a cycle)
+	bool bRootChild;
+};
+
+/**
+* FTFTaggedObject - Raw tags of an object, copied on the game thread for the asynchronous build
+*/
+struct FTFTaggedObject
+{
+	// Tagged object
+	TWeakObjectPtr<UObject> Object;
+
+	// Name of the object (default child frame id)
+	FName Name;
+
+	// Tags of the object (parsed on the worker thread)
+	TArray<FName> Tags;
+};
+
+/**
+* FTFAsyncBuild - State of an asynchronous tree build
+*/
+struct FTFAsyncBuild
+{
+	// Default constructor
+	FTFAsyncBuild() : NextIdx(0), StartTime(0.0), TagHash(0), bUseNamespaceFilter(false) {}
+
+	// Tagged objects of the world (game thread, before the task starts, empty if loaded from the cache)
+	TArray<FTFTaggedObject> TaggedObjects;
+
+	// Creation order resolved by the task, parents before their children
+	TArray<FTFNodeBuildData> BuildOrder;
+
+	// Frame ids of the creation order not created yet
+	TSet<FString> QueuedFrameIds;
+
+	// Next entry of the creation order
+	int32 NextIdx;
+
+	// Time (s) the build started at
+	double StartTime;
+
+	// Topology cache file to save once built (empty if loaded from it, or not cached)
+	FString CacheFilePath;
+
+	// Tag hash of the topology cache
+	uint64 TagHash;
+
+	// Root frame id of the tree (copied on the game thread, the task does not read the tree)
+	FString RootFrameId;
+
+	// Namespace of the added objects (copied on the game thread)
+	FString NamespaceFilter;
+
+	// Only add the objects of the filtered namespace (copied on the game thread)
+	bool bUseNamespaceFilter;
+
+	// Tag parsing and creation order task (the results are only read once it is ready)
+	TFuture<void> Task;
+};
+
+/**
+* FTFDeltaSettings - Thresholds for publishing only the changed frames
+*/
+struct FTFDeltaSettings
+{
+	// Minimal translation (cm) for a frame to be republished
+	float TranslationEpsilon;
+
+	// Minimal rotation (rad) for a frame to be republished
+	float RotationEpsilon;
+
+	// Publish every frame regardless of the thresholds
+	bool bKeyframe;
+};
+
+/**
+* FTFParallelSettings - Parallel gathering of the transforms
+*/
+struct FTFParallelSettings
+{
+	// Gather the transforms in parallel
+	bool bEnabled;
+
+	// Minimal number of gathered nodes for going parallel (smaller sets are gathered serially)
+	int32 MinNodes;
+
+	// Number of nodes processed by one parallel task
+	int32 ChunkSize;
+};
+
+/**
+* FTFStaticSettings - Detection of the static nodes (published on /tf_static instead of /tf)
+*/
+struct FTFStaticSettings
+{
+	// Classify the nodes as static (Static tag, static mobility, or unchanged over the invariance samples)
+	bool bEnabled;
+
+	// Number of consecutive unchanged publishes after which a node becomes static (0 = no invariance detection)
+	int32 InvarianceSamples;
+
+	// Tolerance for comparing the tf transforms of the static nodes
+	float Tolerance;
+
+	// Delta time (s) between checks of the static nodes for motion (moved nodes are promoted back to dynamic)
+	float CheckInterval;
+};
+
+/**
+* FTFChunkSettings - Splitting of large publishes into several messages
+*/
+struct FTFChunkSettings
+{
+	// Maximal number of transforms in a message (0 = unlimited)
+	int32 MaxTransforms;
+
+	// Maximal estimated size (bytes) of a message (0 = unlimited)
+	int32 MaxBytes;
+
+	// Check if the publishes are split
+	bool IsEnabled() const { return MaxTransforms > 0 || MaxBytes > 0; }
+};
+
+/**
+* FTFRateBucket - Nodes sharing the same publish rate
+*/
+struct FTFRateBucket
+{
+	// Publish rate (Hz) of the nodes in the bucket (0 = on every publish)
+	float PublishRate;
+
+	// World time (s) when the bucket is due again
+	float NextPublishTime;
+
+	// Layout indices of the nodes in the bucket
+	TArray<int32> Indices;
+
+	// Layout indices of the dynamic nodes in the bucket
+	TArray<int32> DynamicIndices;
+};
+
+/**
+* FTFChannel - Subset of the frames published on its own topic at its own rate,
+* the members are resolved into index lists when the layout is rebuilt
+*/
+struct FTFChannel
+{
+	// Topic of the channel
+	FString Topic;
+
+	// Frame id of the subtree root, the root and its descendants are members (empty = every frame)
+	FString SubtreeRootFrameId;
+
+	// Wildcard pattern (e.g. pr2_*) the member frame ids have to match (empty = every frame)
+	FString FramePattern;
+
+	// Publish rate (Hz) of the channel (0 = on every publish)
+	float PublishRate;
+
+	// World time (s) when the channel is due again
+	float NextPublishTime;
+
+	// Layout indices of the member nodes in order
+	TArray<int32> Indices;
+
+	// Layout indices of the dynamic member nodes in order
+	TArray<int32> DynamicIndices;
+};
+
+/**
+* FTFLookupPath - Nodes between two frames and their lowest common ancestor (cached per frame pair)
+*/
+struct FTFLookupPath
+{
+	// Nodes from the source frame up to the common ancestor (excluded)
+	TArray<FTFNode*> SourceChain;
+
+	// Nodes from the target frame up to the common ancestor (excluded)
+	TArray<FTFNode*> TargetChain;
+};
+
 /**
 * FTFTree - TF Tree
+*
+*  - nodes are linked as a tree (FTFNode parent / children), and indexed by their frame id
+*  - the nodes are plain structs pooled in the arena of the tree, they are removed with their object: by the UTFNode
+*    anchor component (component storage), or when their actor ends play or their object is gone (arena storage)
+*  - for publishing the tree is flattened into a depth first layout (parents before children),
+*    stored as contiguous arrays of parent indices, transform sources and transforms,
+*    the layout is lazily rebuilt after the topology changes
+*  - static nodes are left out of the selections, and only published with the static snapshot
+*  - the frame ids of the objects with a Namespace tag are prefixed (ns/frame_id), a tree can be restricted to one namespace
+*  - channels publish precomputed subsets of the layout (subtrees or frame id patterns) on their own topics
+*  - the tf transforms can be recorded into the time buffers of the nodes, and looked up between any two frames
+*  - the build can run asynchronously: the tags are parsed on a worker thread, the nodes are created over several frames,
+*    nodes waiting for a parent frame which is not created yet are left out of the layout
 */
 USTRUCT()
 struct UTFPUBLISHER_API FTFTree
 {
 	GENERATED_BODY()
 
-	// Array of all nodes in the tree (used for convenient iteration)
-	TArray<UTFNode*> TFNodes;
+	// Array of all nodes in the tree (used for convenient iteration, every node knows its slot)
+	TArray<FTFNode*> TFNodes;
+
+	// Default constructor
+	FTFTree();
 
 	// Destructor
-	~FTFTree()
-	{
-		Empty();
-	}
+	~FTFTree();
 
-	// Init with a blank root (root will be ignored in the array)
-	void Init(UTFNode* InRootNode)
-	{
-		Root = InRootNode;
-		// If root is not blank, add to nodes array
-		if (!InRootNode->IsBlank())
-		{
-			TFNodes.Emplace(Root);
-		}
-	}
+	// Not copyable, the nodes are owned by the arena of the tree
+	FTFTree(const FTFTree&) = delete;
+	FTFTree& operator=(const FTFTree&) = delete;
 
-	// Build tree from world
-	bool Build(UWorld* InWorld)
-	{
-		if (Root == nullptr)
-		{
-			// Tree is not initialized
-			return false;
-		}
+	// Init with the root frame, blank if no object is given (a blank root will be ignored in the array)
+	void Init(const FString& InRootFrameId, UObject* InRootObject = nullptr);
 
-		// Get all objects with TF tags
-		auto ObjToTagData = FTags::GetObjectKeyValuePairsMap(InWorld, TEXT("TF"));
+	// Set how the nodes are bound to the lifetime of their objects (call before Init)
+	void SetNodeStorage(const ETFNodeStorage InNodeStorage) { NodeStorage = InNodeStorage; }
 
-		// Add initial root child nodes (nodes with no parent frame id, or the parent frame id equals the one from the root node)
-		AddRootChildNodes(&ObjToTagData);
+	// Get how the nodes are bound to the lifetime of their objects
+	ETFNodeStorage GetNodeStorage() const { return NodeStorage; }
 
-		// Search and add child nodes (O n^2 complexity)
-		AddChildNodes(&ObjToTagData);
+	// Get the node arena
+	const FTFNodeArena& GetNodeArena() const { return *NodeArena; }
 
-		// Add orphan nodes as new root trees
-		AddOrphanNodes(&ObjToTagData);
+	// Empty tree (the nodes and their anchors are destroyed, Init has to be called again)
+	void Empty();
 
-		return true;
-	}
+	// Build tree from world
+	bool Build(UWorld* InWorld);
+
+	// Build tree from the topology cache file if it matches the tags of the world, otherwise build it from the tags
+	// and save the cache
+	bool BuildCached(UWorld* InWorld, const FString& InCacheFilePath);
+
+	// Start building the tree from the world in the background: the tags are parsed and the creation order is resolved
+	// on a worker thread (unless the topology cache file matches), the nodes are then created by UpdateAsyncBuild
+	bool BeginAsyncBuild(UWorld* InWorld, const FString& InCacheFilePath = FString());
+
+	// Create the nodes of the asynchronous build within the time budget (s), returns true once the build is complete
+	bool UpdateAsyncBuild(const double InTimeBudget);
+
+	// Check if an asynchronous build is in progress
+	bool IsBuilding() const { return AsyncBuild.IsValid(); }
 
 	// Add node (if bAddAsOrphanIfParentNotFound is true, add node as a root child node if the parent was not found)
-	bool AddNode(const FString& InChildFrameId, UObject* InAttachedObject, const FString& InParentFrameId, bool bAddAsOrphanIfParentNotFound = false)
-	{
-		// Check if parent in the tree
-		if (UTFNode* FoundNode = FindNode(InParentFrameId))
-		{
-			// Create new node, and attach it to object (lifetime bound to the object now)
-			UTFNode* NewTFNode = NewObject<UTFNode>(InAttachedObject);
-			NewTFNode->RegisterComponent();
-			NewTFNode->Init(InChildFrameId, this, InAttachedObject);
-			FoundNode->AddChild(NewTFNode);
-			NewTFNode->BindTransformFunction();
-
-			// Add to array
-			TFNodes.Emplace(NewTFNode);
-
-			// Node added
-			return true;
-		}
-		else if (bAddAsOrphanIfParentNotFound)
-		{
-			// Add orphan node as a root child
-			return AddRootChildNode(InChildFrameId, InAttachedObject);
-		}
-		return false;
-	}
+	bool AddNode(const FString& InChildFrameId, UObject* InAttachedObject, const FString& InParentFrameId,
+		bool bAddAsOrphanIfParentNotFound = false, float InPublishRate = 0.f, bool bInStatic = false);
 
-	// Find node
-	UTFNode* FindNode(const FString& InFrameId)
-	{
-		if (Root == nullptr)
-		{
-			return nullptr; // Tree is empty
-		}
+	// Add a tagged object (at runtime), the node waits under the root if its parent frame is not in the tree yet
+	bool AddObject(UObject* InObject, const TMap<FString, FString>& InTagData);
 
-		if (Root->GetFrameId().Equals(InFrameId))
-		{
-			return Root;
-		}
-		else
-		{
-			TArray<UTFNode*> Stack;
-			Stack.Push(Root);
-
-			while (Stack.Num() > 0)
-			{
-				UTFNode* CurrNode = Stack.Pop();
-				if (CurrNode->GetFrameId().Equals(InFrameId))
-				{
-					return CurrNode;
-				}
-				for (const auto& ChildItr : CurrNode->GetChildren())
-				{
-					Stack.Push(ChildItr);
-				}
-			}
-			return nullptr; // Node not found
-		}
-	}
+	// Only add the objects of the given namespace (empty = the objects without namespace), call before building
+	void SetNamespaceFilter(const FString& InNamespace);
+
+	// Check if the object with the given tag key value pairs belongs to the tree namespace
+	bool IsInNamespace(const TMap<FString, FString>& InTagData) const;
+
+	// Check if the object with the given tag key value pairs belongs to the namespace (any thread)
+	static bool IsInNamespace(const TMap<FString, FString>& InTagData, const bool bInUseNamespaceFilter, const FString& InNamespaceFilter);
+
+	// Get the namespace of a tagged object (Namespace tag value without slashes, empty if missing)
+	static FString GetNamespace(const TMap<FString, FString>& InTagData);
+
+	// Find node (O(1) lookup in the frame id index)
+	FTFNode* FindNode(const FString& InFrameId) const;
+
+	// Get the number of topology changes (nodes added, removed or reparented) so far
+	uint32 GetTopologyVersion() const { return TopologyVersion; }
 
 	// Add root child node (add child node directly to the root)
-	bool AddRootChildNode(const FString& InChildFrameId, UObject* InAttachedObject)
-	{
-		if (Root)
-		{
-			// Create new node, and attach it to object (lifetime bound to the object now)
-			UTFNode* NewTFNode = NewObject<UTFNode>(InAttachedObject);
-			NewTFNode->RegisterComponent();
-			NewTFNode->Init(InChildFrameId, this, InAttachedObject);
-			Root->AddChild(NewTFNode);
-			NewTFNode->BindTransformFunction();
-
-			// Add to array
-			TFNodes.Emplace(NewTFNode);
-
-			// Root child node added
-			return true;
-		}
-		return false; // Tree not initialized
-	}
+	bool AddRootChildNode(const FString& InChildFrameId, UObject* InAttachedObject, float InPublishRate = 0.f,
+		bool bInStatic = false);
 
-	// Remove node
-	void RemoveNode(UTFNode* InNode)
-	{
-		if (InNode->IsRoot())
-		{
-			// Empty tree
-			Empty();
-		}
-		else
-		{
-			// Remove linking to parent, link children to parent
-			InNode->Clear();
-			// Remove node from tree array
-			TFNodes.Remove(InNode);
-		}
-	}
+	// Remove node (O(1) swap removal, its children are linked to its parent and wait for its frame id to return),
+	// the node is freed
+	void RemoveNode(FTFNode* InNode);
+
+	// Remove the nodes attached to the actor or its components (arena storage, the actor ends play)
+	void RemoveActorNodes(AActor* InActor);
+
+	// Remove the nodes whose object is gone (arena storage, components destroyed without their actor)
+	void RemoveGoneNodes();
+
+	// Set the parallel gathering settings
+	void SetParallelSettings(const FTFParallelSettings& InParallelSettings) { ParallelSettings = InParallelSettings; }
+
+	// Set the message chunking settings (applied to the snapshots)
+	void SetChunkSettings(const FTFChunkSettings& InChunkSettings) { ChunkSettings = InChunkSettings; }
+
+	// Set the static nodes detection settings (call before publishing)
+	void SetStaticSettings(const FTFStaticSettings& InStaticSettings);
 
 	// Get tf message
-	TSharedPtr<tf2_msgs::TFMessage> GetTFMessageMsg(const FROSTime& InTime, const uint32 InSeq = 0)
-	{
-		// Create TFMessage
-		TSharedPtr<tf2_msgs::TFMessage> TFMsgPtr =
-			MakeShareable(new tf2_msgs::TFMessage());
-		for (const auto& NodeItr : TFNodes)
-		{
-			TFMsgPtr->AddTransform(NodeItr->GetTransformStampedMsg(InTime, InSeq));
-		}
-		return TFMsgPtr;
-	}
+	TSharedPtr<tf2_msgs::TFMessage> GetTFMessageMsg(const FROSTime& InTime, const uint32 InSeq = 0);
+
+	// Get tf message with only the frames which moved more than the given thresholds since their last publish
+	// (on keyframes every frame is added), returns nullptr if no frame changed
+	TSharedPtr<tf2_msgs::TFMessage> GetDeltaTFMessageMsg(const FROSTime& InTime, const uint32 InSeq,
+		const FTFDeltaSettings& InDeltaSettings);
+
+	// Get tf message with only the nodes of the rate buckets due at the given world time
+	// (delta thresholds are applied to the due nodes if given), returns nullptr if there is nothing to publish
+	TSharedPtr<tf2_msgs::TFMessage> GetMultiRateTFMessageMsg(const FROSTime& InTime, const uint32 InSeq,
+		const float InWorldTime, const FTFDeltaSettings* InDeltaSettings = nullptr);
+
+	// Copy the raw tf transforms of the nodes to publish into the snapshot (selected as for the messages above),
+	// if chunking is enabled the transforms are sorted in layout order and split into chunks along the subtrees,
+	// returns false if there is nothing to publish
+	bool GetSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq,
+		const float InWorldTime, const FTFDeltaSettings* InDeltaSettings, const bool bInMultiRate);
+
+	// Add a channel publishing the frames of the subtree and / or matching the pattern, returns its index
+	int32 AddChannel(const FString& InTopic, const FString& InSubtreeRootFrameId, const FString& InFramePattern,
+		const float InPublishRate);
+
+	// Number of channels
+	int32 NumChannels() const { return Channels.Num(); }
+
+	// Get the channel
+	const FTFChannel& GetChannel(const int32 InChannelIdx) const { return Channels[InChannelIdx]; }
+
+	// Copy the tf transforms of the dynamic members of the channel into the snapshot if the channel is due
+	// at the given world time (split into chunks as the other snapshots), returns false if there is nothing to publish
+	bool GetChannelSnapshot(const int32 InChannelIdx, FTFSnapshot& OutSnapshot, const FROSTime& InTime,
+		const uint32 InSeq, const float InWorldTime);
+
+	// Check the static nodes for motion (at the check interval) and promote the moved ones back to dynamic,
+	// returns true if the static nodes changed since the last call (the static snapshot has to be republished)
+	bool UpdateStaticNodes(const float InWorldTime);
+
+	// Copy the tf transforms of every dynamic node into the snapshot (no delta, rate or invariance bookkeeping,
+	// the published state of the nodes is left unchanged), returns false if there are no dynamic nodes
+	bool GetDynamicSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq);
+
+	// Copy the tf transforms of the static nodes into the snapshot, returns false if there are no static nodes
+	bool GetStaticSnapshot(FTFSnapshot& OutSnapshot, const FROSTime& InTime, const uint32 InSeq);
+
+	// Set the number of tf transforms kept in the time buffer of every node (0 = no recording)
+	void SetBufferCapacity(const int32 InBufferCapacity) { BufferCapacity = FMath::Max(InBufferCapacity, 0); }
+
+	// Record the current tf transforms of all nodes into their time buffers
+	void RecordTransforms(const float InWorldTime);
+
+	// Get the transform of the source frame relative to the target frame at the given world time (negative = newest),
+	// interpolated from the time buffers, returns false if a frame is unknown or the time is no longer buffered
+	bool LookupTransform(const FString& InTargetFrameId, const FString& InSourceFrameId, const float InWorldTime,
+		FTransform& OutTransform);
 
 private:
-	//  Add root child nodes (nodes that have no parent frame id, or the parent frame id equals to the root frame id)
-	void AddRootChildNodes(TMap<UObject*, TMap<FString, FString>>* ObjectsToTagData)
-	{
-		// Iterate map and add initial root nodes
-		for (auto MapItr(ObjectsToTagData->CreateIterator()); MapItr; ++MapItr)
-		{
-			// Set default values to child frame
-			FString ChildFrameId = MapItr->Key->GetName();
-			// Set child frame id from tag
-			if (MapItr->Value.Contains(TEXT("ChildFrameId")))
-			{
-				ChildFrameId = MapItr->Value["ChildFrameId"];
-			}
-
-			// Check for parent frame id
-			if (MapItr->Value.Contains(TEXT("ParentFrameId")))
-			{
-				// If parent frame id equals the root node frame
-				if (MapItr->Value["ParentFrameId"].Equals(Root->GetFrameId()))
-				{
-					// Add as root child node
-					AddRootChildNode(ChildFrameId, MapItr->Key);
-					// Remove element from map
-					MapItr.RemoveCurrent();
-				}
-			}
-			else
-			{
-				// Missing parent frame id default as root child node
-				AddRootChildNode(ChildFrameId, MapItr->Key);
-				// Remove element from map
-				MapItr.RemoveCurrent();
-			}
-		}
-	}
+	// Create a new node, attach it to the object and to the parent node, and add it to the index
+	FTFNode* CreateNode(const FString& InChildFrameId, UObject* InAttachedObject, FTFNode* InParentNode,
+		float InPublishRate = 0.f, bool bInStatic = false);
 
-	// Search and add child nodes (O n^2 complexity)
-	void AddChildNodes(TMap<UObject*, TMap<FString, FString>>* ObjectsToTagData)
-	{
-		// Try adding objects to the tree until no more objects in the map
-		// and the map size has shrinked
-		bool bMapShrinked = true;
-		while (ObjectsToTagData->Num() > 0 && bMapShrinked)
-		{
-			int32 MapSize = ObjectsToTagData->Num();
-			// Iterate map and try adding objects to tree
-			for (auto MapItr(ObjectsToTagData->CreateIterator()); MapItr; ++MapItr)
-			{
-				// Add default value to the child frame id
-				FString ChildFrameId = MapItr->Key->GetName();
-				// If available, set child frame id from tag
-				if (MapItr->Value.Contains(TEXT("ChildFrameId")))
-				{
-					ChildFrameId = MapItr->Value["ChildFrameId"];
-				}
-
-				// If node has a parent frame id, try adding it to the tree
-				if (MapItr->Value.Contains(TEXT("ParentFrameId")))
-				{
-					// If parent is already in tree, add node
-					if (AddNode(ChildFrameId, MapItr->Key, MapItr->Value["ParentFrameId"]))
-					{
-						// Remove element from map
-						MapItr.RemoveCurrent();
-					}
-				}
-			}
-
-			// Check if the map size has shrinked
-			if (MapSize == ObjectsToTagData->Num())
-			{
-				bMapShrinked = false;
-			}
-		}
-	}
+	// Create the build data of an object from its tag key value pairs (missing parent frame ids default to the root frame id)
+	static FTFNodeBuildData MakeBuildData(UObject* InObject, const FName InObjectName, const TMap<FString, FString>& InTagData,
+		const FString& InRootFrameId);
+
+	// Create the node of the build data (waits under the root if its parent is not in the tree)
+	bool AddBuildData(const FTFNodeBuildData& InNodeData);
+
+	// Copy the raw tags of the TF tagged actors and scene components of the world (game thread),
+	// returns the hash of their paths and tags and of the tree root and namespace if requested (topology cache)
+	uint64 GatherTaggedObjects(UWorld* InWorld, TArray<FTFTaggedObject>& OutTaggedObjects, const bool bInHash) const;
+
+	// Parse the tags of the objects of the namespace and resolve their creation order (any thread)
+	static void ResolveTaggedObjects(const TArray<FTFTaggedObject>& InTaggedObjects, const FString& InRootFrameId,
+		const bool bInUseNamespaceFilter, const FString& InNamespaceFilter, TArray<FTFNodeBuildData>& OutBuildOrder);
+
+	// Resolve the creation order of the asynchronous build if not loaded from the cache (worker thread, only reads the build state)
+	static void ResolveAsyncBuild(FTFAsyncBuild& OutAsyncBuild);
 
-	// Add orphan nodes as new root trees
-	void AddOrphanNodes(TMap<UObject*, TMap<FString, FString>>* ObjectsToTagData)
+	// Check if the node waits for a parent frame which the asynchronous build did not create yet
+	FORCEINLINE bool IsWaitingForBuild(const FTFNode* InNode) const
 	{
-		// Iterate map and add initial root nodes
-		for (auto MapItr(ObjectsToTagData->CreateIterator()); MapItr; ++MapItr)
-		{
-			// Set default values to child frame
-			FString ChildFrameId = MapItr->Key->GetName();
-			// If available, set child frame id from tag
-			if (MapItr->Value.Contains(TEXT("ChildFrameId")))
-			{
-				ChildFrameId = MapItr->Value["ChildFrameId"];
-			}
-
-			// Add orphan as a root child node
-			AddRootChildNode(ChildFrameId, MapItr->Key);
-			// Remove element from map
-			MapItr.RemoveCurrent();
-		}
+		return AsyncBuild.IsValid() && !InNode->GetPendingParentFrameId().IsEmpty() &&
+			(!AsyncBuild->Task.IsReady() || AsyncBuild->QueuedFrameIds.Contains(InNode->GetPendingParentFrameId()));
 	}
 
+	// Register the node as waiting for the parent frame id
+	void AddPendingChild(FTFNode* InNode, const FString& InParentFrameId);
+
+	// Remove the node from the nodes waiting for a parent
+	void RemovePendingChild(FTFNode* InNode);
+
+	// Move the nodes waiting for the frame id of the new node below it (nodes which would form a cycle are skipped)
+	void AttachPendingChildren(FTFNode* InParentNode);
+
+	// Group the tagged objects by their parent frame id (nodes without parent frame id are grouped under the root)
+	void GroupByParentFrameId(const TMap<UObject*, TMap<FString, FString>>& InObjectsToTagData,
+		TMap<FString, TArray<FTFNodeBuildData>>& OutParentFrameIdToChildren) const;
+
+	// Resolve the creation order of the grouped objects, parents before their children
+	// (the nodes reachable from the root first, then the orphans and the cycles as new root trees)
+	static void ResolveBuildOrder(const FString& InRootFrameId, TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+		TArray<FTFNodeBuildData>& OutBuildOrder);
+
+	// Append the waiting children of the given frame, and recursively theirs, in breadth first order
+	// (every waiting object is visited once, the group is removed from the map when appended)
+	static void AppendChildrenBreadthFirst(const FString& InFrameId, TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+		TArray<FTFNodeBuildData>& OutBuildOrder);
+
+	// Append the orphan nodes (and the nodes forming cycles) as new root trees, their subtrees are kept
+	static void AppendOrphanNodes(TMap<FString, TArray<FTFNodeBuildData>>& ParentFrameIdToChildren,
+		TArray<FTFNodeBuildData>& OutBuildOrder);
+
+	// Rebuild the flattened layout and the rate buckets if the topology changed
+	void UpdateLayout();
+
+	// Rebuild the dynamic and static index lists if the static nodes changed
+	void UpdateStaticSelection();
+
+	// Resolve the members of the channels in the current layout
+	void ResolveChannels();
+
+	// Check if the node should start as static (Static tag, or static mobility of itself and its parent)
+	bool IsInitiallyStatic(const int32 InIndex) const;
+
+	// Count the unchanged publishes of the given dynamic nodes, and classify the invariant ones as static
+	void DetectInvariantNodes(const TArray<int32>& InIndices);
+
+	// Split the nodes (in layout order) into chunks within the limits, the subtrees of the root children are kept
+	// in one chunk if they fit, otherwise they are split
+	void SplitIntoChunks(const TArray<int32>& InSortedIndices, TArray<int32>& OutChunkEnds) const;
+
+	// Select the nodes to publish (all or the due rate buckets, optionally only the changed ones) and gather
+	// their transforms, returns their layout indices (valid until the next call)
+	const TArray<int32>& SelectAndGather(const float InWorldTime, const FTFDeltaSettings* InDeltaSettings, const bool bInMultiRate);
 
-	// Empty tree
-	void Empty()
+	// Read the world transforms of all nodes, then compute their tf transforms in one linear pass
+	void GatherAllTransforms();
+
+	// Read the world transforms of the given nodes and their parents (once each), then compute their tf transforms
+	void GatherTransforms(const TArray<int32>& InIndices);
+
+	// Run the body over the [Start, End) ranges of the chunks of the given number of items,
+	// in parallel if enabled and there are enough items, otherwise in a single serial call
+	void ForEachChunk(const int32 InNum, TFunctionRef<void(int32, int32)> Body) const;
+
+	// Read the world transform of the node if it was not read in the current gather pass
+	FORCEINLINE void ReadWorldTransform(const int32 InIndex)
 	{
-		for (auto TFNodeItr : TFNodes)
+		if (WorldTransformStamps[InIndex] != GatherStamp)
 		{
-			// Destroy node component
-			TFNodeItr->DestroyComponent();
+			WorldTransformStamps[InIndex] = GatherStamp;
+			WorldTransforms[InIndex] = Sources[InIndex] ? Sources[InIndex]->GetComponentTransform() : FTransform::Identity;
 		}
-		TFNodes.Empty();
 	}
 
+	// Add the gathered transforms of the given nodes to the message, in the order of the indices
+	// (the message is created on the first node)
+	void AddTransforms(const TArray<int32>& InIndices, const FROSTime& InTime, const uint32 InSeq,
+		TSharedPtr<tf2_msgs::TFMessage>& OutTFMsgPtr);
+
+	// Select the nodes which moved more than the thresholds since their last publish into the changed indices,
+	// and remember their transforms as published
+	void SelectChanged(const TArray<int32>& InIndices, const FTFDeltaSettings& InDeltaSettings);
+
+	// Get the cached path between the frames, it is created on the first lookup (nullptr if a frame is unknown)
+	const FTFLookupPath* FindLookupPath(const FString& InTargetFrameId, const FString& InSourceFrameId);
+
+	// Compose the buffered tf transforms of the chain (transform of its first node relative to the end of the chain)
+	bool ComposeChain(const TArray<FTFNode*>& InChain, const float InWorldTime, FTransform& OutTransform) const;
+
+	// Flag the layout for rebuilding and drop the cached lookup paths (once at the end of the build slice while one runs)
+	void MarkTopologyChanged();
+
+	// Track the node with the nodes of its actor, the actor ending play removes them (arena storage)
+	void TrackActorNode(FTFNode* InNode);
+
+	// Stop tracking the node with the nodes of its actor (arena storage)
+	void UntrackActorNode(FTFNode* InNode);
+
 	// Root node
-	UTFNode* Root;
+	FTFNode* Root;
+
+	// How the nodes are bound to the lifetime of their objects
+	ETFNodeStorage NodeStorage;
+
+	// Storage of the nodes (owned, the tree is not copyable)
+	TUniquePtr<FTFNodeArena> NodeArena;
+
+	// Forwards the end play of the tracked actors (arena storage, rooted)
+	UTFNodeListener* NodeListener;
+
+	// Nodes of the tracked actors (arena storage)
+	TMap<FObjectKey, TArray<FTFNode*>> ActorNodes;
+
+	// Pre garbage collection handle, the gone nodes are removed before their objects are freed (arena storage)
+	FDelegateHandle PreGarbageCollectHandle;
+
+	// Frame of the last gone nodes sweep (arena storage)
+	uint64 SweepFrame;
+
+	// Namespace of the added objects (if filtered)
+	FString NamespaceFilter;
+
+	// Only add the objects of the filtered namespace
+	bool bUseNamespaceFilter;
+
+	// Frame id to node index (O(1) lookup)
+	TMap<FString, FTFNode*> FrameIdToNode;
+
+	// Nodes attached to the root while waiting for their parent frame id to be added
+	TMap<FString, TArray<FTFNode*>> PendingChildren;
+
+	// Nodes grouped by their publish rate
+	TArray<FTFRateBucket> RateBuckets;
+
+	// Flag for rebuilding the layout before the next publish
+	bool bLayoutDirty;
+
+	// Number of topology changes
+	uint32 TopologyVersion;
+
+	// Collect the topology changes of the asynchronous build slice, they are marked once when it ends
+	bool bDeferTopologyChanges;
+
+	// A topology change was collected during the build slice
+	bool bTopologyChangeDeferred;
+
+	/* Flattened layout (depth first, parents before children) */
+	// Nodes
+	TArray<FTFNode*> LayoutNodes;
+
+	// Index of the parent node (INDEX_NONE if the parent is blank, the tf transform is then the world transform)
+	TArray<int32> ParentIndices;
+
+	// Scene components providing the world transforms (root component for actors, nullptr for blank nodes)
+	TArray<USceneComponent*> Sources;
+
+	// Layout index of the root child (or the root) whose subtree contains the node
+	TArray<int32> SubtreeIds;
+
+	// World transforms read in the last gather pass
+	TArray<FTransform> WorldTransforms;
+
+	// Gather pass in which the world transform was read
+	TArray<uint32> WorldTransformStamps;
+
+	// Tf transforms (relative to the parent) computed in the last gather pass
+	TArray<FTransform> Transforms;
+
+	// Last published tf transforms (delta publishing)
+	TArray<FTransform> LastPublishedTransforms;
+
+	// Flags marking the nodes published at least once (delta publishing)
+	TBitArray<> PublishedFlags;
+
+	// All layout indices in order
+	TArray<int32> AllIndices;
+
+	// Layout indices of the dynamic nodes in order
+	TArray<int32> DynamicIndices;
+
+	// Layout indices of the static nodes in order
+	TArray<int32> StaticIndices;
+
+	// Flags marking the static nodes
+	TBitArray<> StaticFlags;
+
+	// Tf transforms of the static nodes as published, or the last sampled ones of the dynamic nodes (invariance detection)
+	TArray<FTransform> StaticTransforms;
+
+	// Number of consecutive unchanged publishes of the dynamic nodes (invariance detection)
+	TArray<int32> UnchangedCounts;
+
+	// Static nodes detection settings
+	FTFStaticSettings StaticSettings;
+
+	// World time (s) of the next motion check of the static nodes
+	float NextStaticCheckTime;
+
+	// Flag for rebuilding the dynamic and static index lists
+	bool bStaticSelectionDirty;
+
+	// Flag for republishing the static snapshot
+	bool bStaticNodesChanged;
+
+	// Channels publishing subsets of the frames
+	TArray<FTFChannel> Channels;
+
+	// Layout indices due in the current multi-rate publish
+	TArray<int32> DueIndices;
+
+	// Layout indices changed in the current delta publish
+	TArray<int32> ChangedIndices;
+
+	// Changed flag for every index of the current delta publish (bytes, written by parallel tasks)
+	TArray<uint8> ChangedFlags;
+
+	// Prebuilt header of every layout node (parent frame id set once, stamp and sequence updated on publish)
+	TArray<std_msgs::Header> HeaderPool;
+
+	// Prebuilt transform message of every layout node (child frame id set once, written by the parallel tasks)
+	TArray<geometry_msgs::TransformStamped> StampedMsgPool;
+
+	// Parallel gathering settings
+	FTFParallelSettings ParallelSettings;
+
+	// Message chunking settings
+	FTFChunkSettings ChunkSettings;
+
+	// Frame ids of the current layout (shared with the snapshots)
+	TSharedPtr<FTFFrameSchema, ESPMode::ThreadSafe> FrameSchema;
+
+	// Current gather pass
+	uint32 GatherStamp;
+
+	// Number of tf transforms kept in the time buffer of every node (0 = no recording)
+	int32 BufferCapacity;
+
+	// Cached lookup paths by target and source frame id (dropped when the topology changes)
+	TMap<FString, TMap<FString, FTFLookupPath>> LookupPaths;
+
+	// Asynchronous build in progress
+	TSharedPtr<FTFAsyncBuild> AsyncBuild;
+};
+
+// The tree struct is not copyable
+template<>
+struct TStructOpsTypeTraits<FTFTree> : public TStructOpsTypeTraitsBase2<FTFTree>
+{
+	enum
+	{
+		WithCopy = false
+	};
 };
@@ -45,6 +45,7 @@ public class UTFPublisher : ModuleRules
                 		"UROSBridge",
 				"Json",
 				"JsonUtilities",
+				"WebSockets",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);